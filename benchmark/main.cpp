@@ -0,0 +1,1308 @@
+// ==========================================================================
+//
+// File      : main.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file main.cpp
+ * @brief Benchmarks of the RF24 library, run on simulated modules.
+ * @details
+ * Every scenario sends a number of packets for every payload size from 1 (or 32) to 32 bytes, from one simulated module
+ * to another, and prints one CSV line with the results. Time is the virtual time of the simulator, so every run
+ * prints the same numbers, and the output of two versions of the library can be compared with diff.
+ * Both modules are driven by the same program, like two modules on one Due, so the SPI traffic and time
+ * of the receiver are part of the results.
+ */
+
+#include "hwlib.hpp"
+#include "RF24.hpp"
+#include "RF24_coalesce.hpp"
+#include "RF24_duplex.hpp"
+#include "RF24_hub.hpp"
+#include "RF24_link.hpp"
+#include "RF24_message.hpp"
+#include "RF24_mesh.hpp"
+#include "RF24_hop.hpp"
+#include "RF24_retry.hpp"
+#include "RF24_scan.hpp"
+#include "RF24_sim.hpp"
+#include "RF24_tdma.hpp"
+
+const int packets_per_run = 200; // Packets sent per scenario and payload size.
+const int packets_per_link_run = 2000; // Packets sent by the link scenarios, which only use 32 byte payloads.
+const uint32_t seed = 2017; // Seed of the simulated air.
+
+/// \brief
+/// The results of one scenario with one payload size.
+struct benchmark_result {
+    const char* scenario; /// Name of the scenario.
+    int payload; /// Payload size in bytes.
+    int packets; /// Number of packets handed to the library.
+    int sent; /// Number of packets the transmitter reported as sent.
+    int delivered; /// Number of packets that arrived with the right content.
+    uint64_t elapsed_us; /// Virtual time of the run.
+    uint32_t latency_us[packets_per_link_run]; /// Time from handing a packet to the library until it was acknowledged.
+    uint32_t tx_transactions; /// SPI transactions of the transmitter.
+    uint32_t tx_bytes; /// SPI bytes of the transmitter.
+    uint32_t rx_transactions; /// SPI transactions of the receiver.
+    uint32_t rx_bytes; /// SPI bytes of the receiver.
+};
+
+/// \brief
+/// A sink that counts the packets that have the expected size and content.
+/// \details
+/// It is a handler as well, for the layers that pass on packets one by one.
+class counting_sink : public RF24_packet_sink, public RF24_packet_handler {
+protected:
+    uint8_t frame[33]; /// The packet that is read.
+    int payload; /// The expected size.
+public:
+    int delivered; /// Number of good packets.
+    
+    counting_sink(const int payload):
+        payload( payload ),
+        delivered( 0 )
+    {}
+    
+    uint8_t* reserve(const uint8_t, const uint8_t) override {
+        return &*frame;
+    }
+    
+    void commit(const uint8_t pipe, const uint8_t length) override {
+        this->handle(RF24_packet_view{ &frame[1], length, pipe });
+    }
+    
+    void handle(const RF24_packet_view & packet) override {
+        bool good = (packet.length == payload);
+        for (int i = 1; i < packet.length && good; i++){
+            good = (packet.data[i] == (uint8_t)(packet.data[0] + i)); // See fill().
+        }
+        if (good) delivered++;
+    }
+};
+
+/// \brief
+/// A sink that counts the packets on pipe 0 and passes the control frames on pipe 1 to a link follower.
+class link_sink : public counting_sink {
+private:
+    RF24_link_follower & follower; /// Handles the control frames.
+public:
+    link_sink(const int payload, RF24_link_follower & follower):
+        counting_sink( payload ),
+        follower( follower )
+    {}
+    
+    void commit(const uint8_t pipe, const uint8_t length) override {
+        if (pipe == 1) follower.handle(RF24_packet_view{ &frame[1], length, pipe });
+        else counting_sink::commit(pipe, length);
+    }
+};
+
+/// \brief
+/// A sink that counts every packet of up to 8 nodes once.
+/// \details
+/// The packets of node n start at a number with n in the lowest 3 bits, see fill(). A packet whose acknowledge
+/// got lost is sent again right after it, so it is the same as the last packet of its node.
+class unique_sink : public counting_sink {
+private:
+    int last[8]; /// Per node, the first byte of the last packet, or -1.
+public:
+    unique_sink(const int payload):
+        counting_sink( payload )
+    {
+        for (int n = 0; n < 8; n++){
+            last[n] = -1;
+        }
+    }
+    
+    void handle(const RF24_packet_view & packet) override {
+        if (packet.length == 0) return;
+        const int node = packet.data[0] & 7;
+        if (packet.data[0] == last[node]) return;
+        last[node] = packet.data[0];
+        counting_sink::handle(packet);
+    }
+};
+
+/// \brief
+/// The clock of a transmitter that lets the receiver run while the transmitter waits.
+/// \details
+/// Both modules are driven by one program, but on real hardware the receiver has a microcontroller of its own,
+/// which reads packets while the transmitter waits, for example for a link follower to switch or a hop receiver to hop.
+class serviced_clock : public RF24_clock {
+private:
+    RF24_sim_air & air; /// The simulated air, which keeps the time.
+    RF24 & receiver; /// The receiver that runs while we wait.
+    RF24_packet_sink & sink; /// The sink the receiver reads into.
+    RF24_link_follower* follower; /// The follower of the receiver, or nullptr.
+public:
+    serviced_clock(RF24_sim_air & air, RF24 & receiver, RF24_packet_sink & sink, RF24_link_follower* follower = nullptr):
+        air( air ),
+        receiver( receiver ),
+        sink( sink ),
+        follower( follower )
+    {}
+    
+    uint_fast64_t now_us() override {
+        return air.now_us();
+    }
+    
+    void wait_us(const int_fast32_t us) override {
+        for (int_fast32_t left = us; left > 0; left -= 100){
+            air.advance((left < 100) ? left : 100);
+            receiver.receive_burst(sink);
+            if (follower != nullptr) follower->poll();
+        }
+    }
+};
+
+/// \brief
+/// An event handler that reads the RX FIFO into a sink, for RF24::service().
+class burst_reader : public RF24_event_handler {
+private:
+    RF24_packet_sink & sink; /// The sink the packets are read into.
+public:
+    burst_reader(RF24_packet_sink & sink):
+        sink( sink )
+    {}
+    
+    void handle(RF24 & radio, const uint8_t) override {
+        radio.receive_burst(sink);
+    }
+};
+
+/// \brief
+/// Fills a payload with a pattern that starts at the packet number.
+void fill(uint8_t* data, const int bytes, const int number){
+    for (int i = 0; i < bytes; i++){
+        data[i] = (uint8_t)(number + i);
+    }
+}
+
+/// \brief
+/// Prints value / 100 with two decimals.
+void print_fixed(const uint64_t value){
+    const unsigned int fraction = value % 100;
+    hwlib::cout << hwlib::dec << (unsigned int)(value / 100) << '.' << (fraction < 10 ? "0" : "") << fraction;
+}
+
+/// \brief
+/// Prints the CSV header.
+void print_header(){
+    hwlib::cout << "scenario,payload,packets,sent,delivered,elapsed_us,packets_per_s,goodput_bytes_per_s,"
+                << "latency_p50_us,latency_p90_us,latency_p99_us,latency_max_us,"
+                << "tx_spi_transactions_per_packet,tx_spi_bytes_per_packet,"
+                << "rx_spi_transactions_per_packet,rx_spi_bytes_per_packet\n";
+}
+
+/// \brief
+/// Sorts the latencies and prints the results as one CSV line.
+void print_result(benchmark_result & result){
+    // Insertion sort, there are only a few hundred values.
+    for (int i = 1; i < result.sent; i++){
+        const uint32_t value = result.latency_us[i];
+        int j = i;
+        for (; j > 0 && result.latency_us[j - 1] > value; j--){
+            result.latency_us[j] = result.latency_us[j - 1];
+        }
+        result.latency_us[j] = value;
+    }
+    const uint64_t elapsed = (result.elapsed_us == 0) ? 1 : result.elapsed_us;
+    hwlib::cout << result.scenario << ',' << hwlib::dec << result.payload << ',' << result.packets << ','
+                << result.sent << ',' << result.delivered << ',' << (unsigned int)result.elapsed_us << ',';
+    print_fixed(result.delivered * 100000000ull / elapsed);
+    hwlib::cout << ',';
+    print_fixed(result.delivered * (uint64_t)result.payload * 100000000ull / elapsed);
+    const int percentiles[3] = {50, 90, 99};
+    for (const int percentile : percentiles){
+        const int index = (result.sent * percentile) / 100;
+        hwlib::cout << ',' << (unsigned int)((result.sent > 0) ? result.latency_us[index < result.sent ? index : result.sent - 1] : 0);
+    }
+    hwlib::cout << ',' << (unsigned int)((result.sent > 0) ? result.latency_us[result.sent - 1] : 0);
+    // Without a delivered packet there is nothing to divide by, so those fields stay empty.
+    const uint32_t totals[4] = { result.tx_transactions, result.tx_bytes, result.rx_transactions, result.rx_bytes };
+    for (const uint32_t total : totals){
+        hwlib::cout << ',';
+        if (result.delivered > 0) print_fixed(total * 100ull / result.delivered);
+    }
+    hwlib::cout << '\n';
+}
+
+/// \brief
+/// Starts the measurement: lets the modules power up and clears the counters.
+void start(RF24_sim_air & air, RF24_sim_radio & tx, RF24_sim_radio & rx, benchmark_result & result){
+    air.advance(2000); // Power up and settle.
+    tx.reset_counters();
+    rx.reset_counters();
+    result.sent = 0;
+    result.delivered = 0;
+    result.elapsed_us = air.now_us();
+}
+
+/// \brief
+/// Stops the measurement and collects the counters.
+void stop(RF24_sim_air & air, RF24_sim_radio & tx, RF24_sim_radio & rx, benchmark_result & result){
+    result.elapsed_us = air.now_us() - result.elapsed_us;
+    result.tx_transactions = tx.spi_transactions();
+    result.tx_bytes = tx.spi_bytes();
+    result.rx_transactions = rx.spi_transactions();
+    result.rx_bytes = rx.spi_bytes();
+}
+
+/// \brief
+/// Blocking send() and receive_into() with both modules in easy mode, with or without the shadow registers.
+void easy(benchmark_result & result, const bool shadow){
+    RF24_sim_air air(seed);
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    if (!transmitter.init() || !receiver.init()) return;
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    transmitter.enable_shadow_registers(shadow);
+    receiver.enable_shadow_registers(shadow);
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    start(air, tx_module, rx_module, result);
+    uint8_t data[32];
+    for (int i = 0; i < packets_per_run; i++){
+        fill(&*data, result.payload, i);
+        const uint64_t begin = air.now_us();
+        if (transmitter.send(&*data, result.payload)){
+            result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin);
+        }
+        uint8_t in[32];
+        bool good = (receiver.receive_into(&*in, 32).length == result.payload);
+        for (int j = 0; j < result.payload && good; j++){
+            good = (in[j] == data[j]);
+        }
+        if (good) result.delivered++;
+    }
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// Easy mode without the shadow registers.
+void easy_mode(benchmark_result & result){
+    easy(result, false);
+}
+
+/// \brief
+/// Easy mode with the shadow registers, send() then sets and clears PRIM_RX without reading NRF_CONFIG.
+void easy_mode_shadow(benchmark_result & result){
+    easy(result, true);
+}
+
+/// \brief
+/// Blocking send() and receive_into() with static payload widths, set with an RF24_config.
+void pipe_config(benchmark_result & result){
+    RF24_sim_air air(seed);
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    const RF24_address address(0xC0, 0xFF, 0xEE, 0x00, 0x01);
+    const RF24_config config = RF24_config().channel(76).crc(RF24_crc::two_bytes).retries(500, 3);
+    const uint8_t width = (uint8_t)result.payload;
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    if (!transmitter.init(config.pipe(0, address, false, true, width).tx_address(address).sequence())) return;
+    if (!receiver.init(config.pipe(1, address, false, true, width).listening(true).sequence())) return;
+    start(air, tx_module, rx_module, result);
+    uint8_t data[32];
+    for (int i = 0; i < packets_per_run; i++){
+        fill(&*data, result.payload, i);
+        const uint64_t begin = air.now_us();
+        if (transmitter.send(&*data, result.payload)){
+            result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin);
+        }
+        uint8_t in[32];
+        bool good = (receiver.receive_into(&*in, 32).length == result.payload);
+        for (int j = 0; j < result.payload && good; j++){
+            good = (in[j] == data[j]);
+        }
+        if (good) result.delivered++;
+    }
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// try_send() and poll() in a TX stream.
+/// \details
+/// The receiver reads with receive_burst(), or with an RX_DR handler of service(), which only reads the status
+/// when the IRQ pin is low.
+void tx_stream(benchmark_result & result, const bool irq){
+    RF24_sim_air air(seed);
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module, rx_module.irq());
+    if (!transmitter.init() || !receiver.init()) return;
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    transmitter.start_tx_stream();
+    start(air, tx_module, rx_module, result);
+    counting_sink sink(result.payload);
+    burst_reader reader(sink);
+    receiver.set_event_handler(RX_DR, &reader);
+    uint64_t begin[4]; // When the packets in flight were handed to the library, oldest first.
+    uint8_t data[32];
+    int queued = 0, done = 0;
+    while (done < packets_per_run){
+        if (queued < packets_per_run && queued - done < 3){
+            fill(&*data, result.payload, queued);
+            if (transmitter.try_send(&*data, result.payload)) begin[queued++ % 4] = air.now_us();
+        }
+        const RF24::tx_result state = transmitter.poll();
+        if (state == RF24::tx_result::sent){
+            result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[done++ % 4]);
+        }
+        else if (state == RF24::tx_result::failed || state == RF24::tx_result::idle){
+            done++;
+        }
+        if (irq) receiver.service();
+        else receiver.receive_burst(sink);
+    }
+    while (receiver.receive_burst(sink) > 0){} // Read what is left.
+    result.delivered = sink.delivered;
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// A TX stream, the receiver reads with receive_burst().
+void stream(benchmark_result & result){
+    tx_stream(result, false);
+}
+
+/// \brief
+/// A TX stream, the receiver reads with service().
+void stream_irq(benchmark_result & result){
+    tx_stream(result, true);
+}
+
+/// \brief
+/// request() with ACK payloads: every request gets a response of the same size in its acknowledge.
+/// \details
+/// A packet is a round trip, it is delivered when the response arrived with the right content.
+/// The receiver loads the response before the request comes, and reads the request after it was acknowledged.
+void requests(benchmark_result & result){
+    RF24_sim_air air(seed);
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    if (!transmitter.init() || !receiver.init()) return;
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    transmitter.enable_ack_payload();
+    receiver.enable_ack_payload();
+    transmitter.set_retries(500, 3); // An acknowledge with a long ACK payload takes more than the default 250 us.
+    transmitter.start_tx_stream();
+    start(air, tx_module, rx_module, result);
+    counting_sink requests(result.payload), responses(result.payload);
+    uint8_t data[32];
+    for (int i = 0; i < packets_per_run; i++){
+        fill(&*data, result.payload, i + 100); // A response differs from the request.
+        receiver.write_ack_payload(0, &*data, result.payload);
+        fill(&*data, result.payload, i);
+        const uint64_t begin = air.now_us();
+        if (transmitter.request(&*data, result.payload, responses) >= 0){
+            result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin);
+        }
+        receiver.receive_burst(requests);
+        receiver.flush_tx(); // A response that was not taken must not answer the next request.
+    }
+    result.delivered = responses.delivered;
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// Six nodes send one packet at a time in turns to an RF24_hub, each on a pipe of its own.
+/// \details
+/// The transmitter columns are the totals of the six nodes.
+void hub(benchmark_result & result){
+    RF24_sim_air air(seed);
+    RF24_sim_radio rx_module(air), m0(air), m1(air), m2(air), m3(air), m4(air), m5(air);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    RF24 n0(m0.ce(), m0.csn(), m0), n1(m1.ce(), m1.csn(), m1), n2(m2.ce(), m2.csn(), m2);
+    RF24 n3(m3.ce(), m3.csn(), m3), n4(m4.ce(), m4.csn(), m4), n5(m5.ce(), m5.csn(), m5);
+    RF24_sim_radio* node_modules[6] = { &m0, &m1, &m2, &m3, &m4, &m5 };
+    RF24* nodes[6] = { &n0, &n1, &n2, &n3, &n4, &n5 };
+    const uint8_t base[5] = {0xC0, 0xFF, 0xEE, 0x00, 0x10};
+    counting_sink sink(result.payload);
+    RF24_hub hub(receiver);
+    if (!receiver.init()) return;
+    receiver.set_clock(air);
+    receiver.set_channel(42);
+    hub.start(&*base);
+    for (uint8_t pipe = 0; pipe < 6; pipe++){
+        hub.set_handler(pipe, &sink);
+    }
+    for (uint8_t n = 0; n < 6; n++){
+        uint8_t address[5];
+        RF24::hub_address(&*base, n, &*address);
+        if (!nodes[n]->init()) return;
+        nodes[n]->set_clock(air);
+        nodes[n]->start_easy_mode();
+        nodes[n]->set_tx_address(&*address);
+        nodes[n]->set_rx_address(RX_ADDR_P0, &*address); // For the acknowledges.
+    }
+    air.advance(2000); // Power up and settle.
+    rx_module.reset_counters();
+    for (RF24_sim_radio* module : node_modules){
+        module->reset_counters();
+    }
+    result.elapsed_us = air.now_us();
+    uint8_t data[32];
+    for (int i = 0; i < result.packets; i++){
+        fill(&*data, result.payload, i);
+        const uint64_t begin = air.now_us();
+        if (nodes[i % 6]->send(&*data, result.payload)){
+            result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin);
+        }
+        hub.poll();
+    }
+    hub.poll(); // Read what is left.
+    result.delivered = sink.delivered;
+    result.elapsed_us = air.now_us() - result.elapsed_us;
+    result.rx_transactions = rx_module.spi_transactions();
+    result.rx_bytes = rx_module.spi_bytes();
+    for (RF24_sim_radio* module : node_modules){
+        result.tx_transactions += module->spi_transactions();
+        result.tx_bytes += module->spi_bytes();
+    }
+}
+
+/// \brief
+/// Messages of 100 fragments from an RF24_message_sender to an RF24_message_receiver.
+/// \details
+/// The packets are the fragments, so the goodput is that of the message data. The latency of a fragment is the time
+/// from the start of its message until the sender knew the fragment arrived, so the maximum is that of a whole message.
+void messages(benchmark_result & result){
+    RF24_sim_air air(seed);
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    if (!transmitter.init() || !receiver.init()) return;
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    transmitter.start_tx_stream();
+    start(air, tx_module, rx_module, result);
+    const int fragments = 100;
+    static uint8_t data[fragments * RF24_fragment_data];
+    static RF24_message_buffer<fragments * RF24_fragment_data> message;
+    RF24_message_sender sender(transmitter);
+    const uint64_t deadline = air.now_us() + 10000000;
+    for (int m = 0; m < result.packets / fragments && air.now_us() < deadline; m++){
+        fill(&*data, sizeof(data), m);
+        const uint64_t begin = air.now_us();
+        if (!sender.start(&*data, sizeof(data))) break;
+        RF24_message_sender::state state = RF24_message_sender::state::busy;
+        while (state == RF24_message_sender::state::busy && air.now_us() < deadline){
+            const uint16_t before = sender.fragments_acknowledged();
+            state = sender.poll();
+            for (int i = before; i < sender.fragments_acknowledged(); i++){
+                result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin);
+            }
+            receiver.receive_burst(message);
+        }
+        // The last fragments can still be in the RX FIFO.
+        for (int i = 0; i < 3 && !message.complete(); i++){
+            receiver.receive_burst(message);
+        }
+        bool good = message.complete() && message.message_length() == sizeof(data);
+        for (uint32_t i = 0; i < sizeof(data) && good; i++){
+            good = (message.message()[i] == data[i]);
+        }
+        if (good) result.delivered += fragments;
+        message.release();
+    }
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// Bursts of 4 packets in a TX stream, with 10 ms between the bursts.
+/// \details
+/// With auto power-down the transmitter sleeps between the bursts, and the first packet of a burst waits
+/// for the chip to start up.
+void bursts(benchmark_result & result, const bool power_down){
+    RF24_sim_air air(seed);
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    if (!transmitter.init() || !receiver.init()) return;
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    transmitter.start_tx_stream();
+    transmitter.set_auto_power_down(power_down);
+    start(air, tx_module, rx_module, result);
+    counting_sink sink(result.payload);
+    uint64_t begin[4]; // When the packets in flight were handed to the library, oldest first.
+    uint8_t data[32];
+    int queued = 0, done = 0;
+    while (done < result.packets){
+        const int burst_end = queued + 4;
+        while (done < burst_end){
+            if (queued < burst_end && queued - done < 3){
+                fill(&*data, result.payload, queued);
+                if (transmitter.try_send(&*data, result.payload)) begin[queued++ % 4] = air.now_us();
+            }
+            const RF24::tx_result state = transmitter.poll();
+            if (state == RF24::tx_result::sent){
+                result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[done++ % 4]);
+            }
+            else if (state == RF24::tx_result::failed || state == RF24::tx_result::idle){
+                done++;
+            }
+            receiver.receive_burst(sink);
+        }
+        air.advance(10000);
+        receiver.receive_burst(sink);
+    }
+    result.delivered = sink.delivered;
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// Bursts with the transmitter powered up all the time.
+void bursts_awake(benchmark_result & result){
+    bursts(result, false);
+}
+
+/// \brief
+/// Bursts with auto power-down.
+void bursts_power_down(benchmark_result & result){
+    bursts(result, true);
+}
+
+/// \brief
+/// How a link scenario is run.
+struct link_options {
+    int step; /// The step of the link ladder to start at.
+    bool long_link; /// Holds if high data rates and low power levels lose packets.
+    bool wifi; /// Holds if Wi-Fi is on the air around the channel of easy mode.
+    bool adaptive; /// Holds if an RF24_link_adapter picks the step.
+    bool tuned; /// Holds if an RF24_retry_tuner sets the retransmit delay and count.
+    bool scan; /// Holds if the transmitter scans the channels and moves the link to the quietest one.
+};
+
+/// \brief
+/// A stream at a fixed step of the link ladder or with an RF24_link_adapter.
+/// \details
+/// On a long link 2 Mbps loses many packets, lower power levels lose even more, 1 Mbps loses a few and 250 kbps none.
+/// The best goodput is at 1 Mbps, the adapter should find it and stay there most of the time.
+/// Without the retry tuner the retransmit delay is 750 us for every data rate, with it the delay and count are tuned.
+/// Wi-Fi is simulated as a jammer on channels 26-48 (Wi-Fi channel 6), busy 30% of the time. The scan is part
+/// of the elapsed time.
+void link(benchmark_result & result, const link_options & options){
+    RF24_sim_air air(seed);
+    const uint16_t loss[3][4] = { // Per 1000 packets, for every data rate and PA level, -18 dBm first.
+        {0, 0, 0, 0},
+        {150, 100, 80, 50},
+        {900, 700, 500, 350}
+    };
+    for (uint8_t rate = 0; rate < 3 && options.long_link; rate++){
+        for (uint8_t level = 0; level < 4; level++){
+            air.set_loss(rate, level, loss[rate][level]);
+        }
+    }
+    for (uint8_t channel = 26; channel <= 48 && options.wifi; channel++){
+        air.set_jammer(channel, 300);
+    }
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    if (!transmitter.init() || !receiver.init()) return;
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    const uint8_t data_address[5] = {0x26, 0x02, 0x19, 0x96, 0xDD}; // The address of easy mode.
+    const uint8_t control_address[5] = {0xC0, 0x11, 0x11, 0x11, 0x11};
+    RF24_link_follower follower(receiver, 1, &*control_address);
+    link_sink sink(result.payload, follower);
+    serviced_clock clock(air, receiver, sink, &follower);
+    transmitter.set_clock(clock);
+    receiver.set_clock(air);
+    RF24_link_adapter adapter(transmitter, &*data_address, &*control_address);
+    RF24_retry_tuner tuner(transmitter);
+    follower.start(options.step);
+    adapter.start(options.step);
+    if (options.tuned){
+        tuner.start();
+        adapter.set_retry_tuner(tuner);
+    }
+    else {
+        transmitter.set_retries(750, 3); // 250 kbps needs at least 500 us.
+    }
+    if (!options.scan) transmitter.start_tx_stream();
+    start(air, tx_module, rx_module, result);
+    if (options.scan){
+        RF24_channel_scanner scanner(transmitter);
+        scanner.sweep(4);
+        transmitter.start_tx_stream();
+        adapter.move(scanner.quietest());
+    }
+    uint64_t begin[4]; // When the packets in flight were handed to the library, oldest first.
+    uint8_t data[32];
+    int queued = 0, done = 0;
+    while (done < result.packets){
+        if (options.adaptive && adapter.due() && queued == done) adapter.adapt();
+        if (queued < result.packets && queued - done < 3 && !(options.adaptive && adapter.due())){
+            fill(&*data, result.payload, queued);
+            if (transmitter.try_send(&*data, result.payload)) begin[queued++ % 4] = air.now_us();
+        }
+        const RF24::tx_result state = transmitter.poll();
+        adapter.report(state);
+        if (options.tuned) tuner.adapt();
+        if (state == RF24::tx_result::sent){
+            result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[done++ % 4]);
+        }
+        else if (state == RF24::tx_result::failed || state == RF24::tx_result::idle){
+            done++;
+        }
+        receiver.receive_burst(sink);
+        follower.poll();
+    }
+    while (receiver.receive_burst(sink) > 0){} // Read what is left.
+    result.delivered = sink.delivered;
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// A long link at 250 kbps.
+void link_250kbps(benchmark_result & result){
+    link(result, link_options{ 0, true, false, false, false, false });
+}
+
+/// \brief
+/// A long link at 1 Mbps.
+void link_1mbps(benchmark_result & result){
+    link(result, link_options{ 1, true, false, false, false, false });
+}
+
+/// \brief
+/// A long link at 1 Mbps with an RF24_retry_tuner.
+void link_1mbps_tuned(benchmark_result & result){
+    link(result, link_options{ 1, true, false, false, true, false });
+}
+
+/// \brief
+/// A long link at 2 Mbps.
+void link_2mbps(benchmark_result & result){
+    link(result, link_options{ 2, true, false, false, false, false });
+}
+
+/// \brief
+/// A long link with an RF24_link_adapter, starting at 250 kbps.
+void link_adaptive(benchmark_result & result){
+    link(result, link_options{ 0, true, false, true, false, false });
+}
+
+/// \brief
+/// A long link with an RF24_link_adapter and an RF24_retry_tuner.
+void link_adaptive_tuned(benchmark_result & result){
+    link(result, link_options{ 0, true, false, true, true, false });
+}
+
+/// \brief
+/// A short link at 2 Mbps on the channel of easy mode, which is shared with Wi-Fi.
+void wifi(benchmark_result & result){
+    link(result, link_options{ 2, false, true, false, false, false });
+}
+
+/// \brief
+/// A short link at 2 Mbps that scans the channels first and moves away from Wi-Fi.
+void wifi_scanned(benchmark_result & result){
+    link(result, link_options{ 2, false, true, false, false, true });
+}
+
+/// \brief
+/// One packet at a time with RF24::request() or an RF24_hop_sender, next to a jammer on channels 26-48.
+/// \details
+/// Without hopping both modules stay on channel 42, the channel of easy mode. With hopping they hop over
+/// all channels with home channel 2, and the sender marks the jammed channels bad.
+void hop(benchmark_result & result, const bool hopping, const bool jammed){
+    RF24_sim_air air(seed);
+    for (uint8_t channel = 26; channel <= 48 && jammed; channel++){
+        air.set_jammer(channel, 1000);
+    }
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    if (!transmitter.init() || !receiver.init()) return;
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    counting_sink sink(result.payload);
+    RF24_hop_sequence sequence(seed);
+    RF24_hop_sender sender(transmitter, sequence, 2);
+    RF24_hop_receiver hop_receiver(receiver, sequence, sink, 2);
+    serviced_clock clock(air, receiver, hop_receiver);
+    if (hopping) transmitter.set_clock(clock);
+    transmitter.start_tx_stream();
+    if (hopping){
+        sender.start();
+        hop_receiver.start();
+    }
+    start(air, tx_module, rx_module, result);
+    RF24_packet_ring_buffer<3> responses;
+    uint8_t data[32];
+    for (int i = 0; i < result.packets; i++){
+        fill(&*data, result.payload, i);
+        const uint64_t begin = air.now_us();
+        const bool ok = hopping ? sender.send(&*data, result.payload) : (transmitter.request(&*data, result.payload, responses) >= 0);
+        if (ok) result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin);
+        if (hopping){
+            receiver.receive_burst(hop_receiver);
+            hop_receiver.poll();
+        }
+        else {
+            receiver.receive_burst(sink);
+        }
+    }
+    result.delivered = sink.delivered;
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// One packet at a time on channel 42, without a jammer.
+void fixed_clear(benchmark_result & result){
+    hop(result, false, false);
+}
+
+/// \brief
+/// One packet at a time on channel 42, which is jammed.
+void fixed_jammed(benchmark_result & result){
+    hop(result, false, true);
+}
+
+/// \brief
+/// One packet at a time while hopping, without a jammer.
+void hop_clear(benchmark_result & result){
+    hop(result, true, false);
+}
+
+/// \brief
+/// One packet at a time while hopping, next to a jammer.
+void hop_jammed(benchmark_result & result){
+    hop(result, true, true);
+}
+
+/// \brief
+/// How a duplex scenario is run.
+enum class duplex_mode {
+    half, /// One radio per node, send() in turns, in both directions.
+    both_ways, /// Two radios per node with an RF24_duplex, both nodes send half of the packets at once.
+    one_way, /// Two radios per node with an RF24_duplex, one node sends everything.
+    striped /// As one_way, with striping enabled, so the sending node borrows the channel of the other one.
+};
+
+/// \brief
+/// Packets between two nodes, in both directions or in one.
+/// \details
+/// The results count both directions. The transmitter columns are the SPI traffic of node A,
+/// the receiver columns that of node B, with both of its radios. The latency of a duplex packet is the time
+/// until it and every packet before it were acknowledged.
+void duplex(benchmark_result & result, const duplex_mode mode){
+    RF24_sim_air air(seed);
+    RF24_sim_radio a_tx_module(air), a_rx_module(air), b_tx_module(air), b_rx_module(air);
+    RF24 a_tx(a_tx_module.ce(), a_tx_module.csn(), a_tx_module);
+    RF24 a_rx(a_rx_module.ce(), a_rx_module.csn(), a_rx_module);
+    RF24 b_tx(b_tx_module.ce(), b_tx_module.csn(), b_tx_module);
+    RF24 b_rx(b_rx_module.ce(), b_rx_module.csn(), b_rx_module);
+    RF24* radios[4] = { &a_tx, &a_rx, &b_tx, &b_rx };
+    for (RF24* radio : radios){
+        if (!radio->init()) return;
+        radio->set_clock(air);
+        radio->start_easy_mode();
+    }
+    counting_sink a_sink(result.payload), b_sink(result.payload);
+    RF24_duplex node_a(a_tx, a_rx, a_sink), node_b(b_tx, b_rx, b_sink);
+    const uint8_t a_address[5] = {0xC0, 0xDE, 0x00, 0x00, 0x0A};
+    const uint8_t b_address[5] = {0xC0, 0xDE, 0x00, 0x00, 0x0B};
+    if (mode != duplex_mode::half){
+        node_a.start(10, &*a_address, 80, &*b_address);
+        node_b.start(80, &*b_address, 10, &*a_address);
+        node_a.set_striping(mode == duplex_mode::striped);
+        node_b.set_striping(mode == duplex_mode::striped);
+    }
+    air.advance(2000); // Power up and settle.
+    RF24_sim_radio* modules[4] = { &a_tx_module, &a_rx_module, &b_tx_module, &b_rx_module };
+    for (RF24_sim_radio* module : modules){
+        module->reset_counters();
+    }
+    result.elapsed_us = air.now_us();
+    uint8_t data[32];
+    if (mode == duplex_mode::half){
+        for (int i = 0; i < result.packets; i++){
+            fill(&*data, result.payload, i);
+            RF24 & from = (i % 2 == 0) ? a_tx : b_tx;
+            RF24 & to = (i % 2 == 0) ? b_tx : a_tx;
+            const uint64_t begin = air.now_us();
+            if (from.send(&*data, result.payload)) result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin);
+            to.receive_burst((i % 2 == 0) ? b_sink : a_sink);
+        }
+    }
+    else {
+        RF24_duplex* nodes[2] = { &node_a, &node_b };
+        const int to_send[2] = {
+            (mode == duplex_mode::both_ways) ? result.packets / 2 : result.packets,
+            (mode == duplex_mode::both_ways) ? result.packets - result.packets / 2 : 0
+        };
+        int queued[2] = {0, 0}, acknowledged[2] = {0, 0};
+        uint64_t begin[2][RF24_duplex_window]; // When the packets that are not acknowledged were given to send().
+        const uint64_t deadline = air.now_us() + 10000000;
+        while ((acknowledged[0] < to_send[0] || acknowledged[1] < to_send[1]) && air.now_us() < deadline){
+            for (int n = 0; n < 2; n++){
+                if (queued[n] < to_send[n]){
+                    fill(&*data, result.payload, queued[n]);
+                    if (nodes[n]->send(&*data, result.payload)) begin[n][queued[n]++ % RF24_duplex_window] = air.now_us();
+                }
+                nodes[n]->poll();
+                for (; acknowledged[n] < queued[n] - nodes[n]->pending(); acknowledged[n]++){
+                    result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[n][acknowledged[n] % RF24_duplex_window]);
+                }
+            }
+        }
+        for (int i = 0; i < 10; i++){
+            node_a.poll(); // Read what is left.
+            node_b.poll();
+        }
+    }
+    result.delivered = a_sink.delivered + b_sink.delivered;
+    result.elapsed_us = air.now_us() - result.elapsed_us;
+    result.tx_transactions = a_tx_module.spi_transactions() + a_rx_module.spi_transactions();
+    result.tx_bytes = a_tx_module.spi_bytes() + a_rx_module.spi_bytes();
+    result.rx_transactions = b_tx_module.spi_transactions() + b_rx_module.spi_transactions();
+    result.rx_bytes = b_tx_module.spi_bytes() + b_rx_module.spi_bytes();
+}
+
+/// \brief
+/// One radio per node, sending in turns.
+void half_duplex(benchmark_result & result){
+    duplex(result, duplex_mode::half);
+}
+
+/// \brief
+/// Two radios per node, both nodes send at once.
+void duplex_both_ways(benchmark_result & result){
+    duplex(result, duplex_mode::both_ways);
+}
+
+/// \brief
+/// Two radios per node, one node sends.
+void duplex_one_way(benchmark_result & result){
+    duplex(result, duplex_mode::one_way);
+}
+
+/// \brief
+/// Two radios per node, one node sends on both channels.
+void duplex_striped(benchmark_result & result){
+    duplex(result, duplex_mode::striped);
+}
+
+/// \brief
+/// Small messages, like the readings of a sensor node, sent as fast as possible.
+/// \details
+/// Every message is a packet of its own with send(), or messages are packed into full payloads with an
+/// RF24_coalescer. The payload column is the size of a message, and the results count messages.
+/// The latency of a message is the time until the payload it went in was acknowledged.
+void readings(benchmark_result & result, const bool coalesce){
+    RF24_sim_air air(seed);
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    if (!transmitter.init() || !receiver.init()) return;
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    start(air, tx_module, rx_module, result);
+    counting_sink messages(result.payload);
+    RF24_coalesced_receiver unpacker(messages);
+    RF24_packet_sink & sink = coalesce ? (RF24_packet_sink &)unpacker : (RF24_packet_sink &)messages;
+    RF24_coalescer coalescer(transmitter);
+    uint64_t begin[32]; // When the messages that are not acknowledged were added, a payload holds up to 15.
+    uint8_t data[32];
+    int queued = 0, acknowledged = 0;
+    for (int i = 0; i < result.packets; i++){
+        fill(&*data, result.payload, i);
+        const uint64_t now = air.now_us();
+        if (!coalesce){
+            if (transmitter.send(&*data, result.payload)) result.latency_us[result.sent++] = (uint32_t)(air.now_us() - now);
+        }
+        else if (coalescer.add(&*data, result.payload)){
+            begin[queued++ % 32] = now;
+        }
+        receiver.receive_burst(sink);
+        for (; acknowledged < queued - coalescer.pending(); acknowledged++){
+            result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[acknowledged % 32]);
+        }
+    }
+    coalescer.flush();
+    for (; acknowledged < queued - coalescer.pending(); acknowledged++){
+        result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[acknowledged % 32]);
+    }
+    receiver.receive_burst(sink); // Read what is left.
+    result.delivered = messages.delivered;
+    stop(air, tx_module, rx_module, result);
+}
+
+/// \brief
+/// Every message in a packet of its own.
+void readings_single(benchmark_result & result){
+    readings(result, false);
+}
+
+/// \brief
+/// Messages packed into full payloads.
+void readings_coalesced(benchmark_result & result){
+    readings(result, true);
+}
+
+/// \brief
+/// A node of the many_nodes scenarios: a module, its radio and the TDMA node that uses it.
+struct node_station {
+    RF24_sim_radio module; /// The simulated module.
+    RF24 radio; /// The radio on the module.
+    RF24_tdma_node node; /// Only used with TDMA.
+    
+    node_station(RF24_sim_air & air, const uint8_t id):
+        module( air ),
+        radio( module.ce(), module.csn(), module ),
+        node( radio, id )
+    {}
+};
+
+/// \brief
+/// Many nodes that send to one receiver.
+/// \details
+/// The packets are divided over the nodes, which all send as fast as they can. Shared, every node streams
+/// to the address of the receiver at will, with a retry delay of its own, and loads again what failed. With TDMA the receiver is an RF24_tdma_hub
+/// with two slots per node, and the nodes are RF24_tdma_nodes. The transmitter columns are the SPI traffic of
+/// all nodes together. The latency of a packet is the time from handing it to the library until it and every
+/// packet of its node before it were acknowledged. A packet that arrived twice, because its acknowledge got lost,
+/// is delivered once.
+void many_nodes(benchmark_result & result, const int count, const bool tdma){
+    RF24_sim_air air(seed);
+    RF24_sim_radio rx_module(air);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    unique_sink sink(result.payload);
+    RF24_tdma_hub hub(receiver, sink, count, 2 * count);
+    node_station stations[8] = { {air, 0}, {air, 1}, {air, 2}, {air, 3}, {air, 4}, {air, 5}, {air, 6}, {air, 7} };
+    const uint8_t data_address[5] = {0xC0, 0xDE, 0x00, 0x00, 0x0D};
+    const uint8_t beacon_address[5] = {0xC0, 0xDE, 0x00, 0x00, 0x0B};
+    if (!receiver.init()) return;
+    receiver.set_clock(air);
+    receiver.start_easy_mode();
+    if (tdma) hub.start(&*data_address, &*beacon_address);
+    for (int n = 0; n < count; n++){
+        RF24 & radio = stations[n].radio;
+        if (!radio.init()) return;
+        radio.set_clock(air);
+        radio.start_easy_mode();
+        if (tdma) stations[n].node.start(&*data_address, &*beacon_address);
+        else {
+            radio.set_retries(250 * (n + 1), 15); // Different delays, so two nodes do not collide on every retry.
+            radio.start_tx_stream();
+        }
+    }
+    air.advance(2000); // Power up and settle.
+    rx_module.reset_counters();
+    for (int n = 0; n < count; n++){
+        stations[n].module.reset_counters();
+    }
+    result.elapsed_us = air.now_us();
+    const int window = RF24_tdma_queue; // Shared, at most 3 packets are not acknowledged.
+    int to_send[8], queued[8], loaded[8], acknowledged[8];
+    uint64_t begin[8][window]; // When the packets that are not acknowledged were handed to the library.
+    for (int n = 0; n < count; n++){
+        to_send[n] = result.packets / count + ((n < result.packets % count) ? 1 : 0);
+        queued[n] = 0;
+        loaded[n] = 0;
+        acknowledged[n] = 0;
+    }
+    uint8_t data[32];
+    int done = 0;
+    const uint64_t deadline = air.now_us() + 10000000;
+    while (done < count && air.now_us() < deadline){
+        done = 0;
+        for (int n = 0; n < count; n++){
+            RF24 & radio = stations[n].radio;
+            RF24_tdma_node & node = stations[n].node;
+            if (tdma){
+                fill(&*data, result.payload, queued[n] * 8 + n);
+                if (queued[n] < to_send[n] && node.send(&*data, result.payload)) begin[n][queued[n]++ % window] = air.now_us();
+                node.poll();
+                for (; acknowledged[n] < queued[n] - node.pending(); acknowledged[n]++){
+                    result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[n][acknowledged[n] % window]);
+                }
+            }
+            else {
+                // A packet that failed is loaded again, with the time it was first handed to the library.
+                const int next = acknowledged[n] + loaded[n];
+                if (next < to_send[n] && loaded[n] < 3){
+                    fill(&*data, result.payload, next * 8 + n);
+                    if (radio.try_send(&*data, result.payload)){
+                        if (next == queued[n]) begin[n][queued[n]++ % window] = air.now_us();
+                        loaded[n]++;
+                    }
+                }
+                const RF24::tx_result state = radio.poll();
+                if (state == RF24::tx_result::sent){
+                    result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[n][acknowledged[n]++ % window]);
+                    loaded[n]--;
+                }
+                else if (state == RF24::tx_result::failed || state == RF24::tx_result::idle){
+                    while (radio.poll() == RF24::tx_result::failed){} // The rest of the TX FIFO failed with it.
+                    loaded[n] = 0;
+                }
+            }
+            if (acknowledged[n] == to_send[n]) done++;
+        }
+        if (tdma) hub.poll();
+        else receiver.receive_burst(sink);
+        air.advance(10);
+    }
+    for (int i = 0; i < 10; i++){
+        receiver.receive_burst(tdma ? (RF24_packet_sink &)hub : (RF24_packet_sink &)sink); // Read what is left.
+    }
+    result.delivered = sink.delivered;
+    result.elapsed_us = air.now_us() - result.elapsed_us;
+    result.rx_transactions = rx_module.spi_transactions();
+    result.rx_bytes = rx_module.spi_bytes();
+    for (int n = 0; n < count; n++){
+        result.tx_transactions += stations[n].module.spi_transactions();
+        result.tx_bytes += stations[n].module.spi_bytes();
+    }
+}
+
+/// \brief
+/// 2 nodes that send at will.
+void shared_2(benchmark_result & result){
+    many_nodes(result, 2, false);
+}
+
+/// \brief
+/// 4 nodes that send at will.
+void shared_4(benchmark_result & result){
+    many_nodes(result, 4, false);
+}
+
+/// \brief
+/// 8 nodes that send at will.
+void shared_8(benchmark_result & result){
+    many_nodes(result, 8, false);
+}
+
+/// \brief
+/// 2 nodes that send in slots.
+void tdma_2(benchmark_result & result){
+    many_nodes(result, 2, true);
+}
+
+/// \brief
+/// 4 nodes that send in slots.
+void tdma_4(benchmark_result & result){
+    many_nodes(result, 4, true);
+}
+
+/// \brief
+/// 8 nodes that send in slots.
+void tdma_8(benchmark_result & result){
+    many_nodes(result, 8, true);
+}
+
+/// \brief
+/// A sink that counts the packets for a mesh node, and notes their latency.
+class latency_sink : public counting_sink {
+private:
+    RF24_sim_air & air; /// Keeps the time.
+    benchmark_result & result; /// Where the latency goes.
+public:
+    uint64_t begin[256]; /// When every packet number, modulo 256, was handed to the library.
+    
+    latency_sink(RF24_sim_air & air, benchmark_result & result):
+        counting_sink( result.payload ),
+        air( air ),
+        result( result )
+    {}
+    
+    void handle(const RF24_packet_view & packet) override {
+        const int before = delivered;
+        counting_sink::handle(packet);
+        if (delivered > before) result.latency_us[result.sent++] = (uint32_t)(air.now_us() - begin[packet.data[0]]);
+    }
+};
+
+/// \brief
+/// A node of the mesh scenarios: a module, its radio and the mesh node that uses it.
+struct mesh_station {
+    RF24_sim_radio module; /// The simulated module.
+    RF24 radio; /// The radio on the module.
+    RF24_mesh mesh; /// The mesh node.
+    
+    mesh_station(RF24_sim_air & air, RF24_packet_handler & handler, const uint16_t address, const uint8_t* network):
+        module( air ),
+        radio( module.ce(), module.csn(), module ),
+        mesh( radio, handler, address, network )
+    {}
+};
+
+/// \brief
+/// Packets from one node of a mesh to another, over one or more hops.
+/// \details
+/// The tree has the root 0, its children 01 and 02, node 011 under 01, node 0111 under 011 and node 021 under 02.
+/// Every level of the tree has its own channel. The source keeps its queue full.
+/// The results count the packets that arrived. Their latency is the time from handing them to the source until
+/// they arrived. The transmitter columns are the SPI traffic of all nodes but the destination, the receiver
+/// columns that of the destination.
+void mesh(benchmark_result & result, const int from, const int to){
+    RF24_sim_air air(seed);
+    latency_sink sink(air, result);
+    const uint8_t network[2] = {0x4D, 0x35};
+    mesh_station stations[6] = {
+        {air, sink, 00, &*network}, {air, sink, 01, &*network}, {air, sink, 02, &*network},
+        {air, sink, 011, &*network}, {air, sink, 0111, &*network}, {air, sink, 021, &*network}
+    };
+    for (mesh_station & station : stations){
+        if (!station.radio.init()) return;
+        station.radio.set_clock(air);
+        station.radio.start_easy_mode();
+        station.mesh.start(60);
+    }
+    air.advance(2000); // Power up and settle.
+    for (mesh_station & station : stations){
+        station.module.reset_counters();
+    }
+    result.elapsed_us = air.now_us();
+    RF24_mesh & source = stations[from].mesh;
+    const uint16_t destination = stations[to].mesh.address();
+    uint8_t data[32];
+    int queued = 0;
+    const uint64_t deadline = air.now_us() + 10000000;
+    while (sink.delivered < result.packets && air.now_us() < deadline){
+        if (queued < result.packets){
+            fill(&*data, result.payload, queued);
+            if (source.send(destination, &*data, result.payload)) sink.begin[queued++ % 256] = air.now_us();
+        }
+        int waiting = 0;
+        for (mesh_station & station : stations){
+            station.mesh.poll();
+            waiting += station.mesh.pending();
+        }
+        if (queued == result.packets && waiting == 0) break; // Everything was delivered or dropped.
+        air.advance(10);
+    }
+    result.delivered = sink.delivered;
+    result.elapsed_us = air.now_us() - result.elapsed_us;
+    for (int i = 0; i < 6; i++){
+        if (i == to){
+            result.rx_transactions += stations[i].module.spi_transactions();
+            result.rx_bytes += stations[i].module.spi_bytes();
+        }
+        else {
+            result.tx_transactions += stations[i].module.spi_transactions();
+            result.tx_bytes += stations[i].module.spi_bytes();
+        }
+    }
+}
+
+/// \brief
+/// From node 01 to the root.
+void mesh_1_hop(benchmark_result & result){
+    mesh(result, 1, 0);
+}
+
+/// \brief
+/// From node 011 to the root, through 01.
+void mesh_2_hops(benchmark_result & result){
+    mesh(result, 3, 0);
+}
+
+/// \brief
+/// From node 0111 to the root, through 011 and 01.
+void mesh_3_hops(benchmark_result & result){
+    mesh(result, 4, 0);
+}
+
+/// \brief
+/// From node 011 to node 021, through 01, the root and 02.
+void mesh_across(benchmark_result & result){
+    mesh(result, 3, 5);
+}
+
+int main( void ){
+    struct scenario {
+        const char* name;
+        void (*run)(benchmark_result & result);
+        int first_payload; /// The payload sizes from first_payload to last_payload are run.
+        int last_payload;
+        int packets; /// Packets per run.
+    };
+    const scenario scenarios[] = {
+        { "easy_mode", easy_mode, 1, 32, packets_per_run },
+        { "easy_mode_shadow", easy_mode_shadow, 1, 32, packets_per_run },
+        { "pipe_config", pipe_config, 1, 32, packets_per_run },
+        { "stream", stream, 1, 32, packets_per_run },
+        { "stream_irq", stream_irq, 1, 32, packets_per_run },
+        { "requests", requests, 1, 32, packets_per_run },
+        { "hub", hub, 32, 32, packets_per_link_run },
+        { "messages", messages, RF24_fragment_data, RF24_fragment_data, packets_per_link_run },
+        { "bursts_awake", bursts_awake, 32, 32, packets_per_link_run },
+        { "bursts_power_down", bursts_power_down, 32, 32, packets_per_link_run },
+        { "link_250kbps", link_250kbps, 32, 32, packets_per_link_run },
+        { "link_1mbps", link_1mbps, 32, 32, packets_per_link_run },
+        { "link_2mbps", link_2mbps, 32, 32, packets_per_link_run },
+        { "link_adaptive", link_adaptive, 32, 32, packets_per_link_run },
+        { "link_1mbps_tuned", link_1mbps_tuned, 32, 32, packets_per_link_run },
+        { "link_adaptive_tuned", link_adaptive_tuned, 32, 32, packets_per_link_run },
+        { "wifi", wifi, 32, 32, packets_per_link_run },
+        { "wifi_scanned", wifi_scanned, 32, 32, packets_per_link_run },
+        { "fixed_clear", fixed_clear, RF24_hop_data, RF24_hop_data, packets_per_link_run },
+        { "fixed_jammed", fixed_jammed, RF24_hop_data, RF24_hop_data, packets_per_link_run },
+        { "hop_clear", hop_clear, RF24_hop_data, RF24_hop_data, packets_per_link_run },
+        { "hop_jammed", hop_jammed, RF24_hop_data, RF24_hop_data, packets_per_link_run },
+        { "half_duplex", half_duplex, RF24_duplex_data, RF24_duplex_data, packets_per_link_run },
+        { "duplex_both_ways", duplex_both_ways, RF24_duplex_data, RF24_duplex_data, packets_per_link_run },
+        { "duplex_one_way", duplex_one_way, RF24_duplex_data, RF24_duplex_data, packets_per_link_run },
+        { "duplex_striped", duplex_striped, RF24_duplex_data, RF24_duplex_data, packets_per_link_run },
+        { "readings_single", readings_single, 2, 6, packets_per_link_run },
+        { "readings_coalesced", readings_coalesced, 2, 6, packets_per_link_run },
+        { "shared_2", shared_2, RF24_tdma_data, RF24_tdma_data, packets_per_link_run },
+        { "shared_4", shared_4, RF24_tdma_data, RF24_tdma_data, packets_per_link_run },
+        { "shared_8", shared_8, RF24_tdma_data, RF24_tdma_data, packets_per_link_run },
+        { "tdma_2", tdma_2, RF24_tdma_data, RF24_tdma_data, packets_per_link_run },
+        { "tdma_4", tdma_4, RF24_tdma_data, RF24_tdma_data, packets_per_link_run },
+        { "tdma_8", tdma_8, RF24_tdma_data, RF24_tdma_data, packets_per_link_run },
+        { "mesh_1_hop", mesh_1_hop, RF24_mesh_data, RF24_mesh_data, packets_per_link_run },
+        { "mesh_2_hops", mesh_2_hops, RF24_mesh_data, RF24_mesh_data, packets_per_link_run },
+        { "mesh_3_hops", mesh_3_hops, RF24_mesh_data, RF24_mesh_data, packets_per_link_run },
+        { "mesh_across", mesh_across, RF24_mesh_data, RF24_mesh_data, packets_per_link_run }
+    };
+    static benchmark_result result;
+    print_header();
+    for (const scenario & s : scenarios){
+        for (int payload = s.first_payload; payload <= s.last_payload; payload++){
+            result = benchmark_result{ s.name, payload, s.packets, 0, 0, 0, {}, 0, 0, 0, 0 };
+            s.run(result);
+            print_result(result);
+        }
+    }
+    return 0;
+}
@@ -22,11 +22,70 @@
 RF24::RF24(hwlib::pin_out & CE, hwlib::pin_out & CSN, hwlib::spi_bus & SPI):
     CE( CE ),
     CSN( CSN ),
-    SPI( SPI )
+    SPI( SPI ),
+    IRQ( nullptr ),
+    handlers{ nullptr, nullptr, nullptr },
+    status( 0 ),
+    shadow_enabled( false ),
+    shadow_valid( 0 ),
+    tx_stream_rx_mode( false ),
+    tx_stream_active( false ),
+    tx_in_flight( 0 ),
+    tx_sent_pending( 0 ),
+    tx_failed_pending( 0 ),
+    tx_observation( false ),
+    rx_observation( false ),
+    stats{},
+    hwlib_spi( SPI, CSN ),
+    backend( &hwlib_spi ),
+    batch_depth( 0 ),
+    time_source( &RF24_hwlib_clock::instance() ),
+    ce_level( false ),
+    mode_config( 0 ),
+    standby_at( 0 ),
+    active_at( 0 ),
+    auto_power_down( false )
 {}
 
+RF24::RF24(hwlib::pin_out & CE, hwlib::pin_out & CSN, hwlib::spi_bus & SPI, hwlib::pin_in & IRQ):
+    RF24( CE, CSN, SPI )
+{
+    this->IRQ = &IRQ;
+}
+
+void RF24::apply(const RF24_register_sequence & sequence){
+    uint8_t data[6]; // Will hold our command byte along with the data.
+    uint8_t config = 0; // Will hold what we wrote to NRF_CONFIG.
+    this->set_ce(0); // Make sure the chip is idle.
+    this->begin_batch(); // Send the whole sequence in one go.
+    for (int i = 0; i < sequence.count; i++){
+        const RF24_register_write & write = sequence.writes[i];
+        if (write.length == 1){
+            this->write_register(write.reg, write.data[0]); // This keeps the shadow copy up to date.
+            if (write.reg == NRF_CONFIG) config = write.data[0];
+        }
+        else {
+            data[0] = (W_REGISTER | write.reg); // Create and set the command byte.
+            for (int j = 0; j < write.length; j++){
+                data[j + 1] = write.data[j];
+            }
+            this->queue_transfer(&*data, write.length + 1);
+        }
+    }
+    this->end_batch();
+    // Start listening if the chip is a powered up PRX now.
+    const uint8_t listening = (1 << PRIM_RX) | (1 << PWR_UP);
+    if ((config & listening) == listening) this->set_ce(1);
+    return;
+}
+
+void RF24::begin_batch(){
+    batch_depth++;
+    return;
+}
+
 bool RF24::check_bit(const uint8_t reg, const int bit){
-    uint8_t regsetting = this->read_register(reg); // Get register setting.
+    uint8_t regsetting = this->get_register(reg); // Get register setting.
     bool bitstate = (regsetting >> bit) & 1; // Check the bit-state.
     return bitstate;
 }
@@ -39,124 +98,501 @@ void RF24::clear_bit(const uint8_t reg, const int bit){
         regsetting |= (1 << bit); // Set the bit.
     }
     else {
-        regsetting = this->read_register(reg); // Get the actual register setting.
+        regsetting = this->get_register(reg); // Get the actual register setting.
         regsetting &= ~(1 << bit); // Clear the bit.
     }
     this->write_register(reg, regsetting); // Write the bit pattern.
     return;
 }
 
+RF24_clock & RF24::clock(){
+    return *time_source;
+}
+
+void RF24::enable_ack_payload(){
+    this->write_register(FEATURE, this->get_register(FEATURE) | (1 << EN_ACK_PAY) | (1 << EN_DPL));
+    return;
+}
+
 void RF24::enable_dynamic_payload(const uint8_t pipe){
     this->set_bit(FEATURE, EN_DPL); // Enable dynamic payload.
     this->set_bit(DYNPD, pipe); // Enable dynamic payload for this pipe.
     return;
 }
 
+void RF24::enable_rx_observation(const bool enable){
+    rx_observation = enable;
+    return;
+}
+
+void RF24::enable_shadow_registers(const bool enable){
+    shadow_enabled = enable;
+    shadow_valid = 0; // Forget everything we knew.
+    this->resync_shadow_registers();
+    return;
+}
+
+void RF24::enable_tx_observation(const bool enable){
+    tx_observation = enable;
+    return;
+}
+
+uint8_t RF24::end_batch(){
+    if (batch_depth > 0) batch_depth--;
+    if (batch_depth == 0) this->run_queue();
+    return status;
+}
+
 void RF24::flush_rx(){
     dataout[0] = FLUSH_RX; // Place command in first byte.
-    SPI.write_and_read(CSN, 1, &*dataout, nullptr); // Send command.
+    this->queue_transfer(&*dataout, 1); // Send command.
     return;
 }
 
 void RF24::flush_tx(){
     dataout[0] = FLUSH_TX; // Place command in first byte.
-    SPI.write_and_read(CSN, 1, &*dataout, nullptr); // Send command.
+    this->queue_transfer(&*dataout, 1); // Send command.
+    return;
+}
+
+uint8_t RF24::get_register(const uint8_t reg){
+    // Use the shadow copy if we have a valid one.
+    if (shadow_enabled && is_shadowed(reg) && ((shadow_valid >> reg) & 1)){
+        return shadow[reg];
+    }
+    return this->read_register(reg);
+}
+
+uint8_t RF24::handle_tx_status(const uint8_t status){
+    const bool sent = (status >> TX_DS) & 1;
+    const bool failed = (status >> MAX_RT) & 1;
+    if (!sent && !failed) return 0; // Nothing happened.
+    if (tx_observation) stats.retransmits += (this->read_register(OBSERVE_TX) >> ARC_CNT) & 0x0F;
+    if (sent){
+        // Find out how many payloads are still in the TX FIFO.
+        // A failed payload stays in the TX FIFO until we flush it, so it counts as well.
+        int left;
+        if ((status >> TX_FULL) & 1) left = 3;
+        else if ((this->read_register(FIFO_STATUS) >> TX_EMPTY) & 1) left = 0;
+        // There are one or two payloads left. If we had three in flight we can not tell which,
+        // so we count one payload as sent. If it was two, the next TX_DS or TX_EMPTY will catch up.
+        else left = (tx_in_flight >= 3) ? 2 : tx_in_flight - 1;
+        if (left < 0) left = 0;
+        if (left > tx_in_flight) left = tx_in_flight;
+        tx_sent_pending += tx_in_flight - left;
+        stats.tx_acked += tx_in_flight - left;
+        tx_in_flight = left;
+    }
+    if (failed){
+        // The chip will not send anything until MAX_RT is cleared, and it would retry the same payload.
+        // Flush it so we can go on. Everything that was still in the TX FIFO is gone now.
+        this->flush_tx();
+        tx_failed_pending += tx_in_flight;
+        stats.tx_failed += tx_in_flight;
+        stats.max_rt_events++;
+        tx_in_flight = 0;
+    }
+    // These are the flags we handled.
+    return status & ((1 << TX_DS) | (1 << MAX_RT));
+}
+
+void RF24::hub_address(const uint8_t* base, const uint8_t pipe, uint8_t* address){
+    for (int i = 0; i < 5; i++){
+        address[i] = base[i];
+    }
+    address[0] = base[0] + pipe; // Only the first byte is unique per pipe.
     return;
 }
 
 bool RF24::init(){
     CSN.set(1); // SPI Chip Select is active low, so we set it high now.
-    CE.set(0); // Chip Enable.
-    hwlib::wait_ms(10); // Let the chip settle.
+    this->set_ce(0); // Chip Enable.
     // Test the chip. If a chip just powered up, the status register will be 1110.
-    if (this->read_register(NRF_STATUS) == 0xE) return true;
-    else return false;
+    // Reading NRF_CONFIG gives us the status register as well, and tells us if the chip is powered up.
+    // A chip that is still in its power on reset does not answer yet, so try again for up to 10 ms.
+    this->read_register(NRF_CONFIG);
+    for (int ms = 0; status != 0xE; ms++){
+        if (ms == 10) return false;
+        this->wait_ms(1);
+        this->read_register(NRF_CONFIG);
+    }
+    standby_at = 0; // If the chip is powered up, it has been for a while.
+    active_at = 0;
+    this->resync_shadow_registers(); // The chip might have been reset, so reload the shadow copy.
+    return true;
+}
+
+bool RF24::init(const RF24_register_sequence & sequence){
+    if (!this->init()) return false;
+    this->apply(sequence);
+    return true;
+}
+
+bool RF24::is_shadowed(const uint8_t reg){
+    switch (reg){
+        case NRF_CONFIG:
+        case EN_AA:
+        case EN_RXADDR:
+        case SETUP_AW:
+        case SETUP_RETR:
+        case RF_CH:
+        case RF_SETUP:
+        case RX_PW_P0:
+        case RX_PW_P1:
+        case RX_PW_P2:
+        case RX_PW_P3:
+        case RX_PW_P4:
+        case RX_PW_P5:
+        case DYNPD:
+        case FEATURE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint8_t RF24::last_status() const{
+    return status;
+}
+
+void RF24::mask_irq(const bool rx_dr, const bool tx_ds, const bool max_rt){
+    uint8_t regsetting = this->get_register(NRF_CONFIG); // Get the actual register setting.
+    regsetting &= ~((1 << MASK_RX_DR) | (1 << MASK_TX_DS) | (1 << MASK_MAX_RT)); // Clear all mask bits.
+    regsetting |= (rx_dr << MASK_RX_DR) | (tx_ds << MASK_TX_DS) | (max_rt << MASK_MAX_RT); // Set the ones we want.
+    this->write_register(NRF_CONFIG, regsetting);
+    return;
+}
+
+void RF24::observe_rx(){
+    if (rx_observation && ((this->read_register(FIFO_STATUS) >> RX_FULL) & 1)) stats.rx_overruns++;
+    return;
+}
+
+int RF24::payload_length(const RF24_span* spans, const int count){
+    int bytes = 0;
+    for (int i = 0; i < count; i++){
+        bytes += spans[i].length;
+    }
+    return bytes;
+}
+
+RF24::tx_result RF24::poll(){
+    // If we have results waiting, return those first. Sent payloads were always in front of failed ones.
+    if (tx_sent_pending == 0 && tx_failed_pending == 0){
+        if (tx_in_flight == 0) return tx_result::idle; // Nothing to wait for.
+        // Nothing is done while the chip starts up after a power down, which takes RF24_power_up_us.
+        if (time_source->now_us() < standby_at) return tx_result::pending;
+        const uint8_t done = this->handle_tx_status(this->update_status()); // Check if anything is done.
+        if (done) this->write_register(NRF_STATUS, done); // Clear the flags, writing a '1' clears a flag.
+    }
+    tx_result result = tx_result::pending;
+    if (tx_sent_pending > 0){
+        tx_sent_pending--;
+        result = tx_result::sent;
+    }
+    else if (tx_failed_pending > 0){
+        tx_failed_pending--;
+        result = tx_result::failed;
+    }
+    else return result;
+    // Power down between bursts, after the result of the last payload.
+    if (auto_power_down && tx_stream_active && tx_in_flight == 0 && tx_sent_pending == 0 && tx_failed_pending == 0){
+        this->power_down();
+    }
+    return result;
+}
+
+void RF24::power_down(){
+    if (!((mode_config >> PWR_UP) & 1)) return; // Already powered down.
+    this->write_register(NRF_CONFIG, this->get_register(NRF_CONFIG) & ~(1 << PWR_UP));
+    return;
+}
+
+RF24_power_state RF24::power_state(){
+    const uint_fast64_t now = time_source->now_us();
+    if (!((mode_config >> PWR_UP) & 1) || now < standby_at) return RF24_power_state::power_down;
+    if (!ce_level || now < active_at) return RF24_power_state::standby_1;
+    if ((mode_config >> PRIM_RX) & 1) return RF24_power_state::rx;
+    return (tx_in_flight > 0) ? RF24_power_state::tx : RF24_power_state::standby_2;
+}
+
+void RF24::power_up(){
+    if ((mode_config >> PWR_UP) & 1) return; // Already powered up.
+    this->write_register(NRF_CONFIG, this->get_register(NRF_CONFIG) | (1 << PWR_UP)); // track_config() notes the time.
+    return;
+}
+
+void RF24::queue_transfer(uint8_t* data, const int bytes){
+    if (batch_depth == 0){
+        this->transfer(data, bytes); // Not in a batch, send it now.
+        return;
+    }
+    uint8_t* queued = queue.add(bytes);
+    if (queued == nullptr){
+        this->run_queue(); // The queue is full, send what we have.
+        queued = queue.add(bytes);
+    }
+    for (int i = 0; i < bytes; i++){
+        queued[i] = data[i];
+    }
+    return;
 }
 
 uint8_t* RF24::receive(){
-    // If there is data ready for us, read it.
-    if (this->check_bit(NRF_STATUS, RX_DR)){
-        CE.set(0); // Stop listening for incomming data.
-        const int bytes = this->read_rx_payload_width() + 1; // Check the number of bytes we have.
-        tx_payload[0] = R_RX_PAYLOAD; // Set the reading command.
-        SPI.write_and_read( CSN, bytes, &*tx_payload, &*rx_payload ); // Get our data.
-        rx_payload[0] = bytes; // Set the first element of our array to the amount of bytes we have.
-        this->clear_bit(NRF_STATUS, RX_DR); // Clear the status register.
-        CE.set(1);
+    static uint8_t payload[33]; // The length first, then the data.
+    const RF24_packet_view packet = this->receive_into(&payload[1], 32);
+    payload[0] = (packet.length > 0) ? packet.length + 1 : 0; // There is no data, unless we read some.
+    return payload;
+}
+
+int RF24::receive_burst(RF24_packet_sink & sink, const int max_packets){
+    int packets = 0;
+    bool observed = false; // Holds if FIFO_STATUS was read in this burst.
+    for (;;){
+        // Reading the payload width also gives us the status register.
+        // RX_P_NO in the status register is 111 when the RX FIFO is empty.
+        const int width = this->read_rx_payload_width();
+        const uint8_t pipe = (status >> RX_P_NO) & 0x07;
+        if (pipe == 0x07){
+            if (!((status >> RX_DR) & 1)) break; // Nothing left to do.
+            // Clear RX_DR, now the RX FIFO is empty.
+            // The status byte of this write tells us if a new packet arrived meanwhile.
+            this->write_register(NRF_STATUS, (1 << RX_DR));
+            if (((status >> RX_P_NO) & 0x07) == 0x07) break;
+            observed = false; // The RX FIFO was empty, it may have filled up again.
+            continue;
+        }
+        if (packets == max_packets) break; // There is more data, but it is left in the RX FIFO.
+        if (!observed){
+            // The RX FIFO is at its fullest before we read from it.
+            this->observe_rx();
+            observed = true;
+        }
+        if (width > 32){
+            this->flush_rx(); // The packet is corrupt, the datasheet tells us to throw it away.
+            stats.rx_discarded++;
+            continue;
+        }
+        uint8_t* frame = sink.reserve(pipe, width);
+        if (frame == nullptr) break; // No room, leave the data in the RX FIFO.
+        frame[0] = R_RX_PAYLOAD; // Set the reading command in front of the payload.
+        this->transfer(frame, width + 1); // Get our data, straight into the sink.
+        sink.commit(pipe, width);
+        packets++;
+        stats.rx_packets[pipe]++;
     }
-    // There is no data.
-    else{
-        rx_payload[0] = 0;
+    return packets;
+}
+
+RF24_packet_view RF24::receive_into(uint8_t* buffer, const int size){
+    RF24_packet_view packet{ buffer, 0, 0 }; // There is no data, unless we read some.
+    for (;;){
+        // The same checks as receive_burst(), for one packet.
+        const int width = this->read_rx_payload_width();
+        const uint8_t pipe = (status >> RX_P_NO) & 0x07;
+        if (pipe == 0x07){
+            if (!((status >> RX_DR) & 1)) break;
+            this->write_register(NRF_STATUS, (1 << RX_DR));
+            if (((status >> RX_P_NO) & 0x07) == 0x07) break;
+            continue;
+        }
+        if (packet.length > 0) break; // There is more data, but it is left in the RX FIFO.
+        if (width > 32){
+            this->flush_rx(); // The packet is corrupt, the datasheet tells us to throw it away.
+            stats.rx_discarded++;
+            continue;
+        }
+        if (width > size) break; // No room, leave the data in the RX FIFO.
+        this->observe_rx();
+        // The command goes out from here, the payload comes in straight into the buffer, in one frame.
+        // Reading the width and FIFO_STATUS ran the queue, so there is room for both segments.
+        uint8_t command = R_RX_PAYLOAD;
+        queue.add(&command, &command, 1, false);
+        queue.add(nullptr, buffer, width, true);
+        this->run_queue();
+        packet.length = width;
+        packet.pipe = pipe;
+        stats.rx_packets[pipe]++;
+        // Go round once more, so RX_DR is cleared if this was the last packet.
     }
-    return rx_payload;
+    return packet;
 }
 
 uint8_t RF24::read_register(const uint8_t reg){
     dataout[0] = (R_REGISTER | reg); // Create our command and set it.
     dataout[1] = NOP; // Dummy byte.
-    SPI.write_and_read( CSN, 2, &*dataout, &*datain ); // Send command and get our answer.
-    return datain[1]; // Our asnwer is in the second byte.
+    this->transfer(&*dataout, 2); // Send command and get our answer.
+    if (reg == NRF_CONFIG) mode_config = dataout[1];
+    // Keep the shadow copy up to date with what the chip told us.
+    if (shadow_enabled && is_shadowed(reg)){
+        shadow[reg] = dataout[1];
+        shadow_valid |= (1UL << reg);
+    }
+    return dataout[1]; // Our asnwer is in the second byte.
 }
 
 int RF24::read_rx_payload_width(){
     dataout[0] = R_RX_PL_WID; // Set the command.
     dataout[1] = NOP; // Dummy byte.
-    SPI.write_and_read( CSN, 2, &*dataout, &*datain ); // Send command and get our answer.
-    return datain[1]; // Our answer is in the second byte.
+    this->transfer(&*dataout, 2); // Send command and get our answer.
+    return dataout[1]; // Our answer is in the second byte.
+}
+
+bool RF24::received_power(){
+    return (this->read_register(RPD) & 1);
+}
+
+int RF24::request(const uint8_t* data, const int bytes, RF24_packet_sink & response){
+    if (!this->try_send(data, bytes)) return -1;
+    if (this->wait_tx_result() != tx_result::sent) return -1;
+    return this->receive_burst(response); // The response is in the RX FIFO, if the PRX had one for us.
+}
+
+void RF24::reset_statistics(){
+    stats = RF24_statistics{};
+    return;
+}
+
+void RF24::resync_shadow_registers(){
+    if (!shadow_enabled) return;
+    // Read every shadowed register, read_register() will store it in the shadow copy.
+    for (uint8_t reg = 0; reg <= FEATURE; reg++){
+        if (is_shadowed(reg)) this->read_register(reg);
+    }
+    return;
+}
+
+void RF24::run_queue(){
+    if (queue.empty()) return;
+    stats.spi_transactions += queue.frames();
+    status = queue.run(*backend); // The first byte of the last frame is the status register.
+    return;
 }
 
 bool RF24::send(const uint8_t* data, const int bytes){
-    if (bytes > 32) return false; // We can only send up to 32 bytes, return false if it's more.
-    CE.set(0); // Make sure the chip is idle.
+    if ((bytes < 0) || (bytes > 32)) return false; // We can only send up to 32 bytes, return false if it's more.
+    const RF24_span span{ data, (uint8_t)bytes };
+    return this->send(&span, 1);
+}
+
+bool RF24::send(const RF24_span* spans, const int count){
+    if (payload_length(spans, count) > 32) return false; // We can only send up to 32 bytes, return false if it's more.
+    this->set_ce(0); // Make sure the chip is idle.
     bool RX_mode = this->check_bit(NRF_CONFIG, PRIM_RX); // Save the role of the chip.
     if (RX_mode) this->clear_bit(NRF_CONFIG, PRIM_RX); // If the chip is in RX mode, set it to TX.
+    this->power_up(); // Only if it is powered down, the chip starts up while we load the payload.
     this->flush_tx(); // Flush tx register so we are sure there is no junk in it.
-    // Copy the data in our payload array.
-    for (int i = 0; i < bytes; i++){
-        tx_payload[i + 1] = data[i];
-    }
-    tx_payload[0] = W_TX_PAYLOAD; // Set our command at the first index.
-    SPI.write_and_read( CSN, (bytes + 1), &*tx_payload, nullptr ); // Send the payload to the chip.
-    CE.set(1);  // Broadcast the payload.
-    hwlib::wait_us(10); // Give the chip some time to send.
-    CE.set(0); // Stop the broadcast.
-    hwlib::wait_ms(1); // Wait for the chip to settle.
-    // Check if sending was succesfull.
-    if (this->check_bit(NRF_STATUS, TX_DS)){
-        this->clear_bit(NRF_STATUS, TX_DS);
-        // If the chip was in RX mode, set it back. Else, leave it in TX mode.
-        if (RX_mode) {
-            this->set_bit(NRF_CONFIG, PRIM_RX);
-            CE.set(1);
-        }
-        return true;
+    // Forget the results of earlier payloads, they were flushed.
+    stats.tx_failed += tx_in_flight;
+    tx_in_flight = 0;
+    tx_sent_pending = 0;
+    tx_failed_pending = 0;
+    bool sent = false;
+    if (this->try_send(spans, count)){
+        this->set_ce(1);  // Broadcast the payload.
+        sent = (this->wait_tx_result() == tx_result::sent);
+        this->set_ce(0); // Stop the broadcast.
     }
-    else {
-        // If the chip was in RX mode, set it back. Else, leave it in TX mode.
-        if (RX_mode) {
-            this->set_bit(NRF_CONFIG, PRIM_RX);
-            CE.set(1);
-        }
-        return false;
+    // If the chip was in RX mode, set it back. Else, leave it in TX mode.
+    if (RX_mode) {
+        this->set_bit(NRF_CONFIG, PRIM_RX);
+        this->set_ce(1);
     }
+    else if (auto_power_down) this->power_down();
+    return sent;
+}
+
+bool RF24::service(){
+    if (IRQ != nullptr && IRQ->get()) return false; // The IRQ pin is high, so the chip has nothing for us.
+    const uint8_t events = this->update_status();
+    const bool rx_ready = ((events >> RX_DR) & 1) && handlers[RX_DR - MAX_RT] != nullptr;
+    const bool tx_sent = ((events >> TX_DS) & 1) && handlers[TX_DS - MAX_RT] != nullptr;
+    const bool max_rt = ((events >> MAX_RT) & 1) && handlers[MAX_RT - MAX_RT] != nullptr;
+    uint8_t clear = 0; // The flags we handle.
+    if (rx_ready) clear |= (1 << RX_DR);
+    // Only pass the TX flags we have a handler for, the others are left for poll().
+    if (tx_sent || max_rt) clear |= this->handle_tx_status(events & ((tx_sent << TX_DS) | (max_rt << MAX_RT) | (1 << TX_FULL)));
+    if (clear == 0) return false;
+    // Clear the flags first, so an event that happens while a handler runs is not lost.
+    this->write_register(NRF_STATUS, clear);
+    if (rx_ready) handlers[RX_DR - MAX_RT]->handle(*this, RX_DR);
+    if (tx_sent) handlers[TX_DS - MAX_RT]->handle(*this, TX_DS);
+    if (max_rt) handlers[MAX_RT - MAX_RT]->handle(*this, MAX_RT);
+    return true;
+}
+
+void RF24::set_auto_power_down(const bool enable){
+    auto_power_down = enable;
+    return;
 }
 
 void RF24::set_bit(const uint8_t reg, const int bit){
-    uint8_t regsetting = this->read_register(reg); // Get actual register setting.
+    uint8_t regsetting = this->get_register(reg); // Get actual register setting.
     regsetting |= (1 << bit); // Set the bit we want to change.
     this->write_register(reg, regsetting); // Write back the new register setting.
     return;
 }
 
+void RF24::set_ce(const bool level){
+    this->run_queue();
+    CE.set(level);
+    if (level && !ce_level){
+        // The chip settles after it is done starting up.
+        const uint_fast64_t now = time_source->now_us();
+        active_at = ((standby_at > now) ? standby_at : now) + RF24_settle_us;
+    }
+    ce_level = level;
+    return;
+}
+
 void RF24::set_channel(const int channel){
     this->write_register(RF_CH, channel);
     return;
 }
 
+void RF24::set_clock(RF24_clock & clock){
+    time_source = &clock;
+    // Times of the old clock mean nothing to the new one, take a transition that is going on as done.
+    standby_at = 0;
+    active_at = 0;
+    return;
+}
+
+void RF24::set_data_rate(const RF24_data_rate rate){
+    uint8_t setup = this->get_register(RF_SETUP) & ~((1 << RF_DR_LOW) | (1 << RF_DR_HIGH));
+    if (rate == RF24_data_rate::rate_250kbps) setup |= (1 << RF_DR_LOW);
+    else if (rate == RF24_data_rate::rate_2mbps) setup |= (1 << RF_DR_HIGH);
+    // 1 Mbps has both bits cleared.
+    this->write_register(RF_SETUP, setup);
+    return;
+}
+
+void RF24::set_event_handler(const uint8_t event, RF24_event_handler* handler){
+    if (event < MAX_RT || event > RX_DR) return; // Not an event.
+    handlers[event - MAX_RT] = handler;
+    return;
+}
+
+void RF24::set_pa_level(const RF24_pa_level level){
+    uint8_t setup = this->get_register(RF_SETUP) & ~(0x03 << RF_PWR_LOW); // RF_PWR is two bits.
+    setup |= (uint8_t(level) << RF_PWR_LOW);
+    this->write_register(RF_SETUP, setup);
+    return;
+}
+
 void RF24::set_payload_width(const uint8_t pipe, const int bytes){
     this->write_register(pipe, bytes);
 }
 
+void RF24::set_retries(const int delay_us, const int count){
+    int delay = (delay_us + 249) / 250; // Steps of 250 us, rounded up.
+    if (delay < 1) delay = 1;
+    if (delay > 16) delay = 16;
+    const int retries = (count < 0) ? 0 : ((count > 15) ? 15 : count);
+    this->write_register(SETUP_RETR, ((delay - 1) << ARD) | retries);
+    return;
+}
+
 void RF24::set_rx_address(const uint8_t pipe, const uint8_t* address){
     uint8_t data[6]; // Will hold our command byte along with the address.
     data[0] = (W_REGISTER | pipe); // Create and set the command byte.
@@ -167,16 +603,22 @@ void RF24::set_rx_address(const uint8_t pipe, const uint8_t* address){
         for (int i = 0; i < 5; i++){
             data[i + 1] = address[i];
         }
-        SPI.write_and_read( CSN, 6, &*data, nullptr ); // Sent the new address to the chip.
+        this->queue_transfer(&*data, 6); // Sent the new address to the chip.
     }
     else {
         // Pipe 2, 3, 4 and 5 only have one changable address byte.
         data[1] = address[0]; // Set the new address byte in our array.
-        SPI.write_and_read( CSN, 2, &*data, nullptr ); // Sent the new address to the chip.
+        this->queue_transfer(&*data, 2); // Sent the new address to the chip.
     }
     return;
 }
 
+void RF24::set_spi_backend(RF24_spi_backend & backend){
+    this->run_queue();
+    this->backend = &backend;
+    return;
+}
+
 void RF24::set_tx_address(const uint8_t* address){
     uint8_t data[6]; // Will hold our command byte along with the address.
     data[0] = (W_REGISTER | TX_ADDR); // Create and set our command.
@@ -184,7 +626,7 @@ void RF24::set_tx_address(const uint8_t* address){
     for (int i = 0; i < 5; i++){
         data[i + 1] = address[i];
     }
-    SPI.write_and_read( CSN, 6, &*data, nullptr ); // Sent the new address to the chip.
+    this->queue_transfer(&*data, 6); // Sent the new address to the chip.
     return;
 }
 
@@ -196,12 +638,208 @@ void RF24::start_easy_mode(){
     this->enable_dynamic_payload(DPL_P0); // Enable dynamic payload.
     this->set_bit(NRF_CONFIG, PRIM_RX); // Set the chip to RX mode.
     this->set_bit(NRF_CONFIG, PWR_UP); // Power up the chip.
-    CE.set(1); // Activate the chip.
+    this->set_ce(1); // Activate the chip.
+}
+
+void RF24::start_hub_mode(const uint8_t* base){
+    uint8_t address[5]; // Will hold the address of a pipe.
+    this->set_ce(0); // Make sure the chip is idle.
+    // Pipe 0 and 1 have a full address, pipe 2-5 only the first byte.
+    for (uint8_t pipe = 0; pipe < 6; pipe++){
+        hub_address(base, pipe, &*address);
+        this->set_rx_address(RX_ADDR_P0 + pipe, &*address);
+    }
+    this->write_register(EN_RXADDR, 0x3F); // Enable all pipes.
+    this->write_register(EN_AA, 0x3F); // Auto acknowledge on all pipes.
+    this->write_register(DYNPD, 0x3F); // Dynamic payload on all pipes.
+    this->write_register(FEATURE, this->get_register(FEATURE) | (1 << EN_DPL)); // Enable dynamic payload.
+    this->write_register(NRF_CONFIG, this->get_register(NRF_CONFIG) | (1 << PRIM_RX) | (1 << PWR_UP)); // RX mode, powered up.
+    this->set_ce(1); // Start listening.
+    return;
+}
+
+void RF24::start_tx_stream(){
+    this->set_ce(0); // Make sure the chip is idle.
+    tx_stream_rx_mode = this->check_bit(NRF_CONFIG, PRIM_RX); // Save the role of the chip.
+    if (tx_stream_rx_mode) this->clear_bit(NRF_CONFIG, PRIM_RX); // Set the chip to TX mode.
+    this->set_ce(1); // Keep CE high, the chip will send everything we put in the TX FIFO.
+    tx_stream_active = true;
+    return;
+}
+
+RF24_statistics RF24::statistics() const{
+    return stats;
+}
+
+void RF24::stop_tx_stream(){
+    this->set_ce(0); // Stop sending.
+    tx_stream_active = false;
+    // If the chip was in RX mode, set it back.
+    if (tx_stream_rx_mode){
+        this->set_bit(NRF_CONFIG, PRIM_RX);
+        this->set_ce(1);
+    }
+    return;
+}
+
+void RF24::track_config(const uint8_t config){
+    const uint_fast64_t now = time_source->now_us();
+    if (((config >> PWR_UP) & 1) && !((mode_config >> PWR_UP) & 1)){
+        // Powering up takes Tpd2stby, a chip with CE high settles after that.
+        standby_at = now + RF24_power_up_us;
+        active_at = standby_at + RF24_settle_us;
+    }
+    else if (ce_level && ((config ^ mode_config) >> PRIM_RX) & 1){
+        active_at = ((standby_at > now) ? standby_at : now) + RF24_settle_us; // Switching between RX and TX settles as well.
+    }
+    mode_config = config;
+    return;
+}
+
+uint8_t RF24::transfer(uint8_t* data, const int bytes){
+    // The answer of the chip replaces what we sent, the first byte is always the status register.
+    if (!queue.add(data, bytes)){
+        this->run_queue();
+        queue.add(data, bytes);
+    }
+    this->run_queue();
+    return status;
+}
+
+bool RF24::try_send(const uint8_t* data, const int bytes, const bool ack){
+    if ((bytes < 1) || (bytes > 32)) return false; // We can only send 1 up to 32 bytes.
+    const RF24_span span{ data, (uint8_t)bytes };
+    return this->try_send(&span, 1, ack);
+}
+
+bool RF24::try_send(const RF24_span* spans, const int count, const bool ack){
+    const int bytes = payload_length(spans, count);
+    if ((bytes < 1) || (bytes > 32)) return false; // We can only send 1 up to 32 bytes.
+    // If the TX FIFO is full, check if something is done.
+    if (tx_in_flight >= 3){
+        const uint8_t done = this->handle_tx_status(this->update_status());
+        if (done) this->write_register(NRF_STATUS, done); // Clear the flags, writing a '1' clears a flag.
+    }
+    if (tx_in_flight >= 3) return false; // Still full, try again later.
+    if (!((mode_config >> PWR_UP) & 1)) this->power_up(); // The chip starts up while the payload is loaded.
+    this->write_payload(ack ? W_TX_PAYLOAD : W_TX_PAYLOAD_NO_ACK, spans, count); // Send the payload to the chip.
+    tx_in_flight++;
+    stats.tx_packets++;
+    return true;
+}
+
+uint8_t RF24::update_status(){
+    dataout[0] = NOP; // The NOP command only makes the chip send its status register.
+    return this->transfer(&*dataout, 1);
+}
+
+bool RF24::verify_shadow_registers(){
+    bool match = true;
+    for (uint8_t reg = 0; reg <= FEATURE; reg++){
+        if (!shadow_enabled || !is_shadowed(reg) || !((shadow_valid >> reg) & 1)) continue;
+        const uint8_t copy = shadow[reg]; // Remember what we think the register holds.
+        // read_register() will correct the shadow copy if it was wrong.
+        if (this->read_register(reg) != copy) match = false;
+    }
+    return match;
+}
+
+void RF24::wait_ms(const int ms){
+    time_source->wait_us(ms * 1000);
+    stats.blocked_us += ms * 1000;
+    return;
+}
+
+void RF24::wait_ready(){
+    if (!((mode_config >> PWR_UP) & 1)) return; // Nothing will happen.
+    const uint_fast64_t ready = ce_level ? active_at : standby_at;
+    const uint_fast64_t now = time_source->now_us();
+    if (ready <= now) return;
+    time_source->wait_us(ready - now);
+    stats.blocked_us += (uint32_t)(ready - now);
+    return;
+}
+
+RF24::tx_result RF24::wait_tx_result(){
+    // Wait for the chip to tell us how it went. With the maximum retransmit settings this takes about 66 ms,
+    // so if we have not heard anything after 100 ms the chip is not responding.
+    const uint_fast64_t start = time_source->now_us();
+    this->wait_ready(); // After a power up, nothing is sent before the chip is up and settled.
+    const uint_fast64_t ready = time_source->now_us();
+    const uint_fast64_t deadline = ready + 100000;
+    // Every poll costs an SPI transaction, so do not poll before the acknowledge can be there:
+    // the chip must have settled in TX mode, and turned around to listen for it.
+    const uint_fast64_t first_poll = ((ready > start + RF24_settle_us) ? ready : start + RF24_settle_us) + RF24_settle_us;
+    time_source->wait_us(first_poll - ready);
+    tx_result result = this->poll();
+    while (result == tx_result::pending && time_source->now_us() < deadline){
+        time_source->wait_us(RF24_tx_poll_us);
+        result = this->poll();
+    }
+    stats.blocked_us += (uint32_t)(time_source->now_us() - ready); // wait_ready() counted the rest.
+    if (result == tx_result::pending){
+        this->flush_tx(); // Give up on the payload.
+        stats.tx_failed += tx_in_flight;
+        tx_in_flight = 0;
+        result = tx_result::failed;
+    }
+    return result;
+}
+
+void RF24::wait_us(const uint32_t us){
+    time_source->wait_us(us);
+    stats.blocked_us += us;
+    return;
+}
+
+bool RF24::write_ack_payload(const uint8_t pipe, const uint8_t* data, const int bytes){
+    if ((bytes < 1) || (bytes > 32) || (pipe > 5)) return false; // We can only send 1 up to 32 bytes.
+    const RF24_span span{ data, (uint8_t)bytes };
+    this->write_payload(W_ACK_PAYLOAD | pipe, &span, 1);
+    this->run_queue(); // In a batch the payload was queued, we need its status byte now.
+    // The status byte is from before the write, if the TX FIFO was full the chip ignored the payload.
+    return !((status >> TX_FULL) & 1);
+}
+
+void RF24::write_payload(const uint8_t command, const RF24_span* spans, const int count){
+    int pieces = 0; // Spans with data, empty spans are not sent.
+    for (int i = 0; i < count; i++){
+        if (spans[i].length > 0) pieces++;
+    }
+    // Sent from where they are, the command and the spans each take a segment of the empty queue.
+    if (batch_depth > 0 || pieces + 1 > RF24_spi_queue_segments){
+        // Put the frame together, it is copied into the queue or sent right away.
+        uint8_t frame[RF24_spi_frame_bytes];
+        int bytes = 0;
+        frame[bytes++] = command;
+        for (int i = 0; i < count; i++){
+            for (int j = 0; j < spans[i].length; j++){
+                frame[bytes++] = spans[i].data[j];
+            }
+        }
+        this->queue_transfer(&*frame, bytes);
+        return;
+    }
+    // Not in a batch, so the queue is empty and the spans are sent straight from where they are.
+    uint8_t head = command; // The chip answers with the status register.
+    queue.add(&head, &head, 1, false);
+    for (int i = 0; i < count; i++){
+        if (spans[i].length == 0) continue;
+        queue.add(spans[i].data, nullptr, spans[i].length, --pieces == 0);
+    }
+    this->run_queue();
+    return;
 }
 
 void RF24::write_register(const uint8_t reg, const uint8_t value){
     dataout[0] = (W_REGISTER | reg); // Create our command and set it.
     dataout[1] = value; // Hold the new register setting.
-    SPI.write_and_read( CSN, 2, &*dataout, nullptr ); // Send our new register setting to the chip.
+    this->queue_transfer(&*dataout, 2); // Send our new register setting to the chip.
+    if (reg == NRF_CONFIG) this->track_config(value);
+    // The chip now holds what we wrote, so the shadow copy does too.
+    if (shadow_enabled && is_shadowed(reg)){
+        shadow[reg] = value;
+        shadow_valid |= (1UL << reg);
+    }
     return;
 }
\ No newline at end of file
@@ -23,6 +23,72 @@
 
 #include "hwlib.hpp"
 #include "nRF24L01.h"
+#include "RF24_packet.hpp"
+#include "RF24_config.hpp"
+#include "RF24_spi.hpp"
+#include "RF24_clock.hpp"
+
+class RF24;
+
+/// \brief
+/// Something that handles an event of the nRF24L01+.
+/// \details
+/// A handler can be registered for the RX_DR, TX_DS and MAX_RT events with RF24::set_event_handler().
+/// It is called by RF24::service() after the event flag has been cleared.
+class RF24_event_handler {
+public:
+    /// \brief
+    /// This will handle an event.
+    /// \details
+    /// The event is the bit of the flag in the status register: RX_DR, TX_DS or MAX_RT.
+    /// An RX_DR handler should read the RX FIFO, for example with RF24::receive_burst().
+    virtual void handle(RF24 & radio, const uint8_t event) = 0;
+};
+
+/// \brief
+/// Counters of what an RF24 has done, see RF24::statistics().
+/// \details
+/// Counting costs no extra SPI transactions, except for retransmits and RX FIFO overruns,
+/// see RF24::enable_tx_observation() and RF24::enable_rx_observation().
+/// The counters wrap around at 2^32.
+struct RF24_statistics {
+    uint32_t tx_packets; /// Payloads written to the TX FIFO.
+    uint32_t tx_acked; /// Payloads that were sent, and acknowledged if auto acknowledge is used.
+    uint32_t tx_failed; /// Payloads that failed, or were thrown away because they were still in flight.
+    uint32_t max_rt_events; /// Number of times MAX_RT was set.
+    uint32_t retransmits; /// Retransmits counted from OBSERVE_TX, only with enable_tx_observation().
+    uint32_t rx_packets[6]; /// Packets read per pipe.
+    uint32_t rx_overruns; /// Number of times the RX FIFO was found full, only with enable_rx_observation().
+    uint32_t rx_discarded; /// Number of times the RX FIFO was flushed because of a corrupt payload width.
+    uint32_t spi_transactions; /// SPI transactions with the chip.
+    uint32_t blocked_us; /// Microseconds spent in waits and in blocking calls waiting for the chip.
+};
+
+/// \brief
+/// The operational modes of the nRF24L01+, see RF24::power_state().
+enum class RF24_power_state : uint8_t {
+    power_down, /// PWR_UP is clear, or the crystal oscillator is still starting up.
+    standby_1, /// Powered up with CE low, or settling after CE went high.
+    standby_2, /// A PTX with CE high and an empty TX FIFO.
+    rx, /// A PRX with CE high, listening.
+    tx /// A PTX with CE high, sending what is in the TX FIFO.
+};
+
+/// \brief
+/// Transition times of the nRF24L01+, in microseconds.
+/// \details
+/// Tpd2stby is the start up from power down to standby-I, with a crystal of less than 30 mH.
+/// Tstby2a is the settling from standby to RX or TX mode after CE went high.
+const uint32_t RF24_power_up_us = 1500;
+const uint32_t RF24_settle_us = 130;
+
+/// \brief
+/// Time between two polls of the status while send() or request() waits for the result, in microseconds.
+/// \details
+/// The acknowledge can not come before the chip settled in TX mode and turned around to listen for it,
+/// so the first poll is 2 * RF24_settle_us after the payload was loaded, or RF24_settle_us after the chip is up
+/// and settled when it was powered down. The polls after that are this far apart.
+const uint32_t RF24_tx_poll_us = 50;
 
 /// \brief
 /// nRF24L01+ library
@@ -61,14 +127,123 @@
 /// range.
 ///
 class RF24 {
+public:
+    /// \brief
+    /// The result of a payload given to try_send(), as reported by poll().
+    enum class tx_result {
+        idle, /// There are no payloads in flight.
+        pending, /// There are payloads in flight, but none of them is done yet.
+        sent, /// A payload has been sent, and acknowledged if auto acknowledge is used.
+        failed /// A payload has not been acknowledged after all retransmits (MAX_RT).
+    };
+    
 private:
     hwlib::pin_out & CE; /// Chip Enable" pin, activates the RX or TX role.
     hwlib::pin_out & CSN; /// SPI Chip select.
     hwlib::spi_bus & SPI; /// SPI bus.
-    uint8_t rx_payload[33]; /// Will hold the data wich has been received.
-    uint8_t tx_payload[33]; /// Will hold the data that will be transmitted.
-    uint8_t dataout[2]; /// Will hold the SPI command and the dummy byte.
-    uint8_t datain[2]; /// Will hold the answer from the RF24 module. First data will always be the status register.
+    hwlib::pin_in* IRQ; /// Interrupt pin, active low. nullptr if it is not connected.
+    RF24_event_handler* handlers[3]; /// The handlers for MAX_RT, TX_DS and RX_DR, indexed by bit - MAX_RT.
+    uint8_t dataout[2]; /// Will hold the SPI command and the dummy byte, and after the transaction the answer of the chip.
+    uint8_t status; /// The status register, as clocked out by the chip during the last SPI transaction.
+    bool shadow_enabled; /// When true, configuration registers are served from the shadow copy.
+    uint32_t shadow_valid; /// One bit per register, set when the shadow copy of that register is known to be correct.
+    uint8_t shadow[FEATURE + 1]; /// Shadow copy of the register map, indexed by register address.
+    bool tx_stream_rx_mode; /// Holds if the chip was in RX mode when the TX stream was started.
+    bool tx_stream_active; /// Holds if a TX stream is running.
+    uint8_t tx_in_flight; /// Number of payloads in the TX FIFO of which the result is not known yet.
+    uint8_t tx_sent_pending; /// Number of payloads that were sent, but not reported by poll() yet.
+    uint8_t tx_failed_pending; /// Number of payloads that failed, but not reported by poll() yet.
+    bool tx_observation; /// Holds if OBSERVE_TX is read after a TX event.
+    bool rx_observation; /// Holds if FIFO_STATUS is read when a read of the RX FIFO finds data.
+    RF24_statistics stats; /// The counters.
+    RF24_hwlib_spi hwlib_spi; /// The default backend, the SPI bus and CSN pin.
+    RF24_spi_backend* backend; /// The backend that runs the SPI transactions.
+    RF24_spi_queue queue; /// Transactions that wait to be run as one batch.
+    uint8_t batch_depth; /// Number of begin_batch() calls without an end_batch().
+    RF24_clock* time_source; /// The clock used for waits and timeouts.
+    bool ce_level; /// The level the CE pin was set to.
+    uint8_t mode_config; /// NRF_CONFIG as it was last written or read, for the power state.
+    uint_fast64_t standby_at; /// Time the chip is done starting up after PWR_UP was set.
+    uint_fast64_t active_at; /// Time the chip is done settling after CE went high.
+    bool auto_power_down; /// Holds if the chip is powered down when it has nothing left to send.
+    
+    /// \brief
+    /// This will return the setting of a register, from the shadow copy if possible.
+    /// \details
+    /// If the shadow copy is enabled and holds a valid copy of the register, no SPI transaction is done.
+    /// Otherwise the register is read from the chip.
+    uint8_t get_register(const uint8_t reg);
+    
+    /// \brief
+    /// This will process the TX_DS and MAX_RT flags of a status register.
+    /// \details
+    /// Payloads that were sent or failed are moved from tx_in_flight to the pending results.
+    /// TX_DS is a single flag for possibly more than one sent payload, so FIFO_STATUS is read to
+    /// find out how many payloads are still in the TX FIFO.
+    /// When MAX_RT is set the payload at the head of the TX FIFO failed. The TX FIFO is flushed so the chip
+    /// can continue, which means every payload still in flight is reported as failed.
+    /// The flags are not cleared. This returns the bits that must be written to the status register to clear them.
+    uint8_t handle_tx_status(const uint8_t status);
+    
+    /// \brief
+    /// This will return true if the register can be kept in the shadow copy.
+    /// \details
+    /// Only registers that are never changed by the chip itself can be shadowed.
+    /// NRF_STATUS, OBSERVE_TX, CD/RPD and FIFO_STATUS are changed by the chip, so they are always read.
+    /// The multi-byte address registers are not shadowed either.
+    static bool is_shadowed(const uint8_t reg);
+    
+    /// \brief
+    /// This will count an overrun if RX_FULL is set in FIFO_STATUS, when RX observation is enabled.
+    void observe_rx();
+    
+    /// \brief
+    /// This will return the number of bytes in a list of spans.
+    static int payload_length(const RF24_span* spans, const int count);
+    
+    /// \brief
+    /// This will do an SPI transaction of which the answer is not needed.
+    /// \details
+    /// In a batch the bytes are copied into the queue and sent later, otherwise this is transfer().
+    void queue_transfer(uint8_t* data, const int bytes);
+    
+    /// \brief
+    /// This will run the queued transactions, and store the status register of the last one.
+    void run_queue();
+    
+    /// \brief
+    /// This will keep track of the power state when NRF_CONFIG is written.
+    void track_config(const uint8_t config);
+    
+    /// \brief
+    /// This will do one SPI transaction with the chip.
+    /// \details
+    /// The bytes in data are sent to the chip, and are replaced by the bytes the chip sends back.
+    /// The first byte the chip sends back is always the status register, it is stored so it
+    /// can be used without an extra transaction. This function returns it as well.
+    /// Every transaction goes through here. Queued transactions are run first, in the same batch.
+    uint8_t transfer(uint8_t* data, const int bytes);
+    
+    /// \brief
+    /// This will wait a number of milliseconds, the time is counted as blocked.
+    void wait_ms(const int ms);
+    
+    /// \brief
+    /// This will wait for the result of the oldest payload in flight.
+    /// \details
+    /// The first poll waits until the chip can have sent the payload, also after a power up (see wait_ready()),
+    /// then the status is polled every RF24_tx_poll_us. If the chip does not report anything
+    /// within 100 ms it is not responding, the TX FIFO is flushed and 'failed' is returned.
+    tx_result wait_tx_result();
+    
+    /// \brief
+    /// This will send a payload command followed by the bytes of the spans, in one frame.
+    /// \details
+    /// The spans are clocked out from where they are, behind a command byte on the stack, and the answer of the chip
+    /// to them is not stored. In a batch the frame is copied into the queue instead, because the caller may
+    /// change its buffers before the batch is run. The status register is stored as with every transaction.
+    void write_payload(const uint8_t command, const RF24_span* spans, const int count);
+    
     /// \brief
     /// This will return the rx payload width.
     /// \details
@@ -79,6 +254,32 @@ private:
 public:
     RF24(hwlib::pin_out & CE, hwlib::pin_out & CSN, hwlib::spi_bus & SPI);
     
+    /// \brief
+    /// Constructor for a module with the IRQ pin connected.
+    /// \details
+    /// With the IRQ pin connected, service() only talks to the chip when the chip asks for it.
+    RF24(hwlib::pin_out & CE, hwlib::pin_out & CSN, hwlib::spi_bus & SPI, hwlib::pin_in & IRQ);
+    
+    /// \brief
+    /// This will configure the chip with a precomputed list of register writes.
+    /// \details
+    /// The writes are done in order, one SPI transaction per register, without reading anything.
+    /// They are queued and run as one batch.
+    /// CE is low while the chip is configured. If the sequence leaves the chip powered up in RX mode,
+    /// CE is set high so it starts listening.
+    /// The sequence is usually made at compile time, see RF24_config and RF24_static_config.
+    void apply(const RF24_register_sequence & sequence);
+    
+    /// \brief
+    /// This will start a batch of SPI transactions.
+    /// \details
+    /// Until end_batch() is called, transactions of which the answer is not needed (register writes,
+    /// address writes, TX payloads and flushes) are queued instead of sent. The first transaction that needs
+    /// an answer, like a register read or a status update, runs the queue and itself as one batch, so
+    /// the chip always sees everything in order. CE changes also run the queue first.
+    /// Batches can be nested, the queue is run by the outermost end_batch().
+    void begin_batch();
+    
     /// \brief
     /// This will return the state of a bit in a register.
     bool check_bit(const uint8_t reg, const int bit);
@@ -87,6 +288,22 @@ public:
     /// This will set a bit in a register to '0'.
     void clear_bit(const uint8_t reg, const int bit);
     
+    /// \brief
+    /// This will return the clock used for waits and timeouts.
+    /// \details
+    /// Classes that work with a radio, like RF24_link_adapter, use the clock of the radio.
+    RF24_clock & clock();
+    
+    /// \brief
+    /// This will enable payloads in acknowledge packets.
+    /// \details
+    /// EN_ACK_PAY and EN_DPL in the FEATURE register are set with a single write.
+    /// Both sides must enable it, and both must have dynamic payload enabled on the pipe that is used,
+    /// for a PTX that is pipe 0 (see enable_dynamic_payload()).
+    /// A PRX can then load a payload with write_ack_payload(), which is sent with the acknowledge
+    /// of the next packet it receives on that pipe. The PTX gets it in its RX FIFO, see request().
+    void enable_ack_payload();
+    
     /// \brief
     /// This will enable dynamic payload on the specified pipe.
     /// \details
@@ -95,6 +312,41 @@ public:
     /// A PTX that transmits to a PRX with DPL enabled must have the DPL_P0 bit in DYNPD set.
     void enable_dynamic_payload(const uint8_t pipe);
     
+    /// \brief
+    /// This will enable or disable counting RX FIFO overruns.
+    /// \details
+    /// With this enabled, FIFO_STATUS is read every time receive_burst() or receive_into() finds data in the RX FIFO,
+    /// which costs one SPI transaction, and rx_overruns in statistics() counts the reads that found RX_FULL set.
+    /// The chip drops the packets that arrive while the RX FIFO is full, so the RX FIFO must be read more often.
+    void enable_rx_observation(const bool enable);
+    
+    /// \brief
+    /// This will enable or disable the shadow copy of the configuration registers.
+    /// \details
+    /// With the shadow copy enabled, set_bit(), clear_bit() and check_bit() on configuration registers
+    /// (NRF_CONFIG, EN_AA, EN_RXADDR, SETUP_AW, SETUP_RETR, RF_CH, RF_SETUP, RX_PW_Px, DYNPD and FEATURE)
+    /// use the last value the driver wrote or read, instead of reading the register from the chip first.
+    /// A bit operation on those registers then costs one SPI transaction instead of two.
+    /// Enabling the shadow copy will resync it with the chip.
+    /// The shadow copy is only correct as long as nobody else changes the chip, so after a power cycle
+    /// of the module resync_shadow_registers() must be called.
+    void enable_shadow_registers(const bool enable);
+    
+    /// \brief
+    /// This will enable or disable counting retransmits.
+    /// \details
+    /// With this enabled, OBSERVE_TX is read every time a payload is sent or failed, which costs one SPI transaction,
+    /// and ARC_CNT is added to the retransmits in statistics().
+    /// ARC_CNT only holds the retransmits of the last payload, so if one TX_DS is handled for more payloads,
+    /// only the retransmits of the last one are counted.
+    void enable_tx_observation(const bool enable);
+    
+    /// \brief
+    /// This will end a batch of SPI transactions, and run what is queued.
+    /// \details
+    /// This will return the status register of the last transaction.
+    uint8_t end_batch();
+    
     /// \brief
     /// This will clear the RX FIFO.
     /// \details
@@ -108,6 +360,15 @@ public:
     /// Flush TX FIFO, used in TX mode.
     void flush_tx();
     
+    /// \brief
+    /// This will create the address of a pipe of a hub.
+    /// \details
+    /// A hub started with start_hub_mode() listens on six addresses, made from one 5 byte base address.
+    /// The first byte (the LSByte, which is sent first) is base[0] + pipe, the other four bytes are the same
+    /// for every pipe, as pipe 2-5 share them with pipe 1.
+    /// A node that sends to a hub uses this to find the TX address of its pipe.
+    static void hub_address(const uint8_t* base, const uint8_t pipe, uint8_t* address);
+    
     /// \brief
     /// This will initialize the chip.
     /// \details
@@ -116,12 +377,82 @@ public:
     /// The default state for CSN is '1'.
     /// This function will try to read the status register. If the chip respons as expected, it will return '1'.
     /// If the chip does not respond as expected, it will return '0'.
+    /// A chip that was just powered on may need some time before it responds, so the status register is read
+    /// again every millisecond, for up to 10 ms. A chip that has been powered for a while responds at once.
     bool init();
     
+    /// \brief
+    /// This will initialize the chip and configure it.
+    /// \details
+    /// This does the same as init(), and if the chip was found it applies the sequence with apply().
+    /// This will return '1' if the chip was found.
+    bool init(const RF24_register_sequence & sequence);
+    
+    /// \brief
+    /// This will return the status register as it was during the last SPI transaction.
+    /// \details
+    /// The chip sends the status register as the first byte of every SPI transaction.
+    /// Every transaction this class does stores it, so it can be checked without an extra transaction.
+    /// The value is as old as the last transaction, use update_status() to get a fresh one.
+    uint8_t last_status() const;
+    
+    /// \brief
+    /// This will set which events are signalled on the IRQ pin.
+    /// \details
+    /// A '1' masks the event, so it will not pull the IRQ pin low. The flag in the status register is set anyway.
+    /// The three mask bits in NRF_CONFIG are written at once.
+    void mask_irq(const bool rx_dr, const bool tx_ds, const bool max_rt);
+    
+    /// \brief
+    /// This will return the result of the next payload given to try_send().
+    /// \details
+    /// Results are returned in the same order as the payloads were given to try_send(), one result per call.
+    /// If no payload is done yet, the status register is checked once and 'pending' is returned.
+    /// If there are no payloads in flight at all, 'idle' is returned without any SPI transaction, and so is
+    /// 'pending' while the chip is still starting up after a power down, as no payload can be done yet.
+    /// When a payload fails (MAX_RT), the TX FIFO is flushed and the flag is cleared, so the chip continues
+    /// right away. The payloads that were behind it in the TX FIFO are reported as failed as well.
+    /// poll() never waits, so it can be called from a main loop.
+    tx_result poll();
+    
+    /// \brief
+    /// This will power the chip down.
+    /// \details
+    /// The chip draws about 1 uA in power down. The registers and FIFOs keep their content and SPI still works.
+    /// CE is not changed, so a PRX or a TX stream goes on by itself after power_up().
+    void power_down();
+    
+    /// \brief
+    /// This will return the operational mode the chip is in now.
+    /// \details
+    /// The state is tracked from what the library wrote to NRF_CONFIG and CE, and from the time that passed
+    /// since, so this does not need an SPI transaction.
+    RF24_power_state power_state();
+    
+    /// \brief
+    /// This will power the chip up, if it is powered down.
+    /// \details
+    /// This does not wait. The chip starts up in RF24_power_up_us, in the meantime it can be configured and the
+    /// TX FIFO can be filled. If CE is high, the chip goes to RX or TX mode by itself once it is done.
+    /// Use wait_ready() when the application must know the chip is up.
+    void power_up();
+    
     /// \brief
     /// This will return the configuration of the specified register.
     uint8_t read_register(const uint8_t reg);
     
+    /// \brief
+    /// This will send a request and read the response a PRX sends back in its acknowledge.
+    /// \details
+    /// This is for a PTX that is in a TX stream (start_tx_stream()), with no other payloads in flight,
+    /// and with ACK payloads enabled (enable_ack_payload()).
+    /// The request is sent and this waits until it is acknowledged or failed. An ACK payload that came
+    /// with the acknowledge is read into the response sink, together with any other ACK payloads still in the RX FIFO.
+    /// The chip stays in TX mode the whole time, so there is no role switch on either side.
+    /// The PRX answers with the payload it loaded with write_ack_payload() before the request arrived.
+    /// This will return the number of responses read, or -1 if the request failed.
+    int request(const uint8_t* data, const int bytes, RF24_packet_sink & response);
+    
     /// \brief
     /// This will return the data that has been received on the chip.
     /// \details
@@ -129,8 +460,51 @@ public:
     /// If there is data ready for us, it will read it and return an array.
     /// The first byte in this array will hold the length of the array.
     /// So if you received seven bytes, the array will be eight bytes long, and the value of the first byte will be '8'.
+    /// The chip keeps listening while the data is read.
+    /// This is a wrapper around receive_into() that reads one packet. The array is shared by all radios and
+    /// overwritten by the next call, use receive_into() to read into storage of your own.
     uint8_t* receive();
     
+    /// \brief
+    /// This will read all packets from the RX FIFO into a sink.
+    /// \details
+    /// Packets are read until the RX FIFO is empty, the sink has no room, or max_packets have been read.
+    /// Each payload is read straight into the storage the sink returns, together with its length and pipe number.
+    /// The RX FIFO holds up to three packets, so a burst of packets is not lost when the application
+    /// is busy for a while, as long as the sink has room.
+    /// The status byte of every transaction is used to find out if there is more data, and RX_DR is cleared
+    /// once for the whole burst. CE is not touched, so the chip keeps listening.
+    /// If the chip reports a payload width of more than 32 bytes, the RX FIFO is flushed as the datasheet requires.
+    /// This will return the number of packets read.
+    int receive_burst(RF24_packet_sink & sink, const int max_packets = 3);
+    
+    /// \brief
+    /// This will read one packet from the RX FIFO straight into a buffer.
+    /// \details
+    /// The returned view points into the buffer and holds the length and the pipe of the packet.
+    /// If there is no data, the length is 0. If the packet is longer than size, it stays in the RX FIFO and
+    /// the length is 0 as well. The buffer only needs room for the payload, the SPI command is sent from elsewhere.
+    /// The chip keeps listening while the data is read.
+    RF24_packet_view receive_into(uint8_t* buffer, const int size);
+    
+    /// \brief
+    /// This will return true if the chip received a signal stronger than -64 dBm on its channel.
+    /// \details
+    /// This reads the RPD register (CD on the nRF24L01). The chip must be in RX mode for at least 170 us
+    /// before the result means something. The RPD is latched when the chip leaves RX mode.
+    bool received_power();
+    
+    /// \brief
+    /// This will set all counters in statistics() to zero.
+    void reset_statistics();
+    
+    /// \brief
+    /// This will reload the shadow copy from the chip.
+    /// \details
+    /// Every shadowed register is read from the chip and stored in the shadow copy.
+    /// Does nothing if the shadow copy is disabled.
+    void resync_shadow_registers();
+    
     /// \brief
     /// This will send the specified data.
     /// \details
@@ -140,12 +514,49 @@ public:
     /// If sending succeeded this function will return '1'.
     /// if sending failed it wil return '0'.
     /// in both senarios, the chip will be set in the same state, (RX mode or TX mode) as it was when this function was called.
+    /// This function waits until the chip reports the result, instead of waiting a fixed time.
+    /// If the chip is powered down it is powered up, the start up is the only extra wait.
+    /// Do not use it while a TX stream is running, it will flush the TX FIFO.
     bool send(const uint8_t* tx_payload, const int bytes);
     
+    /// \brief
+    /// This will send the bytes of a list of spans as one payload.
+    /// \details
+    /// This is send() for a payload in pieces, see try_send(const RF24_span*, const int).
+    bool send(const RF24_span* spans, const int count);
+    
+    /// \brief
+    /// This will handle the events of the chip.
+    /// \details
+    /// If the IRQ pin is connected and not low, this returns '0' right away, without any SPI transaction.
+    /// Otherwise the status register is read once. Every event flag that has a handler is cleared with a
+    /// single write, and then the handlers are called.
+    /// TX_DS and MAX_RT also update the results returned by poll(), and MAX_RT flushes the TX FIFO.
+    /// Flags without a handler are left alone.
+    /// This will return '1' if an event was handled.
+    /// It can be called from the main loop, so the MCU can do other work or sleep until the IRQ pin goes low.
+    bool service();
+    
+    /// \brief
+    /// This will power the chip down automatically when a PTX has nothing left to send.
+    /// \details
+    /// send() and request() power the chip down when they are done, unless the chip was listening.
+    /// In a TX stream, poll() powers the chip down when it returns the result of the last payload in flight.
+    /// send(), request() and try_send() power the chip up again, so the start up time is only paid by the
+    /// first payload of a burst. This is meant for nodes on a battery that send in bursts.
+    void set_auto_power_down(const bool enable);
+    
     /// \brief
     /// This will set a bit in a register to '1'.
     void set_bit(const uint8_t reg, const int bit);
     
+    /// \brief
+    /// This will set the CE pin, after the queued transactions are run.
+    /// \details
+    /// The chip must have received everything that was queued before its mode changes.
+    /// In RX mode the chip listens while CE is high, in TX mode it sends what is in the TX FIFO.
+    void set_ce(const bool level);
+    
     /// \brief
     /// Sets the frequency channel the chip operates on.
     /// \details
@@ -156,6 +567,32 @@ public:
     /// which gives you 835 MHz or the first 84 channels to use.
     void set_channel(const int channel);
     
+    /// \brief
+    /// This will set the clock used for waits and timeouts.
+    /// \details
+    /// The default is the hwlib clock. The clock must stay valid as long as it is used.
+    /// A start up or settling that is going on is taken as done, see wait_ready().
+    void set_clock(RF24_clock & clock);
+    
+    /// \brief
+    /// This will set the air data rate.
+    /// \details
+    /// Both sides of a link must use the same data rate. 250 kbps has the best range, 2 Mbps the shortest airtime.
+    /// The power-on default is 2 Mbps.
+    void set_data_rate(const RF24_data_rate rate);
+    
+    /// \brief
+    /// Registers the handler for an event.
+    /// \details
+    /// The event is RX_DR, TX_DS or MAX_RT. Use nullptr to remove a handler.
+    void set_event_handler(const uint8_t event, RF24_event_handler* handler);
+    
+    /// \brief
+    /// This will set the output power of the power amplifier.
+    /// \details
+    /// The power-on default is the maximum, 0 dBm.
+    void set_pa_level(const RF24_pa_level level);
+    
     /// \brief
     /// Sets the number of bytes the payload will be.
     /// \details
@@ -165,6 +602,14 @@ public:
     /// If set to zero, pipe will not be used.
     void set_payload_width(const uint8_t pipe, const int bytes);
     
+    /// \brief
+    /// Sets the auto retransmit delay and count (SETUP_RETR).
+    /// \details
+    /// The delay is rounded up to a step of 250 us, and limited to 250-4000 us. The count is limited to 0-15.
+    /// The delay counts from the end of a transmission, it must be long enough for the acknowledge
+    /// to arrive, see RF24_min_retry_delay().
+    void set_retries(const int delay_us, const int count);
+    
     /// \brief
     /// Sets the RX address of the specified pipe.
     /// \details
@@ -174,6 +619,14 @@ public:
     /// Only the last byte of those is unique.
     void set_rx_address(const uint8_t pipe, const uint8_t* address);
     
+    /// \brief
+    /// This will set the backend that runs the SPI transactions.
+    /// \details
+    /// By default the transactions are run on the SPI bus and CSN pin given to the constructor.
+    /// Another backend can use an SPI peripheral with DMA, or record the transactions, see RF24_spi_recorder.
+    /// The backend must stay valid as long as it is used. Anything still queued is run on the old backend first.
+    void set_spi_backend(RF24_spi_backend & backend);
+    
     /// \brief
     /// Sets the TX address.
     /// \details
@@ -196,6 +649,97 @@ public:
     /// When sending is done, the chip will be listening again.
     void start_easy_mode();
     
+    /// \brief
+    /// Configure and start the nRF24L01+ module as a hub that listens on all six data pipes.
+    /// \details
+    /// Every pipe gets the address hub_address(base, pipe), so up to six nodes can each send to their own pipe.
+    /// All pipes are enabled in EN_RXADDR, auto acknowledge is enabled in EN_AA and dynamic payload
+    /// is enabled in DYNPD and FEATURE. Every register is written once, without reading it first.
+    /// The channel is not changed.
+    /// The chip is set to RX mode and starts listening.
+    /// The pipe a packet was received on is given by receive_burst(), use RF24_hub to handle them per pipe.
+    void start_hub_mode(const uint8_t* base);
+    
+    /// \brief
+    /// This will start a TX stream.
+    /// \details
+    /// The chip is set to TX mode and CE is held high, so every payload given to try_send()
+    /// is sent as soon as the one before it is done, without the chip going back to standby.
+    /// Together with try_send() and poll() this keeps the 3 level TX FIFO filled, so the chip can send
+    /// at its air data rate.
+    void start_tx_stream();
+    
+    /// \brief
+    /// This will return a copy of the counters.
+    /// \details
+    /// Take a copy at the start and the end of a period and subtract them, or use reset_statistics().
+    RF24_statistics statistics() const;
+    
+    /// \brief
+    /// This will stop a TX stream.
+    /// \details
+    /// CE is set low, and the chip is set back to RX mode if it was in RX mode when the stream was started.
+    /// Payloads that are still in the TX FIFO stay there, so call this when poll() returns 'idle'.
+    void stop_tx_stream();
+    
+    /// \brief
+    /// This will load a payload in the TX FIFO without waiting.
+    /// \details
+    /// If the TX FIFO is full, the status register is checked once to see if payloads are done.
+    /// If there is room, the payload is written to the TX FIFO and '1' is returned.
+    /// If there is no room, or the payload is not 1-32 bytes, '0' is returned and nothing is written.
+    /// The result of the payload will be returned by poll().
+    /// If the chip is powered down, it is powered up first, see power_up().
+    /// With ack '0' the payload is written with W_TX_PAYLOAD_NO_ACK, so no receiver acknowledges it and any number
+    /// of receivers can listen to it. It is reported as sent once it is on the air. EN_DYN_ACK in FEATURE must be set.
+    bool try_send(const uint8_t* data, const int bytes, const bool ack = true);
+    
+    /// \brief
+    /// This will load the bytes of a list of spans as one payload, without waiting.
+    /// \details
+    /// The spans are sent in order, in a single W_TX_PAYLOAD frame, straight from the memory of the caller.
+    /// So a protocol header and a slice of a larger buffer can be sent without putting them together first.
+    /// Together the spans must hold 1-32 bytes, empty spans are skipped. Otherwise this is try_send().
+    bool try_send(const RF24_span* spans, const int count, const bool ack = true);
+    
+    /// \brief
+    /// This will read a fresh status register.
+    /// \details
+    /// This sends a single NOP command, which only makes the chip send the status register.
+    /// That is one byte on the bus, where reading NRF_STATUS with read_register() takes two.
+    /// The new status is returned, and is also available through last_status().
+    uint8_t update_status();
+    
+    /// \brief
+    /// This will check the shadow copy against the chip.
+    /// \details
+    /// Every valid shadowed register is read from the chip and compared with the shadow copy.
+    /// If all registers match, it will return '1'.
+    /// If a register does not match, the shadow copy of that register is corrected and it will return '0'.
+    bool verify_shadow_registers();
+    
+    /// \brief
+    /// This will wait until the chip is done with its last transition, and only as long as that takes.
+    /// \details
+    /// If PWR_UP was set less than RF24_power_up_us ago, this waits for the rest of the start up.
+    /// If CE went high less than RF24_settle_us before the chip was up, this waits for the rest of the settling.
+    /// Otherwise, or when the chip is powered down, it returns at once.
+    void wait_ready();
+    
+    /// \brief
+    /// This will wait a number of microseconds on the clock of the radio, the time is counted as blocked.
+    /// \details
+    /// Helpers that must wait for the other side use this, so RF24_statistics::blocked_us shows what they cost.
+    void wait_us(const uint32_t us);
+    
+    /// \brief
+    /// This will load a payload that is sent with the next acknowledge on a pipe.
+    /// \details
+    /// This is for a PRX with ACK payloads enabled (enable_ack_payload()).
+    /// ACK payloads use the TX FIFO, so up to three can be waiting.
+    /// This will return '0' if the payload is not 1-32 bytes, or if the TX FIFO was full and the payload was not loaded.
+    bool write_ack_payload(const uint8_t pipe, const uint8_t* data, const int bytes);
+    
     /// \brief
     /// This function will set the specified register, to the specified setting.
     void write_register(const uint8_t reg, const uint8_t value);
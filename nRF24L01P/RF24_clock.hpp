@@ -0,0 +1,62 @@
+// ==========================================================================
+//
+// File      : RF24_clock.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_clock.hpp
+ */
+
+#ifndef RF24_CLOCK_H
+#define RF24_CLOCK_H
+
+#include "hwlib.hpp"
+
+/// \brief
+/// The time source of the library.
+/// \details
+/// Everything in the library that waits or looks at the time does so through a clock, see RF24::set_clock().
+/// On the target this is hwlib, but a simulation can use its own virtual time, so a run does not depend
+/// on how fast the PC is.
+class RF24_clock {
+public:
+    /// \brief
+    /// This will return the time in microseconds.
+    virtual uint_fast64_t now_us() = 0;
+    
+    /// \brief
+    /// This will wait a number of microseconds.
+    virtual void wait_us(const int_fast32_t us) = 0;
+};
+
+/// \brief
+/// The clock of hwlib, the default clock of RF24.
+class RF24_hwlib_clock : public RF24_clock {
+public:
+    uint_fast64_t now_us() override {
+        return hwlib::now_us();
+    }
+    
+    void wait_us(const int_fast32_t us) override {
+        hwlib::wait_us(us);
+    }
+    
+    /// \brief
+    /// This will return the one hwlib clock.
+    static RF24_hwlib_clock & instance(){
+        static RF24_hwlib_clock clock;
+        return clock;
+    }
+};
+
+#endif
@@ -0,0 +1,96 @@
+// ==========================================================================
+//
+// File      : RF24_coalesce.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_coalesce.cpp
+ */
+
+#include "RF24_coalesce.hpp"
+
+RF24_coalescer::RF24_coalescer(RF24 & radio, const uint32_t deadline_us):
+    radio( radio ),
+    used( 1 ),
+    waiting( 0 ),
+    oldest_at( 0 ),
+    deadline_us( deadline_us )
+{
+    frame[0] = 0; // The sequence number of the first payload.
+}
+
+bool RF24_coalescer::add(const uint8_t* data, const int bytes){
+    if (bytes < 1 || bytes > RF24_coalesce_data) return false;
+    if (used + 1 + bytes > 32 && !this->flush()) return false; // No room, and the waiting messages did not go.
+    if (waiting == 0) oldest_at = radio.clock().now_us();
+    frame[used++] = bytes;
+    for (int i = 0; i < bytes; i++){
+        frame[used++] = data[i];
+    }
+    waiting++;
+    if (used > 30) this->flush(); // No message fits behind it. If it fails, it is tried again later.
+    return true;
+}
+
+bool RF24_coalescer::flush(){
+    if (waiting == 0) return true;
+    if (!radio.send(&*frame, used)){
+        oldest_at = radio.clock().now_us(); // poll() tries again after another deadline.
+        return false;
+    }
+    frame[0]++; // The next payload is a new one.
+    used = 1;
+    waiting = 0;
+    return true;
+}
+
+int RF24_coalescer::pending() const{
+    return waiting;
+}
+
+bool RF24_coalescer::poll(){
+    if (waiting == 0 || radio.clock().now_us() - oldest_at < deadline_us) return true;
+    return this->flush();
+}
+
+void RF24_coalescer::set_deadline(const uint32_t us){
+    deadline_us = us;
+    return;
+}
+
+RF24_coalesced_receiver::RF24_coalesced_receiver(RF24_packet_handler & handler):
+    handler( handler )
+{
+    for (int pipe = 0; pipe < 6; pipe++){
+        last_sequence[pipe] = -1;
+    }
+}
+
+void RF24_coalesced_receiver::commit(const uint8_t pipe, const uint8_t length){
+    const int end = length + 1; // The payload is behind the command byte.
+    if (length < 1 || pipe > 5) return;
+    if (frame[1] == last_sequence[pipe]) return; // We have it already, only the acknowledge got lost.
+    last_sequence[pipe] = frame[1];
+    int i = 2;
+    while (i < end){
+        const int bytes = frame[i];
+        if (bytes == 0 || i + 1 + bytes > end) return; // Not a message, the rest is thrown away.
+        handler.handle(RF24_packet_view{ &frame[i + 1], (uint8_t)bytes, pipe });
+        i += 1 + bytes;
+    }
+    return;
+}
+
+uint8_t* RF24_coalesced_receiver::reserve(const uint8_t, const uint8_t){
+    return &*frame;
+}
@@ -0,0 +1,113 @@
+// ==========================================================================
+//
+// File      : RF24_coalesce.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_coalesce.hpp
+ */
+
+#ifndef RF24_COALESCE_H
+#define RF24_COALESCE_H
+
+#include "RF24.hpp"
+#include "RF24_packet.hpp"
+
+/// \brief
+/// Layout of a coalesced payload.
+/// \details
+/// Byte 0 is the sequence number of the payload, followed by one or more messages back to back. Every message
+/// is a length byte of 1 to RF24_coalesce_data, followed by that many bytes.
+const int RF24_coalesce_data = 30;
+
+/// \brief
+/// Packs small messages into full payloads.
+/// \details
+/// Every packet costs the same preamble, address, CRC and acknowledge, whether it carries 2 bytes or 32.
+/// Messages given to add() are collected in one payload, which is sent with RF24::send() when the next message
+/// does not fit, when the oldest message has waited for the deadline (see poll()), or when flush() is called.
+/// A payload that was not acknowledged is kept and sent again by the next flush, so no message is lost,
+/// but add() refuses new messages while it does not fit behind them. It keeps its sequence number, so when
+/// only the acknowledge got lost, the receiver knows it has the payload already.
+/// The receiver unpacks the payloads with RF24_coalesced_receiver.
+class RF24_coalescer {
+private:
+    RF24 & radio; /// The radio the payloads are sent with.
+    uint8_t frame[32]; /// The sequence number, then the messages that wait, each behind its length.
+    uint8_t used; /// Number of bytes in frame, the sequence number included.
+    uint8_t waiting; /// Number of messages in frame.
+    uint_fast64_t oldest_at; /// Time the first message in frame was added, or the last flush failed.
+    uint32_t deadline_us; /// Time a message may wait before the payload is sent.
+public:
+    /// \brief
+    /// The deadline is the longest time a message waits for others, see poll().
+    RF24_coalescer(RF24 & radio, const uint32_t deadline_us = 10000);
+    
+    /// \brief
+    /// This will add a message of 1 to RF24_coalesce_data bytes.
+    /// \details
+    /// The message is copied. If it does not fit behind the waiting messages, those are sent first.
+    /// If the payload is full afterwards, it is sent right away.
+    /// This will return '0' if the message is not 1 to RF24_coalesce_data bytes, or if it did not fit
+    /// and the waiting messages could not be sent.
+    bool add(const uint8_t* data, const int bytes);
+    
+    /// \brief
+    /// This will send the waiting messages now.
+    /// \details
+    /// This will return '1' if they were acknowledged, or if nothing was waiting.
+    bool flush();
+    
+    /// \brief
+    /// This will return the number of messages that wait to be sent.
+    int pending() const;
+    
+    /// \brief
+    /// This will send the waiting messages if the oldest one waited for the deadline.
+    /// \details
+    /// Call it regularly, also when no messages are added. After a failed flush the messages wait for
+    /// another deadline, so a receiver that is gone does not keep the node busy.
+    /// This will return '0' if a payload was sent and failed.
+    bool poll();
+    
+    /// \brief
+    /// This will set the longest time a message waits for others.
+    void set_deadline(const uint32_t us);
+};
+
+/// \brief
+/// Unpacks the payloads of an RF24_coalescer.
+/// \details
+/// This is a sink for RF24::receive_burst(). Every message in a payload is passed to the handler on its own,
+/// with the pipe of the payload. The views point into the payload, so nothing is copied.
+/// A payload that does not follow the layout is passed on up to the first message that does not fit.
+/// A payload with the same sequence number as the last one on its pipe was sent again after its acknowledge
+/// got lost, and is thrown away. So with one coalescer per pipe, every message is handled exactly once.
+class RF24_coalesced_receiver : public RF24_packet_sink {
+private:
+    RF24_packet_handler & handler; /// Handles the messages.
+    uint8_t frame[33]; /// The payload that is read.
+    int16_t last_sequence[6]; /// Per pipe, the sequence number of the last payload, or -1.
+public:
+    RF24_coalesced_receiver(RF24_packet_handler & handler);
+    
+    /// \brief
+    /// This will pass the messages of a payload to the handler.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return storage for a payload.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+};
+
+#endif
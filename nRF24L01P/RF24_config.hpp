@@ -0,0 +1,426 @@
+// ==========================================================================
+//
+// File      : RF24_config.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @class RF24_config
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_config.hpp
+ */
+
+#ifndef RF24_CONFIG_H
+#define RF24_CONFIG_H
+
+#include "hwlib.hpp"
+#include "nRF24L01.h"
+
+/// \brief
+/// The air data rates of the nRF24L01+.
+enum class RF24_data_rate : uint8_t {
+    rate_250kbps,
+    rate_1mbps,
+    rate_2mbps
+};
+
+/// \brief
+/// The output power levels of the nRF24L01+.
+enum class RF24_pa_level : uint8_t {
+    min, /// -18 dBm
+    low, /// -12 dBm
+    high, /// -6 dBm
+    max /// 0 dBm
+};
+
+/// \brief
+/// The CRC widths of the nRF24L01+.
+enum class RF24_crc : uint8_t {
+    none,
+    one_byte,
+    two_bytes
+};
+
+/// \brief
+/// An address of 1, 3, 4 or 5 bytes.
+/// \details
+/// The first byte is the least significant byte, which is sent first.
+/// Pipe 2-5 only have their own first byte, so their address is a single byte.
+struct RF24_address {
+    uint8_t bytes[5]; /// The address bytes, LSByte first.
+    uint8_t length; /// Number of bytes used.
+    
+    constexpr RF24_address():
+        bytes{ 0, 0, 0, 0, 0 },
+        length( 0 )
+    {}
+    
+    constexpr RF24_address(const uint8_t b0):
+        bytes{ b0, 0, 0, 0, 0 },
+        length( 1 )
+    {}
+    
+    constexpr RF24_address(const uint8_t b0, const uint8_t b1, const uint8_t b2):
+        bytes{ b0, b1, b2, 0, 0 },
+        length( 3 )
+    {}
+    
+    constexpr RF24_address(const uint8_t b0, const uint8_t b1, const uint8_t b2, const uint8_t b3):
+        bytes{ b0, b1, b2, b3, 0 },
+        length( 4 )
+    {}
+    
+    constexpr RF24_address(const uint8_t b0, const uint8_t b1, const uint8_t b2, const uint8_t b3, const uint8_t b4):
+        bytes{ b0, b1, b2, b3, b4 },
+        length( 5 )
+    {}
+};
+
+/// \brief
+/// One register write: the register and the bytes that are written to it.
+struct RF24_register_write {
+    uint8_t reg; /// The register.
+    uint8_t length; /// Number of bytes, 1 for most registers, up to 5 for an address.
+    uint8_t data[5]; /// The bytes.
+};
+
+/// \brief
+/// A list of register writes that configure the chip.
+/// \details
+/// It is made by RF24_config::sequence() and applied by RF24::apply().
+/// Every register is written once, and nothing is read.
+struct RF24_register_sequence {
+    RF24_register_write writes[24]; /// The writes, in the order they must be done.
+    uint8_t count; /// Number of writes.
+};
+
+/// \brief
+/// Configuration of an nRF24L01+ that is made and checked at compile time.
+/// \details
+/// A configuration starts with the power-on settings of the chip, and every setting returns a changed copy,
+/// so settings can be chained:
+/// \code
+/// constexpr RF24_config radio_config = RF24_config()
+///     .channel(76)
+///     .data_rate(RF24_data_rate::rate_1mbps)
+///     .pipe(0, RF24_address(0x26, 0x02, 0x19, 0x96, 0xDD))
+///     .tx_address(RF24_address(0x26, 0x02, 0x19, 0x96, 0xDD))
+///     .listening(true);
+/// radio.init(RF24_static_config<radio_config>::sequence);
+/// \endcode
+/// RF24_static_config checks the configuration with static_assert, so a wrong setting does not compile.
+/// The configuration must be declared at namespace scope to be used as template argument.
+class RF24_config {
+public:
+    uint8_t rf_channel; /// RF channel, 0-125.
+    RF24_data_rate rate; /// Air data rate.
+    RF24_pa_level level; /// Output power.
+    RF24_crc crc_width; /// CRC width.
+    uint8_t address_bytes; /// Address width, 3-5 bytes.
+    uint16_t retransmit_delay_us; /// Auto retransmit delay, 250-4000 us in steps of 250 us.
+    uint8_t retransmit_count; /// Auto retransmit count, 0-15.
+    bool enabled[6]; /// Holds if a pipe is enabled.
+    bool auto_ack[6]; /// Holds if auto acknowledge is enabled on a pipe.
+    bool dynamic_payload[6]; /// Holds if dynamic payload is enabled on a pipe.
+    uint8_t payload_width[6]; /// Static payload width of a pipe, 1-32. Not used with dynamic payload.
+    RF24_address rx_address[6]; /// The RX address of a pipe.
+    RF24_address tx; /// The TX address.
+    bool ack_payload; /// Holds if payloads in acknowledge packets are enabled.
+    bool prim_rx; /// Holds if the chip is a PRX.
+    bool power_up; /// Holds if the chip is powered up.
+    
+    /// \brief
+    /// Creates a configuration with the power-on settings of the chip.
+    /// \details
+    /// The chip enables pipe 0 and 1 at power-on, but with a payload width of 0 they do not receive anything.
+    /// Here no pipe is enabled, use pipe() to enable the pipes that are used.
+    constexpr RF24_config():
+        rf_channel( 2 ),
+        rate( RF24_data_rate::rate_2mbps ),
+        level( RF24_pa_level::max ),
+        crc_width( RF24_crc::one_byte ),
+        address_bytes( 5 ),
+        retransmit_delay_us( 250 ),
+        retransmit_count( 3 ),
+        enabled{ false, false, false, false, false, false },
+        auto_ack{ true, true, true, true, true, true },
+        dynamic_payload{ false, false, false, false, false, false },
+        payload_width{ 0, 0, 0, 0, 0, 0 },
+        rx_address{ RF24_address(0xE7, 0xE7, 0xE7, 0xE7, 0xE7), RF24_address(0xC2, 0xC2, 0xC2, 0xC2, 0xC2),
+                    RF24_address(0xC3), RF24_address(0xC4), RF24_address(0xC5), RF24_address(0xC6) },
+        tx( 0xE7, 0xE7, 0xE7, 0xE7, 0xE7 ),
+        ack_payload( false ),
+        prim_rx( false ),
+        power_up( true )
+    {}
+    
+    /// \brief
+    /// Returns a copy with payloads in acknowledge packets enabled or disabled.
+    constexpr RF24_config ack_payloads(const bool enable) const {
+        RF24_config result = *this;
+        result.ack_payload = enable;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with another address width.
+    constexpr RF24_config address_width(const uint8_t bytes) const {
+        RF24_config result = *this;
+        result.address_bytes = bytes;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with another RF channel.
+    constexpr RF24_config channel(const uint8_t channel) const {
+        RF24_config result = *this;
+        result.rf_channel = channel;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with another CRC width.
+    constexpr RF24_config crc(const RF24_crc width) const {
+        RF24_config result = *this;
+        result.crc_width = width;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with another air data rate.
+    constexpr RF24_config data_rate(const RF24_data_rate data_rate) const {
+        RF24_config result = *this;
+        result.rate = data_rate;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy that is a PRX (listening) or a PTX.
+    constexpr RF24_config listening(const bool listen) const {
+        RF24_config result = *this;
+        result.prim_rx = listen;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with another output power.
+    constexpr RF24_config pa_level(const RF24_pa_level pa_level) const {
+        RF24_config result = *this;
+        result.level = pa_level;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with a pipe enabled.
+    /// \details
+    /// With dynamic payload, width is not used. Without it, width is the static payload width of the pipe.
+    constexpr RF24_config pipe(const uint8_t pipe, const RF24_address address, const bool dynamic = true,
+                               const bool acknowledge = true, const uint8_t width = 32) const {
+        RF24_config result = *this;
+        if (pipe < 6){
+            result.enabled[pipe] = true;
+            result.rx_address[pipe] = address;
+            result.dynamic_payload[pipe] = dynamic;
+            result.auto_ack[pipe] = acknowledge;
+            result.payload_width[pipe] = width;
+        }
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with a pipe disabled.
+    constexpr RF24_config pipe_disabled(const uint8_t pipe) const {
+        RF24_config result = *this;
+        if (pipe < 6) result.enabled[pipe] = false;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy that is powered up or down.
+    constexpr RF24_config powered(const bool power) const {
+        RF24_config result = *this;
+        result.power_up = power;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with other auto retransmit settings.
+    constexpr RF24_config retries(const uint16_t delay_us, const uint8_t count) const {
+        RF24_config result = *this;
+        result.retransmit_delay_us = delay_us;
+        result.retransmit_count = count;
+        return result;
+    }
+    
+    /// \brief
+    /// Returns a copy with another TX address.
+    constexpr RF24_config tx_address(const RF24_address address) const {
+        RF24_config result = *this;
+        result.tx = address;
+        return result;
+    }
+    
+    /// \brief
+    /// Holds if the address width is 3-5 bytes.
+    constexpr bool address_width_valid() const {
+        return address_bytes >= 3 && address_bytes <= 5;
+    }
+    
+    /// \brief
+    /// Holds if pipe 0, pipe 1 and the TX address are as long as the address width,
+    /// and the addresses of pipe 2-5 are one byte.
+    constexpr bool addresses_valid() const {
+        if (tx.length != address_bytes) return false;
+        for (int pipe = 0; pipe < 6; pipe++){
+            const uint8_t length = (pipe < 2) ? address_bytes : 1;
+            if (enabled[pipe] && rx_address[pipe].length != length) return false;
+        }
+        return true;
+    }
+    
+    /// \brief
+    /// Holds if the channel is 0-125.
+    constexpr bool channel_valid() const {
+        return rf_channel <= 125;
+    }
+    
+    /// \brief
+    /// Holds if CRC is enabled when any pipe uses auto acknowledge, the chip forces it on anyway.
+    constexpr bool crc_valid() const {
+        for (int pipe = 0; pipe < 6; pipe++){
+            if (enabled[pipe] && auto_ack[pipe] && crc_width == RF24_crc::none) return false;
+        }
+        return true;
+    }
+    
+    /// \brief
+    /// Holds if every pipe with dynamic payload also has auto acknowledge, as the chip requires,
+    /// and ACK payloads are only used together with dynamic payload.
+    constexpr bool dynamic_payload_valid() const {
+        bool any = false;
+        for (int pipe = 0; pipe < 6; pipe++){
+            if (dynamic_payload[pipe] && enabled[pipe]){
+                if (!auto_ack[pipe]) return false;
+                any = true;
+            }
+        }
+        return any || !ack_payload;
+    }
+    
+    /// \brief
+    /// Holds if every enabled pipe without dynamic payload has a payload width of 1-32 bytes.
+    constexpr bool payload_width_valid() const {
+        for (int pipe = 0; pipe < 6; pipe++){
+            if (enabled[pipe] && !dynamic_payload[pipe] && (payload_width[pipe] < 1 || payload_width[pipe] > 32)) return false;
+        }
+        return true;
+    }
+    
+    /// \brief
+    /// Holds if the retransmit delay is 250-4000 us in steps of 250 us, and the count is 0-15.
+    constexpr bool retries_valid() const {
+        return retransmit_delay_us >= 250 && retransmit_delay_us <= 4000 && (retransmit_delay_us % 250) == 0
+            && retransmit_count <= 15;
+    }
+    
+    /// \brief
+    /// Holds if every check passes.
+    constexpr bool valid() const {
+        return channel_valid() && address_width_valid() && addresses_valid() && crc_valid()
+            && dynamic_payload_valid() && payload_width_valid() && retries_valid();
+    }
+    
+    /// \brief
+    /// Returns the value of the RF_SETUP register.
+    constexpr uint8_t rf_setup() const {
+        return ((rate == RF24_data_rate::rate_250kbps) << RF_DR_LOW)
+            | ((rate == RF24_data_rate::rate_2mbps) << RF_DR_HIGH)
+            | (uint8_t(level) << RF_PWR_LOW);
+    }
+    
+    /// \brief
+    /// Returns the writes that configure the chip.
+    /// \details
+    /// Every register is written once. NRF_CONFIG is written last, so the chip powers up with
+    /// all other settings in place. The addresses of disabled pipes and the payload width of pipes
+    /// with dynamic payload are not written.
+    constexpr RF24_register_sequence sequence() const {
+        RF24_register_sequence result{};
+        uint8_t en_aa = 0, en_rxaddr = 0, dynpd = 0;
+        for (int pipe = 0; pipe < 6; pipe++){
+            if (auto_ack[pipe]) en_aa |= (1 << pipe);
+            if (enabled[pipe]) en_rxaddr |= (1 << pipe);
+            if (enabled[pipe] && dynamic_payload[pipe]) dynpd |= (1 << pipe);
+        }
+        add(result, EN_AA, en_aa);
+        add(result, EN_RXADDR, en_rxaddr);
+        add(result, SETUP_AW, address_bytes - 2);
+        add(result, SETUP_RETR, (((retransmit_delay_us / 250) - 1) << ARD) | (retransmit_count << ARC));
+        add(result, RF_CH, rf_channel);
+        add(result, RF_SETUP, rf_setup());
+        add(result, DYNPD, dynpd);
+        add(result, FEATURE, ((dynpd != 0) << EN_DPL) | (ack_payload << EN_ACK_PAY));
+        for (int pipe = 0; pipe < 6; pipe++){
+            if (!enabled[pipe]) continue;
+            add(result, RX_ADDR_P0 + pipe, rx_address[pipe]);
+            if (!dynamic_payload[pipe]) add(result, RX_PW_P0 + pipe, payload_width[pipe]);
+        }
+        add(result, TX_ADDR, tx);
+        add(result, NRF_CONFIG, ((crc_width != RF24_crc::none) << EN_CRC) | ((crc_width == RF24_crc::two_bytes) << CRCO)
+                                | (power_up << PWR_UP) | (prim_rx << PRIM_RX));
+        return result;
+    }
+    
+private:
+    /// \brief
+    /// This will add a single byte register write to a sequence.
+    static constexpr void add(RF24_register_sequence & sequence, const uint8_t reg, const uint8_t value){
+        RF24_register_write & write = sequence.writes[sequence.count++];
+        write.reg = reg;
+        write.length = 1;
+        write.data[0] = value;
+    }
+    
+    /// \brief
+    /// This will add an address write to a sequence.
+    static constexpr void add(RF24_register_sequence & sequence, const uint8_t reg, const RF24_address & address){
+        RF24_register_write & write = sequence.writes[sequence.count++];
+        write.reg = reg;
+        write.length = address.length;
+        for (int i = 0; i < address.length; i++){
+            write.data[i] = address.bytes[i];
+        }
+    }
+};
+
+/// \brief
+/// A configuration that is checked at compile time.
+/// \details
+/// Every rule of the chip is checked with static_assert, so a wrong configuration gives a compile error
+/// that tells what is wrong. The register writes are made at compile time as well.
+template<const RF24_config & config>
+struct RF24_static_config {
+    static_assert(config.channel_valid(), "RF24_config: the channel must be 0-125");
+    static_assert(config.address_width_valid(), "RF24_config: the address width must be 3-5 bytes");
+    static_assert(config.addresses_valid(), "RF24_config: pipe 0, pipe 1 and TX addresses must be as long as the address width, pipe 2-5 addresses must be 1 byte");
+    static_assert(config.crc_valid(), "RF24_config: auto acknowledge needs CRC");
+    static_assert(config.dynamic_payload_valid(), "RF24_config: dynamic payload needs auto acknowledge, ACK payloads need dynamic payload");
+    static_assert(config.payload_width_valid(), "RF24_config: pipes without dynamic payload need a payload width of 1-32 bytes");
+    static_assert(config.retries_valid(), "RF24_config: the retransmit delay must be 250-4000 us in steps of 250 us, the count 0-15");
+    
+    /// The register writes of the configuration.
+    static constexpr RF24_register_sequence sequence = config.sequence();
+};
+
+template<const RF24_config & config>
+constexpr RF24_register_sequence RF24_static_config<config>::sequence;
+
+#endif
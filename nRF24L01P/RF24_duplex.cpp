@@ -0,0 +1,266 @@
+// ==========================================================================
+//
+// File      : RF24_duplex.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_duplex.cpp
+ */
+
+#include "RF24_duplex.hpp"
+
+RF24_duplex::RF24_duplex(RF24 & tx_radio, RF24 & rx_radio, RF24_packet_handler & handler):
+    tx_radio( tx_radio ),
+    rx_radio( rx_radio ),
+    handler( handler ),
+    oldest( 0 ),
+    next_sequence( 0 ),
+    expected( 0 ),
+    received( 0 ),
+    striping_enabled( false ),
+    ask_interval_us( 2000 ),
+    asked_at( 0 ),
+    lending( false ),
+    lent( false ),
+    reclaiming( false ),
+    reclaimed_at( 0 ),
+    reclaim_timeout_us( 10000 ),
+    borrowed( false ),
+    releasing( false )
+{
+    for (int i = 0; i < RF24_duplex_window; i++){
+        out_state[i] = slot_state::free;
+        in_length[i] = 0;
+    }
+    flight_count[0] = 0;
+    flight_count[1] = 0;
+}
+
+void RF24_duplex::commit(const uint8_t pipe, const uint8_t length){
+    if (length < 1) return;
+    const uint8_t header = frame[1];
+    if (header & RF24_duplex_control){
+        received |= (1 << (header & 0x07)); // poll() acts on it after the burst.
+        return;
+    }
+    if (length < 2) return;
+    const uint8_t distance = (header - expected) & 0x7F;
+    const int slot = header % RF24_duplex_window;
+    // A frame behind the window was handled already, it came again because its acknowledge got lost.
+    if (distance >= RF24_duplex_window || in_length[slot] != 0) return;
+    if (distance > 0){
+        // Keep it until the frames in front of it arrived.
+        for (int i = 0; i < length - 1; i++){
+            in_frames[slot][i] = frame[i + 2];
+        }
+        in_length[slot] = length - 1;
+        return;
+    }
+    handler.handle(RF24_packet_view{ &frame[2], (uint8_t)(length - 1), pipe });
+    expected = (expected + 1) & 0x7F;
+    while (in_length[expected % RF24_duplex_window] != 0){
+        const int next = expected % RF24_duplex_window;
+        handler.handle(RF24_packet_view{ &in_frames[next][0], in_length[next], pipe });
+        in_length[next] = 0;
+        expected = (expected + 1) & 0x7F;
+    }
+    return;
+}
+
+void RF24_duplex::finish(const int radio, const bool sent){
+    const int8_t entry = flight[radio][0];
+    flight_count[radio]--;
+    for (int i = 0; i < flight_count[radio]; i++){
+        flight[radio][i] = flight[radio][i + 1];
+    }
+    if (entry >= 0){
+        if (!sent){
+            out_state[entry] = slot_state::queued; // Send it again.
+            if (radio == 1) releasing = true; // The other node took its channel back.
+            return;
+        }
+        out_state[entry] = slot_state::acknowledged;
+        while (oldest != next_sequence && out_state[oldest % RF24_duplex_window] == slot_state::acknowledged){
+            out_state[oldest % RF24_duplex_window] = slot_state::free;
+            oldest = (oldest + 1) & 0x7F;
+        }
+    }
+    else if (entry == -RF24_duplex_lend){
+        lending = false;
+        if (sent){
+            lent = true;
+            tx_radio.stop_tx_stream(); // Listen on our channel.
+        }
+    }
+    else if (entry == -RF24_duplex_release){
+        // If the release got lost, the other node takes its channel back after a while.
+        borrowed = false;
+        releasing = false;
+        rx_radio.stop_tx_stream();
+    }
+    return;
+}
+
+int RF24_duplex::pending() const{
+    return (next_sequence - oldest) & 0x7F;
+}
+
+void RF24_duplex::poll(){
+    const uint_fast64_t now = tx_radio.clock().now_us();
+    for (int i = 0; i < 2; i++){
+        while (flight_count[i] > 0){
+            const RF24::tx_result result = this->radio(i).poll();
+            if (result == RF24::tx_result::sent) this->finish(i, true);
+            else if (result == RF24::tx_result::failed) this->finish(i, false);
+            else break;
+        }
+    }
+    
+    // Our RX radio also gets the ACK payloads while it sends, our TX radio only receives while it listens.
+    received = 0;
+    rx_radio.receive_burst(*this);
+    if (lent) tx_radio.receive_burst(*this);
+    if (((received >> RF24_duplex_release) & 1) && lent) this->take_back();
+    if (((received >> RF24_duplex_reclaim) & 1) && borrowed) releasing = true;
+    if (((received >> RF24_duplex_lend) & 1) && striping_enabled && !borrowed){
+        borrowed = true;
+        releasing = false;
+        rx_radio.start_tx_stream();
+    }
+    if ((received >> RF24_duplex_ask) & 1){
+        if (lent) this->take_back(); // The other node gave it back, but the release got lost.
+        if (striping_enabled && !lending && !borrowed && this->pending() == 0 && flight_count[0] == 0){
+            const uint8_t control = RF24_duplex_control | RF24_duplex_lend;
+            lending = this->send_frame(0, &control, 1, -RF24_duplex_lend);
+        }
+    }
+    
+    if (lent && !reclaiming && this->pending() > 0){
+        // The ACK payload goes out with the acknowledge of the next frame the other node sends us.
+        const uint8_t control = RF24_duplex_control | RF24_duplex_reclaim;
+        reclaiming = tx_radio.write_ack_payload(0, &control, 1);
+        reclaimed_at = now;
+    }
+    else if (lent && reclaiming && now - reclaimed_at > reclaim_timeout_us){
+        this->take_back();
+    }
+    if (borrowed){
+        if (this->pending() == 0) releasing = true; // Everything arrived, give the channel back.
+        if (releasing && flight_count[1] == 0){
+            const uint8_t control = RF24_duplex_control | RF24_duplex_release;
+            this->send_frame(1, &control, 1, -RF24_duplex_release);
+        }
+    }
+    
+    // Ask for the channel of the other node when our TX radio can not take everything that is queued.
+    if (striping_enabled && !lent && !lending && !borrowed && flight_count[0] < 3
+        && this->queued() > 3 - flight_count[0] && now - asked_at >= ask_interval_us){
+        const uint8_t control = RF24_duplex_control | RF24_duplex_ask;
+        if (this->send_frame(0, &control, 1, -RF24_duplex_ask)) asked_at = now;
+    }
+    
+    // Fill the TX FIFOs in turns, so a burst is spread over both radios.
+    bool loaded = true;
+    while (loaded){
+        loaded = false;
+        for (int i = 0; i < 2; i++){
+            const bool sending = (i == 0) ? !(lent || lending) : (borrowed && !releasing);
+            if (!sending || flight_count[i] >= 3) continue;
+            const int slot = this->queued_slot();
+            if (slot < 0) return;
+            if (this->send_frame(i, &out_frames[slot][0], out_length[slot], slot)){
+                out_state[slot] = slot_state::flight;
+                loaded = true;
+            }
+        }
+    }
+    return;
+}
+
+int RF24_duplex::queued() const{
+    int count = 0;
+    for (uint8_t sequence = oldest; sequence != next_sequence; sequence = (sequence + 1) & 0x7F){
+        if (out_state[sequence % RF24_duplex_window] == slot_state::queued) count++;
+    }
+    return count;
+}
+
+int RF24_duplex::queued_slot() const{
+    for (uint8_t sequence = oldest; sequence != next_sequence; sequence = (sequence + 1) & 0x7F){
+        if (out_state[sequence % RF24_duplex_window] == slot_state::queued) return sequence % RF24_duplex_window;
+    }
+    return -1;
+}
+
+RF24 & RF24_duplex::radio(const int index){
+    return (index == 0) ? tx_radio : rx_radio;
+}
+
+uint8_t* RF24_duplex::reserve(const uint8_t, const uint8_t){
+    return &*frame;
+}
+
+bool RF24_duplex::send(const uint8_t* data, const int bytes){
+    if (bytes < 1 || bytes > RF24_duplex_data || this->pending() >= RF24_duplex_window) return false;
+    const int slot = next_sequence % RF24_duplex_window;
+    out_frames[slot][0] = next_sequence;
+    for (int i = 0; i < bytes; i++){
+        out_frames[slot][i + 1] = data[i];
+    }
+    out_length[slot] = bytes + 1;
+    out_state[slot] = slot_state::queued;
+    next_sequence = (next_sequence + 1) & 0x7F;
+    return true;
+}
+
+bool RF24_duplex::send_frame(const int radio, const uint8_t* data, const int bytes, const int8_t entry){
+    if (!this->radio(radio).try_send(data, bytes)) return false;
+    flight[radio][flight_count[radio]++] = entry;
+    return true;
+}
+
+void RF24_duplex::set_striping(const bool enable, const uint32_t ask_interval_us, const uint32_t reclaim_timeout_us){
+    striping_enabled = enable;
+    this->ask_interval_us = ask_interval_us;
+    this->reclaim_timeout_us = reclaim_timeout_us;
+    return;
+}
+
+void RF24_duplex::start(const uint8_t tx_channel, const uint8_t* tx_address, const uint8_t rx_channel, const uint8_t* rx_address){
+    // Both radios use pipe 0 for the other node and for the acknowledges, so they can swap roles.
+    for (int i = 0; i < 2; i++){
+        RF24 & radio = this->radio(i);
+        const uint8_t* address = (i == 0) ? tx_address : rx_address;
+        radio.set_ce(0);
+        radio.set_channel((i == 0) ? tx_channel : rx_channel);
+        radio.set_rx_address(RX_ADDR_P0, address);
+        radio.set_tx_address(address);
+        radio.enable_ack_payload();
+        radio.write_register(NRF_CONFIG, radio.read_register(NRF_CONFIG) | (1 << PRIM_RX) | (1 << PWR_UP));
+    }
+    tx_radio.start_tx_stream(); // stop_tx_stream() will make it listen.
+    rx_radio.set_ce(1);
+    return;
+}
+
+bool RF24_duplex::striping() const{
+    return borrowed;
+}
+
+void RF24_duplex::take_back(){
+    lent = false;
+    reclaiming = false;
+    tx_radio.flush_tx(); // A reclaim that was not sent must not go out as a frame.
+    tx_radio.start_tx_stream();
+    return;
+}
@@ -0,0 +1,175 @@
+// ==========================================================================
+//
+// File      : RF24_duplex.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_duplex.hpp
+ */
+
+#ifndef RF24_DUPLEX_H
+#define RF24_DUPLEX_H
+
+#include "RF24.hpp"
+#include "RF24_packet.hpp"
+
+/// \brief
+/// Layout of a duplex frame.
+/// \details
+/// Byte 0 of a data frame is its sequence number, 0-127, followed by up to RF24_duplex_data bytes.
+/// A control frame is one byte: RF24_duplex_control with the code in the low bits.
+const int RF24_duplex_data = 31;
+const uint8_t RF24_duplex_control = 0x80;
+
+/// \brief
+/// Codes of the control frames, used to lend a channel to the other node.
+/// \details
+/// ask: the other node has more to send than one radio can carry.
+/// lend: our TX radio listens from now on, the other node may send on its RX radio.
+/// reclaim: an ACK payload, we want our channel back.
+/// release: the other node stopped sending on our channel.
+const uint8_t RF24_duplex_ask = 0x01;
+const uint8_t RF24_duplex_lend = 0x02;
+const uint8_t RF24_duplex_reclaim = 0x03;
+const uint8_t RF24_duplex_release = 0x04;
+
+/// \brief
+/// Number of packets that may be sent but not acknowledged, and that the receiver puts back in order.
+const int RF24_duplex_window = 16;
+
+/// \brief
+/// A full duplex packet stream between two nodes with two radios each.
+/// \details
+/// One radio of a node only sends and the other only listens, each on a channel of its own, so both directions
+/// run at the same time and no radio ever switches between TX and RX mode for a packet.
+/// The TX radio of one node sends to the RX radio of the other node on the same channel and address.
+/// Data frames are numbered, packets that failed are sent again and the receiver passes them to the handler
+/// in order and without duplicates.
+/// With striping enabled, a node that has more to send than one radio can carry asks the other node for its
+/// channel. If the other node has nothing to send, it lends it: its TX radio listens, and the RX radio of the
+/// asking node sends on that channel as well, so one direction gets both channels. The node that lent its
+/// channel takes it back with an ACK payload as soon as it has something to send, and the asking node gives it
+/// back by itself when it has sent everything.
+/// Both radios must be set up with start_easy_mode(), or another setup with auto acknowledge and dynamic payload
+/// on pipe 0, and must not be used for anything else. The channels should be far apart,
+/// the radios of a node are close to each other.
+class RF24_duplex : public RF24_packet_sink {
+private:
+    /// \brief
+    /// What happens to a frame that was given to send().
+    enum class slot_state : uint8_t {
+        free, /// The slot is not used.
+        queued, /// The frame must be sent.
+        flight, /// The frame is in a TX FIFO.
+        acknowledged /// The frame arrived, but a frame in front of it did not.
+    };
+    
+    RF24 & tx_radio; /// The radio that sends to the other node.
+    RF24 & rx_radio; /// The radio that listens to the other node, and sends as well when we borrowed its channel.
+    RF24_packet_handler & handler; /// Handles the data, in order.
+    uint8_t out_frames[RF24_duplex_window][32]; /// The frames that are not acknowledged yet, by sequence number.
+    uint8_t out_length[RF24_duplex_window]; /// Number of bytes per frame.
+    slot_state out_state[RF24_duplex_window]; /// What happens to every frame.
+    uint8_t oldest; /// Sequence number of the oldest frame that is not acknowledged.
+    uint8_t next_sequence; /// Sequence number of the next frame.
+    uint8_t in_frames[RF24_duplex_window][RF24_duplex_data]; /// Data that arrived before the data in front of it.
+    uint8_t in_length[RF24_duplex_window]; /// Number of bytes per frame, 0 if it did not arrive.
+    uint8_t expected; /// Sequence number of the next frame for the handler.
+    uint8_t frame[33]; /// The frame that is read.
+    int8_t flight[2][3]; /// Per radio, the frames in its TX FIFO, oldest first. A slot, or minus a control code.
+    uint8_t flight_count[2]; /// Per radio, the number of frames in its TX FIFO.
+    uint8_t received; /// One bit per control code that arrived in the last burst.
+    bool striping_enabled; /// Holds if channels are lent and borrowed.
+    uint32_t ask_interval_us; /// Time between two asks.
+    uint_fast64_t asked_at; /// Time of the last ask.
+    bool lending; /// Holds if a lend frame is in flight.
+    bool lent; /// Holds if our TX radio listens.
+    bool reclaiming; /// Holds if the reclaim ACK payload is loaded.
+    uint_fast64_t reclaimed_at; /// Time the reclaim ACK payload was loaded.
+    uint32_t reclaim_timeout_us; /// Time after which we take our channel back without a release.
+    bool borrowed; /// Holds if our RX radio sends on the channel of the other node.
+    bool releasing; /// Holds if we give the channel back when our RX radio has nothing in flight.
+    
+    /// \brief
+    /// This will handle the result of the oldest frame in flight on a radio.
+    void finish(const int radio, const bool sent);
+    
+    /// \brief
+    /// This will return the number of queued frames.
+    int queued() const;
+    
+    /// \brief
+    /// This will return the oldest queued frame, or -1 if there is none.
+    int queued_slot() const;
+    
+    /// \brief
+    /// This will return the radio with index 0 (TX) or 1 (RX).
+    RF24 & radio(const int index);
+    
+    /// \brief
+    /// This will load a frame in the TX FIFO of a radio, and remember it as in flight.
+    bool send_frame(const int radio, const uint8_t* data, const int bytes, const int8_t entry);
+    
+    /// \brief
+    /// This will take our channel back: our TX radio sends again.
+    void take_back();
+public:
+    /// \brief
+    /// The handler gets the data of every frame, in the order it was given to send().
+    RF24_duplex(RF24 & tx_radio, RF24 & rx_radio, RF24_packet_handler & handler);
+    
+    /// \brief
+    /// This will handle a frame that was read.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return the number of frames that were given to send() and are not acknowledged yet.
+    int pending() const;
+    
+    /// \brief
+    /// This will collect results, read what arrived and fill the TX FIFOs, without waiting.
+    /// \details
+    /// Call it as often as possible, also when there is nothing to send, the other node depends on it.
+    void poll();
+    
+    /// \brief
+    /// This will return storage for a frame.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will queue 1 to RF24_duplex_data bytes, and return '0' if the window is full.
+    /// \details
+    /// The data is copied, it is sent by poll().
+    bool send(const uint8_t* data, const int bytes);
+    
+    /// \brief
+    /// This will enable or disable lending and borrowing channels.
+    /// \details
+    /// Both nodes must agree. The ask interval is the time between two asks for the channel of the other node
+    /// while it does not lend it. The reclaim timeout is the time after which we take our channel back when the
+    /// release does not arrive, when the other node has given it back but the release got lost.
+    void set_striping(const bool enable, const uint32_t ask_interval_us = 2000, const uint32_t reclaim_timeout_us = 10000);
+    
+    /// \brief
+    /// This will set the channels and addresses and start both radios.
+    /// \details
+    /// The TX channel and address of one node are the RX channel and address of the other.
+    /// The addresses are 5 bytes long. ACK payloads are enabled on both radios.
+    void start(const uint8_t tx_channel, const uint8_t* tx_address, const uint8_t rx_channel, const uint8_t* rx_address);
+    
+    /// \brief
+    /// This will return true while we send on both channels.
+    bool striping() const;
+};
+
+#endif
@@ -0,0 +1,235 @@
+// ==========================================================================
+//
+// File      : RF24_hop.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_hop.cpp
+ */
+
+#include "RF24_hop.hpp"
+
+RF24_hop_sequence::RF24_hop_sequence(const uint32_t seed, const uint8_t first, const uint8_t last):
+    length( 0 )
+{
+    const int low = (first > 125) ? 125 : first;
+    const int high = (last > 125) ? 125 : ((last < low) ? low : last);
+    for (int channel = low; channel <= high; channel++){
+        channels[length++] = channel;
+    }
+    for (int i = 0; i < 16; i++){
+        bad[i] = 0;
+    }
+    // Shuffle with xorshift32, which must not start at 0.
+    uint32_t state = (seed == 0) ? 2463534242u : seed;
+    for (int i = length - 1; i > 0; i--){
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const int j = state % (i + 1);
+        const uint8_t swap = channels[i];
+        channels[i] = channels[j];
+        channels[j] = swap;
+    }
+}
+
+int RF24_hop_sequence::channel(const int index) const{
+    return channels[index % length];
+}
+
+bool RF24_hop_sequence::is_bad(const int channel) const{
+    if (channel < 0 || channel > 125) return true;
+    return (bad[channel / 8] >> (channel % 8)) & 1;
+}
+
+void RF24_hop_sequence::mark(const int channel, const bool bad){
+    if (channel < 0 || channel > 125) return;
+    if (bad) this->bad[channel / 8] |= (1 << (channel % 8));
+    else this->bad[channel / 8] &= ~(1 << (channel % 8));
+    return;
+}
+
+int RF24_hop_sequence::next(const int index) const{
+    for (int i = 1; i <= length; i++){
+        const int candidate = (index + i) % length;
+        if (!this->is_bad(channels[candidate])) return candidate;
+    }
+    return (index + 1) % length; // Everything is bad, hop anyway.
+}
+
+int RF24_hop_sequence::size() const{
+    return length;
+}
+
+RF24_hop_sender::RF24_hop_sender(RF24 & radio, RF24_hop_sequence & sequence, const uint8_t home, const uint32_t resync_us):
+    radio( radio ),
+    sequence( sequence ),
+    home( home ),
+    index( 0 ),
+    failures( 0 ),
+    last_ok( 0 ),
+    resync_us( resync_us ),
+    packets( 0 ),
+    bad_score( 96 ),
+    gap_us( 300 )
+{
+    for (int channel = 0; channel < 126; channel++){
+        score[channel] = 0;
+    }
+    for (int i = 0; i < 16; i++){
+        wanted[i] = 0;
+    }
+}
+
+int RF24_hop_sender::channel() const{
+    const bool lost = (failures >= 2) || (radio.clock().now_us() - last_ok > resync_us);
+    return lost ? home : sequence.channel(index);
+}
+
+bool RF24_hop_sender::send(const uint8_t* data, const int bytes){
+    if (bytes < 1 || bytes > RF24_hop_data) return false;
+    if (++packets >= 1024){
+        // Forget the marks, so channels that got better are used again.
+        packets = 0;
+        for (int channel = 0; channel < 126; channel++){
+            score[channel] = 0;
+        }
+        for (int i = 0; i < 16; i++){
+            wanted[i] = 0;
+        }
+    }
+    uint8_t frame[32];
+    // Send one update first if the receiver does not know what we want.
+    for (int channel = 0; channel < 126; channel++){
+        const bool want = (wanted[channel / 8] >> (channel % 8)) & 1;
+        if (want != sequence.is_bad(channel)){
+            frame[1] = channel;
+            frame[2] = want;
+            this->send_frame(&*frame, 3, true);
+            break;
+        }
+    }
+    for (int i = 0; i < bytes; i++){
+        frame[i + 1] = data[i];
+    }
+    return this->send_frame(&*frame, bytes + 1, false);
+}
+
+bool RF24_hop_sender::send_frame(uint8_t* frame, const int bytes, const bool update){
+    const int channel = this->channel();
+    frame[0] = index | (update ? RF24_hop_update : 0);
+    // Change the channel while the chip does not send.
+    radio.set_ce(0);
+    radio.set_channel(channel);
+    radio.set_ce(1);
+    const uint32_t retransmits = radio.statistics().retransmits;
+    RF24_packet_ring_buffer<3> responses; // The receiver does not answer, but an ACK payload must not stay in the RX FIFO.
+    const bool ok = (radio.request(frame, bytes, responses) >= 0);
+    if (channel != home) this->score_channel(channel, radio.statistics().retransmits - retransmits, ok);
+    if (ok && update) sequence.mark(frame[1], frame[2]); // The receiver has it now, and hops with the new map.
+    index = sequence.next(index); // The receiver hopped if the frame arrived, even if the acknowledge got lost.
+    if (!ok){
+        if (failures < 0xFF) failures++;
+        return false;
+    }
+    failures = 0;
+    radio.wait_us(gap_us); // Let the receiver hop.
+    last_ok = radio.clock().now_us();
+    return true;
+}
+
+void RF24_hop_sender::score_channel(const int channel, const uint32_t retransmits, const bool ok){
+    uint32_t value = score[channel] - score[channel] / 4 + retransmits * 8 + (ok ? 0 : 128);
+    if (value > 0xFF) value = 0xFF;
+    score[channel] = value;
+    if (value < bad_score) return;
+    // Keep at least 8 channels to hop on.
+    int good = 0;
+    for (int i = 0; i < sequence.size(); i++){
+        const int c = sequence.channel(i);
+        if (!((wanted[c / 8] >> (c % 8)) & 1)) good++;
+    }
+    if (good > 8) wanted[channel / 8] |= (1 << (channel % 8));
+    return;
+}
+
+void RF24_hop_sender::set_bad_score(const uint8_t score){
+    bad_score = score;
+    return;
+}
+
+void RF24_hop_sender::set_gap(const uint16_t us){
+    gap_us = us;
+    return;
+}
+
+void RF24_hop_sender::start(){
+    radio.enable_tx_observation(true);
+    index = sequence.next(sequence.size() - 1);
+    failures = 2; // The receiver starts at home.
+    last_ok = radio.clock().now_us();
+    return;
+}
+
+RF24_hop_receiver::RF24_hop_receiver(RF24 & radio, RF24_hop_sequence & sequence, RF24_packet_handler & handler,
+                                     const uint8_t home, const uint32_t resync_us):
+    radio( radio ),
+    sequence( sequence ),
+    handler( handler ),
+    home( home ),
+    last_heard( 0 ),
+    resync_us( resync_us ),
+    at_home( false )
+{}
+
+void RF24_hop_receiver::commit(const uint8_t pipe, const uint8_t length){
+    if (length < 1) return;
+    const uint8_t header = frame[1];
+    const int index = header & ~RF24_hop_update;
+    if (header & RF24_hop_update){
+        if (length >= 3) sequence.mark(frame[2], frame[3]);
+    }
+    else {
+        handler.handle(RF24_packet_view{ &frame[2], (uint8_t)(length - 1), pipe });
+    }
+    last_heard = radio.clock().now_us();
+    at_home = false;
+    this->tune(sequence.channel(sequence.next(index)));
+    return;
+}
+
+void RF24_hop_receiver::poll(){
+    if (at_home || radio.clock().now_us() - last_heard <= resync_us) return;
+    at_home = true;
+    this->tune(home);
+    return;
+}
+
+uint8_t* RF24_hop_receiver::reserve(const uint8_t, const uint8_t){
+    return &*frame;
+}
+
+void RF24_hop_receiver::start(){
+    at_home = true;
+    last_heard = radio.clock().now_us();
+    this->tune(home);
+    return;
+}
+
+void RF24_hop_receiver::tune(const int channel){
+    // Listen again, so the chip settles on the new channel.
+    radio.set_ce(0);
+    radio.set_channel(channel);
+    radio.set_ce(1);
+    return;
+}
@@ -0,0 +1,189 @@
+// ==========================================================================
+//
+// File      : RF24_hop.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_hop.hpp
+ */
+
+#ifndef RF24_HOP_H
+#define RF24_HOP_H
+
+#include "RF24.hpp"
+#include "RF24_packet.hpp"
+
+/// \brief
+/// Layout of a hop frame.
+/// \details
+/// Byte 0 is the hop index the frame was sent on. A data frame carries up to RF24_hop_data bytes behind it.
+/// If bit 7 of byte 0 is set, the frame is an update of the bad channel map: byte 1 is the channel,
+/// byte 2 is 1 if the channel is bad and 0 if it is good again.
+const int RF24_hop_data = 31;
+const uint8_t RF24_hop_update = 0x80;
+
+/// \brief
+/// A pseudo-random order of channels that a PTX and a PRX hop through together.
+/// \details
+/// The order is a shuffle of the channels first to last with an xorshift generator, so both sides get
+/// the same order from the same seed. Channels can be marked bad, next() skips them.
+/// Both sides must mark the same channels, RF24_hop_sender takes care of that.
+class RF24_hop_sequence {
+private:
+    uint8_t channels[126]; /// The channels in hop order.
+    uint8_t length; /// Number of channels in the sequence.
+    uint8_t bad[16]; /// One bit per channel, set if the channel is skipped.
+public:
+    RF24_hop_sequence(const uint32_t seed, const uint8_t first = 0, const uint8_t last = 125);
+    
+    /// \brief
+    /// This will return the channel at an index.
+    int channel(const int index) const;
+    
+    /// \brief
+    /// This will return true if a channel is marked bad.
+    bool is_bad(const int channel) const;
+    
+    /// \brief
+    /// This will mark a channel bad or good.
+    void mark(const int channel, const bool bad);
+    
+    /// \brief
+    /// This will return the first index after index with a good channel.
+    /// \details
+    /// If every channel is bad, this will return the next index.
+    int next(const int index) const;
+    
+    /// \brief
+    /// This will return the number of channels in the sequence, good or bad.
+    int size() const;
+};
+
+/// \brief
+/// Sends data while hopping to the next channel of a sequence after every packet.
+/// \details
+/// Every frame carries the hop index it is sent on, so the receiver knows where the sender is.
+/// The sender hops after every packet, also when it failed: a packet that failed may still have arrived
+/// and only its acknowledge was lost, and then the receiver has hopped as well.
+/// When a packet got lost altogether, the receiver stays behind. After two failures in a row, or when nothing
+/// was acknowledged for the resync time, the sender goes to the home channel, where the receiver waits
+/// when it has heard nothing for the resync time. The first frame that arrives there brings both back in step.
+/// The sender keeps a score per channel from the retransmits and failures it sees (RF24_statistics),
+/// and marks channels with a bad score bad. The receiver learns about it from update frames, the map
+/// of the sequence only changes when an update is acknowledged. Every 1024 packets the marks are cleared,
+/// so a channel that got better is used again.
+/// The radio must be in a TX stream (RF24::start_tx_stream()) with auto acknowledge and dynamic payload enabled.
+/// One packet is in flight at a time, because the channel can only change when the TX FIFO is empty.
+class RF24_hop_sender {
+private:
+    RF24 & radio; /// The radio of the PTX.
+    RF24_hop_sequence & sequence; /// The hop sequence, shared with the receiver.
+    uint8_t home; /// The channel both sides go to when they lost each other.
+    uint8_t index; /// The hop index of the next frame.
+    uint8_t failures; /// Number of failed frames in a row.
+    uint_fast64_t last_ok; /// Time the last frame was acknowledged.
+    uint32_t resync_us; /// Time without acknowledges after which we go home.
+    uint8_t score[126]; /// Per channel, a decaying sum of retransmits and failures.
+    uint8_t wanted[16]; /// One bit per channel, set if we want the channel marked bad.
+    uint16_t packets; /// Frames sent since the marks were cleared.
+    uint8_t bad_score; /// Score from which a channel is marked bad.
+    uint16_t gap_us; /// Time between an acknowledge and the next frame on another channel.
+    
+    /// \brief
+    /// This will send a frame on the channel of the current index, or home, and hop.
+    bool send_frame(uint8_t* frame, const int bytes, const bool update);
+    
+    /// \brief
+    /// This will add the result of a frame to the score of its channel.
+    void score_channel(const int channel, const uint32_t retransmits, const bool ok);
+public:
+    /// \brief
+    /// Both sides must use the same sequence, home channel and resync time.
+    RF24_hop_sender(RF24 & radio, RF24_hop_sequence & sequence, const uint8_t home, const uint32_t resync_us = 20000);
+    
+    /// \brief
+    /// This will return the channel the next frame is sent on.
+    int channel() const;
+    
+    /// \brief
+    /// This will send 1 to RF24_hop_data bytes, and return true if they were acknowledged.
+    /// \details
+    /// If the bad channel map changed, an update frame is sent first.
+    bool send(const uint8_t* data, const int bytes);
+    
+    /// \brief
+    /// This will set the time the sender waits after an acknowledge before it sends on the next channel.
+    /// \details
+    /// In that time the receiver must read the frame and listen on the next channel, which takes 130 us
+    /// to settle. The default is 300 us.
+    void set_gap(const uint16_t us);
+    
+    /// \brief
+    /// This will set the score from which a channel is marked bad.
+    /// \details
+    /// Every frame adds its retransmits times 8, and 128 if it failed, to the score of its channel,
+    /// after the score was decreased by a quarter. The default is 96.
+    void set_bad_score(const uint8_t score);
+    
+    /// \brief
+    /// This will enable the observation of retransmits and start at hop index 0.
+    void start();
+};
+
+/// \brief
+/// Receives data from an RF24_hop_sender, and hops along.
+/// \details
+/// This is a sink for RF24::receive_burst(). Data frames are passed to the handler without their hop index.
+/// After every frame the receiver hops to the channel after the one the frame was sent on.
+/// The sender hops right after the acknowledge, so frames must be read soon after they arrive.
+/// poll() must be called regularly, to go home when nothing was heard for the resync time.
+class RF24_hop_receiver : public RF24_packet_sink {
+private:
+    RF24 & radio; /// The radio of the PRX.
+    RF24_hop_sequence & sequence; /// The hop sequence, shared with the sender.
+    RF24_packet_handler & handler; /// Handles the data.
+    uint8_t home; /// The channel both sides go to when they lost each other.
+    uint8_t frame[33]; /// The frame that is read.
+    uint_fast64_t last_heard; /// Time the last frame arrived.
+    uint32_t resync_us; /// Time without frames after which we go home.
+    bool at_home; /// Holds if we wait on the home channel.
+    
+    /// \brief
+    /// This will listen on another channel.
+    void tune(const int channel);
+public:
+    /// \brief
+    /// Both sides must use the same sequence, home channel and resync time.
+    RF24_hop_receiver(RF24 & radio, RF24_hop_sequence & sequence, RF24_packet_handler & handler, const uint8_t home,
+                      const uint32_t resync_us = 20000);
+    
+    /// \brief
+    /// This will handle a frame: update the map or pass on the data, then hop.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will go home if nothing was heard for the resync time.
+    void poll();
+    
+    /// \brief
+    /// This will return storage for a frame.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will start listening on the home channel.
+    /// \details
+    /// The radio must be a PRX that is listening, with auto acknowledge and dynamic payload enabled.
+    void start();
+};
+
+#endif
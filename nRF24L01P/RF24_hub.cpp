@@ -0,0 +1,102 @@
+// ==========================================================================
+//
+// File      : RF24_hub.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_hub.cpp
+ */
+
+#include "RF24_hub.hpp"
+
+RF24_hub::RF24_hub(RF24 & radio):
+    radio( radio ),
+    queues{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr },
+    handlers{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr },
+    destination( target::drop )
+{
+    this->reset_counters();
+}
+
+void RF24_hub::commit(const uint8_t pipe, const uint8_t length){
+    switch (destination){
+        case target::queue:
+            queues[pipe]->commit(pipe, length);
+            break;
+        case target::handler:
+            scratch.pipe = pipe;
+            scratch.length = length;
+            handlers[pipe]->handle(RF24_packet_view{ &scratch.frame[1], length, pipe }); // The payload is behind the command byte.
+            break;
+        case target::drop:
+            pipe_counters[pipe].dropped++; // Nobody wants it, or there is no room.
+            return;
+    }
+    pipe_counters[pipe].packets++;
+    pipe_counters[pipe].bytes += length;
+    return;
+}
+
+const RF24_pipe_counters & RF24_hub::counters(const uint8_t pipe) const{
+    return pipe_counters[pipe];
+}
+
+int RF24_hub::poll(){
+    return radio.receive_burst(*this);
+}
+
+uint8_t* RF24_hub::reserve(const uint8_t pipe, const uint8_t length){
+    if (pipe > 5) return nullptr;
+    if (queues[pipe] != nullptr){
+        uint8_t* frame = queues[pipe]->reserve(pipe, length);
+        if (frame != nullptr){
+            destination = target::queue;
+            return frame; // Read the packet straight into the queue.
+        }
+        // The queue is full. Read the packet anyway and drop it, so the other pipes can go on.
+        destination = target::drop;
+    }
+    else if (handlers[pipe] != nullptr){
+        destination = target::handler;
+    }
+    else {
+        destination = target::drop;
+    }
+    return scratch.frame;
+}
+
+void RF24_hub::reset_counters(){
+    for (int pipe = 0; pipe < 6; pipe++){
+        pipe_counters[pipe].packets = 0;
+        pipe_counters[pipe].bytes = 0;
+        pipe_counters[pipe].dropped = 0;
+    }
+    return;
+}
+
+void RF24_hub::set_handler(const uint8_t pipe, RF24_packet_handler* handler){
+    if (pipe > 5) return;
+    handlers[pipe] = handler;
+    return;
+}
+
+void RF24_hub::set_queue(const uint8_t pipe, RF24_packet_ring* queue){
+    if (pipe > 5) return;
+    queues[pipe] = queue;
+    return;
+}
+
+void RF24_hub::start(const uint8_t* base){
+    radio.start_hub_mode(base);
+    return;
+}
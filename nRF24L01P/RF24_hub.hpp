@@ -0,0 +1,99 @@
+// ==========================================================================
+//
+// File      : RF24_hub.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @class RF24_hub
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_hub.hpp
+ */
+
+#ifndef RF24_HUB_H
+#define RF24_HUB_H
+
+#include "RF24.hpp"
+
+/// \brief
+/// Counters of one data pipe of a hub.
+struct RF24_pipe_counters {
+    uint32_t packets; /// Number of packets received.
+    uint32_t bytes; /// Number of payload bytes received.
+    uint32_t dropped; /// Number of packets thrown away, because the queue was full or the pipe has no queue or handler.
+};
+
+/// \brief
+/// Receiver for up to six nodes, one on every data pipe.
+/// \details
+/// The hub starts the radio with RF24::start_hub_mode(), so every pipe has its own address.
+/// Received packets are sorted by the pipe number the chip reports (RX_P_NO).
+/// Every pipe can have its own queue, where packets are read into without copying,
+/// or its own handler, which is called for every packet.
+/// When the queue of a pipe is full, its packets are dropped, so one busy node can not block the others.
+/// For every pipe the number of packets and bytes is counted.
+class RF24_hub : public RF24_packet_sink {
+private:
+    RF24 & radio; /// The radio the hub receives with.
+    RF24_packet_ring* queues[6]; /// The queue of every pipe, or nullptr.
+    RF24_packet_handler* handlers[6]; /// The handler of every pipe, or nullptr.
+    RF24_pipe_counters pipe_counters[6]; /// The counters of every pipe.
+    RF24_packet_slot scratch; /// Holds packets that go to a handler or are dropped.
+    /// Where the packet handed out by reserve() goes to.
+    enum class target { queue, handler, drop } destination;
+public:
+    RF24_hub(RF24 & radio);
+    
+    /// \brief
+    /// This will store the packet that was reserved last, in its queue or by calling its handler.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return the counters of a pipe.
+    const RF24_pipe_counters & counters(const uint8_t pipe) const;
+    
+    /// \brief
+    /// This will read the packets from the RX FIFO and hand them to their pipes.
+    /// \details
+    /// This will return the number of packets read.
+    int poll();
+    
+    /// \brief
+    /// This will return storage for a packet of a pipe.
+    /// \details
+    /// If the pipe has a queue with room, the packet is read straight into the queue.
+    /// Otherwise it is read into the scratch slot, to be handled or dropped.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will set all counters to zero.
+    void reset_counters();
+    
+    /// \brief
+    /// This will set the handler of a pipe.
+    /// \details
+    /// Use nullptr to remove it. A pipe with a queue does not use its handler.
+    void set_handler(const uint8_t pipe, RF24_packet_handler* handler);
+    
+    /// \brief
+    /// This will set the queue of a pipe.
+    /// \details
+    /// Use nullptr to remove it.
+    void set_queue(const uint8_t pipe, RF24_packet_ring* queue);
+    
+    /// \brief
+    /// This will start the radio as a hub.
+    /// \details
+    /// See RF24::start_hub_mode().
+    void start(const uint8_t* base);
+};
+
+#endif
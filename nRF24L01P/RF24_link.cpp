@@ -0,0 +1,337 @@
+// ==========================================================================
+//
+// File      : RF24_link.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_link.cpp
+ */
+
+#include "RF24_link.hpp"
+
+RF24_data_rate RF24_link_rate(const int step){
+    if (step <= 0) return RF24_data_rate::rate_250kbps;
+    if (step == 1) return RF24_data_rate::rate_1mbps;
+    return RF24_data_rate::rate_2mbps;
+}
+
+RF24_pa_level RF24_link_level(const int step){
+    if (step <= 2) return RF24_pa_level::max;
+    if (step == 3) return RF24_pa_level::high;
+    if (step == 4) return RF24_pa_level::low;
+    return RF24_pa_level::min;
+}
+
+void RF24_link_apply(RF24 & radio, const int step){
+    radio.begin_batch();
+    radio.set_data_rate(RF24_link_rate(step));
+    radio.set_pa_level(RF24_link_level(step));
+    radio.end_batch();
+    return;
+}
+
+RF24_link_adapter::RF24_link_adapter(RF24 & radio, const uint8_t* data_address, const uint8_t* control_address):
+    radio( radio ),
+    current( 0 ),
+    top( RF24_link_steps - 1 ),
+    window( 32 ),
+    down_failures( 50 ),
+    down_retransmits( 100 ),
+    up_retransmits( 25 ),
+    sent( 0 ),
+    failed( 0 ),
+    retransmits_start( 0 ),
+    good_windows( 0 ),
+    holdoff( 2 ),
+    probing( false ),
+    tuner( nullptr )
+{
+    for (int i = 0; i < 5; i++){
+        this->data_address[i] = data_address[i];
+        this->control_address[i] = control_address[i];
+    }
+}
+
+bool RF24_link_adapter::adapt(){
+    if (!this->due()) return false;
+    const uint32_t packets = sent + failed;
+    const uint32_t failures = (failed * 1000) / packets; // Per 1000 packets.
+    const uint32_t retransmits = ((radio.statistics().retransmits - retransmits_start) * 100) / packets; // Per 100 packets.
+    const bool probe = probing;
+    const uint32_t window_sent = sent; // start_window() clears the counters.
+    const uint32_t window_failed = failed;
+    probing = false;
+    this->start_window();
+    
+    if (window_sent == 0 && window_failed == packets){
+        // Nothing arrived, the follower may be on another step.
+        good_windows = 0;
+        return this->resync();
+    }
+    if (failures > down_failures || retransmits > down_retransmits){
+        good_windows = 0;
+        // If the step up we just made is bad, wait longer before the next try. If the link got worse, start over.
+        if (!probe) holdoff = 2;
+        else if (holdoff < 64) holdoff *= 2;
+        return (current > 0) && this->change(current - 1);
+    }
+    if (failures == 0 && retransmits <= up_retransmits){
+        if (++good_windows >= holdoff && current < top){
+            good_windows = 0;
+            probing = this->change(current + 1);
+            return probing;
+        }
+        return false;
+    }
+    good_windows = 0; // Not bad enough to step down, not good enough to step up.
+    return false;
+}
+
+void RF24_link_adapter::apply(const int step){
+    RF24_link_apply(radio, step);
+    if (tuner != nullptr) tuner->retune();
+    return;
+}
+
+bool RF24_link_adapter::change(const int step){
+    const int old = current;
+    const int channel = radio.read_register(RF_CH);
+    if (!this->send_control(RF24_link_switch, step)){
+        // The follower may have switched and only the acknowledge got lost, it goes back by itself.
+        radio.wait_us(RF24_link_revert_us);
+        return false;
+    }
+    radio.wait_us(2000); // The follower switches 1 ms after it acknowledged.
+    this->apply(step);
+    current = step;
+    return this->confirm(old, channel);
+}
+
+bool RF24_link_adapter::confirm(const int old_step, const int old_channel){
+    for (int i = 0; i < 3; i++){
+        if (this->send_control(RF24_link_confirm, current)){
+            this->start_window();
+            return true;
+        }
+    }
+    // The new setting does not work, go back. The follower goes back when its switch is not confirmed.
+    radio.set_channel(old_channel);
+    this->apply(old_step);
+    current = old_step;
+    radio.wait_us(RF24_link_revert_us);
+    this->start_window();
+    return false;
+}
+
+bool RF24_link_adapter::due() const{
+    return (sent + failed) >= window;
+}
+
+RF24_pa_level RF24_link_adapter::level() const{
+    return RF24_link_level(current);
+}
+
+RF24_data_rate RF24_link_adapter::rate() const{
+    return RF24_link_rate(current);
+}
+
+bool RF24_link_adapter::move(const int channel){
+    if (channel < 0 || channel > 125) return false;
+    const int old = radio.read_register(RF_CH);
+    if (channel == old) return true;
+    if (!this->send_control(RF24_link_channel, channel)){
+        // The follower may have moved and only the acknowledge got lost, it goes back by itself.
+        radio.wait_us(RF24_link_revert_us);
+        return false;
+    }
+    radio.wait_us(2000); // The follower moves 1 ms after it acknowledged.
+    radio.set_channel(channel);
+    return this->confirm(current, old);
+}
+
+void RF24_link_adapter::report(const RF24::tx_result result){
+    if (result == RF24::tx_result::sent) sent++;
+    else if (result == RF24::tx_result::failed) failed++;
+    return;
+}
+
+bool RF24_link_adapter::resync(){
+    for (int step = 0; step < RF24_link_steps; step++){
+        this->apply(step);
+        if (this->send_control(RF24_link_switch, 0)){
+            radio.wait_us(2000); // The follower switches 1 ms after it acknowledged.
+            this->apply(0);
+            current = 0;
+            holdoff = 2;
+            this->send_control(RF24_link_confirm, 0);
+            this->start_window();
+            return true;
+        }
+    }
+    this->apply(current); // Nobody heard us, keep trying with the data.
+    this->start_window();
+    return false;
+}
+
+bool RF24_link_adapter::send_control(const uint8_t command, const int step){
+    const uint8_t frame[2] = {command, (uint8_t)step};
+    RF24_packet_ring_buffer<3> responses; // The follower does not answer, but an ACK payload must not stay in the RX FIFO.
+    radio.begin_batch();
+    radio.set_tx_address(&*control_address);
+    radio.set_rx_address(RX_ADDR_P0, &*control_address); // Pipe 0 receives the acknowledge.
+    radio.end_batch();
+    const bool acknowledged = (radio.request(&*frame, 2, responses) >= 0);
+    radio.begin_batch();
+    radio.set_tx_address(&*data_address);
+    radio.set_rx_address(RX_ADDR_P0, &*data_address);
+    radio.end_batch();
+    return acknowledged;
+}
+
+void RF24_link_adapter::set_limits(const uint16_t window, const uint16_t down_failures, const uint16_t down_retransmits, const uint16_t up_retransmits){
+    this->window = (window == 0) ? 1 : window;
+    this->down_failures = down_failures;
+    this->down_retransmits = down_retransmits;
+    this->up_retransmits = up_retransmits;
+    return;
+}
+
+void RF24_link_adapter::set_retry_tuner(RF24_retry_tuner & tuner){
+    this->tuner = &tuner;
+    return;
+}
+
+void RF24_link_adapter::start(const int step, const int top){
+    this->top = (top < 0) ? 0 : ((top >= RF24_link_steps) ? RF24_link_steps - 1 : top);
+    current = (step < 0) ? 0 : ((step > this->top) ? this->top : step);
+    good_windows = 0;
+    holdoff = 2;
+    radio.enable_tx_observation(true);
+    this->apply(current);
+    this->start_window();
+    return;
+}
+
+void RF24_link_adapter::start_window(){
+    sent = 0;
+    failed = 0;
+    retransmits_start = radio.statistics().retransmits;
+    return;
+}
+
+int RF24_link_adapter::step() const{
+    return current;
+}
+
+RF24_link_follower::RF24_link_follower(RF24 & radio, const uint8_t control_pipe, const uint8_t* control_address):
+    radio( radio ),
+    control_pipe( control_pipe ),
+    current( 0 ),
+    previous( 0 ),
+    current_channel( 0 ),
+    previous_channel( 0 ),
+    next( 0 ),
+    next_channel( 0 ),
+    confirmed( true ),
+    switching( false ),
+    switch_at( 0 ),
+    revert_at( 0 )
+{
+    for (int i = 0; i < 5; i++){
+        this->control_address[i] = control_address[i];
+    }
+}
+
+void RF24_link_follower::apply(){
+    radio.begin_batch();
+    RF24_link_apply(radio, current);
+    radio.set_channel(current_channel);
+    radio.end_batch();
+    return;
+}
+
+int RF24_link_follower::channel() const{
+    return current_channel;
+}
+
+void RF24_link_follower::follow(const int step, const int channel){
+    if (step == current && channel == current_channel && confirmed){
+        switching = false; // Already there.
+        return;
+    }
+    next = step;
+    next_channel = channel;
+    switching = true;
+    switch_at = radio.clock().now_us() + 1000; // Let the acknowledge go out on the old setting.
+    return;
+}
+
+void RF24_link_follower::handle(const RF24_packet_view & packet){
+    if (packet.pipe != control_pipe || packet.length != 2) return;
+    const int value = packet.data[1];
+    if (packet.data[0] == RF24_link_switch && value < RF24_link_steps){
+        this->follow(value, switching ? next_channel : current_channel);
+    }
+    else if (packet.data[0] == RF24_link_channel && value <= 125){
+        this->follow(switching ? next : current, value);
+    }
+    else if (packet.data[0] == RF24_link_confirm && value == current){
+        confirmed = true;
+    }
+    return;
+}
+
+void RF24_link_follower::poll(){
+    const uint_fast64_t now = radio.clock().now_us();
+    if (switching && now >= switch_at){
+        if (confirmed){
+            // Go back to the last confirmed setting if this switch is not confirmed.
+            previous = current;
+            previous_channel = current_channel;
+        }
+        current = next;
+        current_channel = next_channel;
+        switching = false;
+        confirmed = false;
+        this->apply();
+        revert_at = now + RF24_link_revert_us;
+        return;
+    }
+    if (switching || confirmed || now < revert_at) return;
+    current = previous;
+    current_channel = previous_channel;
+    confirmed = true;
+    this->apply();
+    return;
+}
+
+void RF24_link_follower::start(const int step){
+    current = (step < 0) ? 0 : ((step >= RF24_link_steps) ? RF24_link_steps - 1 : step);
+    previous = current;
+    current_channel = radio.read_register(RF_CH);
+    previous_channel = current_channel;
+    confirmed = true;
+    switching = false;
+    radio.begin_batch();
+    radio.set_rx_address(RX_ADDR_P0 + control_pipe, &*control_address);
+    radio.set_bit(EN_RXADDR, control_pipe);
+    radio.set_bit(EN_AA, control_pipe);
+    radio.enable_dynamic_payload(control_pipe);
+    radio.end_batch();
+    RF24_link_apply(radio, current);
+    return;
+}
+
+int RF24_link_follower::step() const{
+    return current;
+}
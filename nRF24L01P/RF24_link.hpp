@@ -0,0 +1,238 @@
+// ==========================================================================
+//
+// File      : RF24_link.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_link.hpp
+ */
+
+#ifndef RF24_LINK_H
+#define RF24_LINK_H
+
+#include "RF24.hpp"
+#include "RF24_packet.hpp"
+#include "RF24_retry.hpp"
+
+/// \brief
+/// The steps of the link ladder.
+/// \details
+/// Step 0 is the most robust setting: 250 kbps at full power. Every step up is faster or uses less power:
+/// 1 Mbps at full power, 2 Mbps at full power, then 2 Mbps at high, low and minimum power.
+/// A lower data rate gives a better receiver sensitivity, a lower power level saves current while sending.
+const int RF24_link_steps = 6;
+
+/// \brief
+/// Commands of the control frames the adapter sends to the follower.
+/// \details
+/// A control frame is two bytes: the command and the step, or the channel for RF24_link_channel.
+const uint8_t RF24_link_switch = 0x01;
+const uint8_t RF24_link_confirm = 0x02;
+const uint8_t RF24_link_channel = 0x03;
+
+/// \brief
+/// Time in microseconds after which a follower goes back to its old step if a switch is not confirmed.
+const uint32_t RF24_link_revert_us = 20000;
+
+/// \brief
+/// This will return the data rate of a step of the link ladder.
+RF24_data_rate RF24_link_rate(const int step);
+
+/// \brief
+/// This will return the power level of a step of the link ladder.
+RF24_pa_level RF24_link_level(const int step);
+
+/// \brief
+/// This will set the data rate and power level of a step of the link ladder, in one batch.
+void RF24_link_apply(RF24 & radio, const int step);
+
+/// \brief
+/// Picks the data rate and power level of a PTX from the quality of its link.
+/// \details
+/// The application reports the result of every packet it sends with report(). After a window of packets,
+/// adapt() looks at the packets that failed and the retransmits the chip counted (RF24::statistics()).
+/// When the link is bad the adapter steps down the ladder at once. When it is good for a number of windows in a row
+/// it steps up. Every time a step up turns out bad, the number of good windows needed before the next try doubles,
+/// so a link that sits on the edge of two steps does not keep switching.
+/// Both sides must use the same data rate, so a switch is agreed with an RF24_link_follower on the PRX.
+/// Control frames are sent to the control address, which the follower listens to on a pipe of its own:
+/// a switch frame on the old setting, then a confirm frame on the new one. If the confirm frame does not arrive,
+/// the adapter goes back to the old setting, and the follower goes back by itself after RF24_link_revert_us.
+/// When a whole window failed, the two sides may disagree on the setting. The adapter then tries every step
+/// until the follower hears a switch frame, and both start again at step 0.
+/// The link can be moved to another channel with move(), in the same way.
+/// The radio must be in a TX stream (RF24::start_tx_stream()) with auto acknowledge and dynamic payload enabled,
+/// and adapt() must only be called when no payloads are in flight.
+class RF24_link_adapter {
+private:
+    RF24 & radio; /// The radio of the PTX.
+    uint8_t data_address[5]; /// The address data packets are sent to.
+    uint8_t control_address[5]; /// The address control frames are sent to.
+    int current; /// The step in use.
+    int top; /// The highest step that may be used.
+    uint16_t window; /// Number of packets in a window.
+    uint16_t down_failures; /// Failed packets per 1000 above which the adapter steps down.
+    uint16_t down_retransmits; /// Retransmits per 100 packets above which the adapter steps down.
+    uint16_t up_retransmits; /// Retransmits per 100 packets up to which a window without failures is good.
+    uint16_t sent; /// Packets sent in this window.
+    uint16_t failed; /// Packets that failed in this window.
+    uint32_t retransmits_start; /// RF24_statistics::retransmits at the start of this window.
+    uint8_t good_windows; /// Number of good windows in a row.
+    uint8_t holdoff; /// Number of good windows in a row needed to step up.
+    bool probing; /// Holds if this is the first window after a step up.
+    RF24_retry_tuner* tuner; /// Tuner that must follow the data rate, or nullptr.
+    
+    /// \brief
+    /// This will set the data rate and power level of a step on our side.
+    void apply(const int step);
+    
+    /// \brief
+    /// This will switch both sides to another step, and return true if that worked.
+    bool change(const int step);
+    
+    /// \brief
+    /// This will confirm a switch on the new setting, or go back to the old step and channel if that fails.
+    bool confirm(const int old_step, const int old_channel);
+    
+    /// \brief
+    /// This will try every step until the follower hears us, then switch both sides to step 0.
+    bool resync();
+    
+    /// \brief
+    /// This will send a control frame to the follower, and return true if it was acknowledged.
+    bool send_control(const uint8_t command, const int step);
+    
+    /// \brief
+    /// This will start a new window.
+    void start_window();
+public:
+    /// \brief
+    /// The addresses are 5 bytes long and are copied.
+    RF24_link_adapter(RF24 & radio, const uint8_t* data_address, const uint8_t* control_address);
+    
+    /// \brief
+    /// This will step up or down if a window is complete, and return true if the step changed.
+    /// \details
+    /// No payloads may be in flight. Control frames are sent with RF24::request(), and the data address is set
+    /// again when this returns The waits for the follower to switch go through RF24::wait_us(),
+    /// so they are counted in RF24_statistics::blocked_us.
+    bool adapt();
+    
+    /// \brief
+    /// This will return true if a window is complete, so adapt() must be called.
+    bool due() const;
+    
+    /// \brief
+    /// This will return the power level in use.
+    RF24_pa_level level() const;
+    
+    /// \brief
+    /// This will move both sides to another channel, and return true if that worked.
+    /// \details
+    /// No payloads may be in flight. The channel can be found with an RF24_channel_scanner.
+    bool move(const int channel);
+    
+    /// \brief
+    /// This will return the data rate in use.
+    RF24_data_rate rate() const;
+    
+    /// \brief
+    /// This will count the result of a packet, as returned by RF24::poll().
+    void report(const RF24::tx_result result);
+    
+    /// \brief
+    /// This will set the size of a window and the limits for stepping down and up.
+    /// \details
+    /// The defaults are a window of 32 packets, stepping down above 50 failures per 1000 packets
+    /// or above 100 retransmits per 100 packets, and a good window has no failures and up to 25 retransmits per 100 packets.
+    void set_limits(const uint16_t window, const uint16_t down_failures, const uint16_t down_retransmits, const uint16_t up_retransmits);
+    
+    /// \brief
+    /// This will let a retry tuner set the retransmit delay every time the data rate changes.
+    /// \details
+    /// Without it, the retransmit delay must be long enough for the lowest data rate that is used.
+    void set_retry_tuner(RF24_retry_tuner & tuner);
+    
+    /// \brief
+    /// This will set the radio to a step, and enable the observation of retransmits.
+    /// \details
+    /// The follower must start at the same step. The adapter never goes above top,
+    /// use RF24_link_steps - 4 to keep full power.
+    void start(const int step = 0, const int top = RF24_link_steps - 1);
+    
+    /// \brief
+    /// This will return the step in use.
+    int step() const;
+};
+
+/// \brief
+/// Follows the switches of an RF24_link_adapter on the PRX.
+/// \details
+/// Packets received on the control pipe are passed to handle(), for example from the handler of an RF24_hub.
+/// A switch frame is acknowledged on the old setting, so the follower switches a millisecond after it received it.
+/// handle() does not wait for that: poll() makes the switch when it is due, and goes back to the old step and channel
+/// when a switch is not confirmed in time. So poll() must be called regularly, at least every few hundred microseconds
+/// while a switch is going on, or the confirm frame of the adapter is sent before the follower listens to it.
+class RF24_link_follower : public RF24_packet_handler {
+private:
+    RF24 & radio; /// The radio of the PRX.
+    uint8_t control_pipe; /// The pipe control frames are received on.
+    uint8_t control_address[5]; /// The address of the control pipe.
+    int current; /// The step in use.
+    int previous; /// The step that was used before the last switch.
+    uint8_t current_channel; /// The channel in use.
+    uint8_t previous_channel; /// The channel that was used before the last switch.
+    int next; /// The step of a switch that is waiting for its acknowledge to go out.
+    uint8_t next_channel; /// The channel of a switch that is waiting for its acknowledge to go out.
+    bool confirmed; /// Holds if the last switch was confirmed.
+    bool switching; /// Holds if a switch is waiting for its acknowledge to go out.
+    uint_fast64_t switch_at; /// Time at which the waiting switch is made.
+    uint_fast64_t revert_at; /// Time at which an unconfirmed switch is undone.
+    
+    /// \brief
+    /// This will set the step and channel in use on the radio.
+    void apply();
+    
+    /// \brief
+    /// This will make poll() switch to a step and channel once the acknowledge of the switch frame went out.
+    void follow(const int step, const int channel);
+public:
+    /// \brief
+    /// The address is 5 bytes long and is copied. For pipe 2 to 5 only its first byte is used,
+    /// the other bytes are those of pipe 1.
+    RF24_link_follower(RF24 & radio, const uint8_t control_pipe, const uint8_t* control_address);
+    
+    /// \brief
+    /// This will return the channel in use.
+    int channel() const;
+    
+    /// \brief
+    /// This will handle a packet, packets that are not control frames are ignored.
+    void handle(const RF24_packet_view & packet) override;
+    
+    /// \brief
+    /// This will make a switch that is due, or go back to the old step if the last switch was not confirmed in time.
+    void poll();
+    
+    /// \brief
+    /// This will set the radio to a step and enable the control pipe with auto acknowledge and dynamic payload.
+    /// \details
+    /// The channel the radio is on is the channel in use.
+    void start(const int step = 0);
+    
+    /// \brief
+    /// This will return the step in use.
+    int step() const;
+};
+
+#endif
@@ -0,0 +1,285 @@
+// ==========================================================================
+//
+// File      : RF24_mesh.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_mesh.cpp
+ */
+
+#include "RF24_mesh.hpp"
+
+RF24_mesh::RF24_mesh(RF24 & radio, RF24_packet_handler & handler, const uint16_t address, const uint8_t* network):
+    radio( radio ),
+    handler( handler ),
+    node_address( address ),
+    level( 0 ),
+    first_channel( 0 ),
+    head( 0 ),
+    count( 0 ),
+    loaded( 0 ),
+    current_hop( 0xFF ),
+    tries( 3 ),
+    backoff_us( 1000 ),
+    hold_us( 500 ),
+    resume_at( 0 ),
+    waiting_since( 0 ),
+    sending( false ),
+    last_source( 0 ),
+    sequence( 0 ),
+    seen_next( 0 )
+{
+    this->network[0] = network[0];
+    this->network[1] = network[1];
+    for (int i = 0; i < RF24_mesh_sources; i++){
+        seen_sources[i] = 0xFFFF;
+    }
+    // The address ends at the first digit that is not a child, the digits above it are cut off.
+    while (level < RF24_mesh_levels){
+        const int digit = (address >> (3 * level)) & 7;
+        if (digit < 1 || digit > RF24_mesh_children) break;
+        level++;
+    }
+    node_address = address & ((1 << (3 * level)) - 1);
+    // The parent listens for us on the pipe of our last digit, the children listen for us on pipe 5.
+    if (level > 0){
+        routes[RF24_mesh_parent].node = node_address & ((1 << (3 * (level - 1))) - 1);
+        pipe_address(routes[RF24_mesh_parent].node, (node_address >> (3 * (level - 1))) & 7, network, routes[RF24_mesh_parent].address);
+    }
+    for (int child = 1; child <= RF24_mesh_children && level < RF24_mesh_levels; child++){
+        routes[child].node = node_address | (child << (3 * level));
+        pipe_address(routes[child].node, 5, network, routes[child].address);
+    }
+    this->reset_counters();
+}
+
+uint16_t RF24_mesh::address() const{
+    return node_address;
+}
+
+void RF24_mesh::commit(const uint8_t pipe, const uint8_t length){
+    const int index = (head + count) % RF24_mesh_queue;
+    const uint8_t* frame = &queue[index].frame[1];
+    if (length < RF24_mesh_header){
+        mesh_counters.dropped++;
+        return;
+    }
+    const uint16_t destination = frame[0] | (frame[1] << 8);
+    const uint16_t source = frame[2] | (frame[3] << 8);
+    if (this->seen(source, frame[4])){
+        mesh_counters.repeated++; // It is acknowledged again, so the hop before us stops sending it.
+        return;
+    }
+    if (destination == node_address){
+        mesh_counters.received++;
+        last_source = source;
+        handler.handle(RF24_packet_view{ &frame[RF24_mesh_header], (uint8_t)(length - RF24_mesh_header), pipe });
+        return;
+    }
+    const int hop = this->next_hop(destination);
+    if (hop < 0){
+        mesh_counters.dropped++;
+        return;
+    }
+    // The frame stays where it was read to, and is sent from there.
+    queue[index].length = length;
+    queue[index].pipe = pipe;
+    hops[index] = hop;
+    tries_used[index] = 0;
+    if (count++ == 0) waiting_since = radio.clock().now_us();
+    mesh_counters.forwarded++;
+    return;
+}
+
+const RF24_mesh_counters & RF24_mesh::counters() const{
+    return mesh_counters;
+}
+
+int RF24_mesh::next_hop(const uint16_t destination) const{
+    if (destination == node_address) return -1;
+    // Below us if the lower digits are our address.
+    if ((destination & ((1 << (3 * level)) - 1)) == node_address){
+        const int child = (level < RF24_mesh_levels) ? (destination >> (3 * level)) & 7 : 0;
+        return (child >= 1 && child <= RF24_mesh_children) ? child : -1;
+    }
+    return (level > 0) ? RF24_mesh_parent : -1;
+}
+
+int RF24_mesh::pending() const{
+    return count;
+}
+
+void RF24_mesh::pipe_address(const uint16_t node, const uint8_t pipe, const uint8_t* network, uint8_t* address){
+    address[0] = 0xC0 | pipe; // Only the first byte is unique per pipe.
+    address[1] = node & 0xFF;
+    address[2] = node >> 8;
+    address[3] = network[0];
+    address[4] = network[1];
+    return;
+}
+
+void RF24_mesh::poll(){
+    // Collect the results of the frames in flight, they come in the order they were loaded.
+    while (loaded > 0){
+        const RF24::tx_result result = radio.poll();
+        if (result == RF24::tx_result::pending) break;
+        if (result == RF24::tx_result::sent){
+            head = (head + 1) % RF24_mesh_queue;
+            count--;
+            loaded--;
+            mesh_counters.sent++;
+            continue;
+        }
+        // The oldest frame failed, and the ones behind it were flushed with it. They are loaded again.
+        if (result == RF24::tx_result::failed){
+            while (radio.poll() == RF24::tx_result::failed){}
+            // The next hop may be sending itself, give it the air for a while. Every node waits a little
+            // different, so two nodes that collided do not collide again.
+            resume_at = radio.clock().now_us() + uint32_t(backoff_us) * (1 + tries_used[head]) + (node_address % 7) * 100;
+            if (++tries_used[head] >= tries){
+                head = (head + 1) % RF24_mesh_queue;
+                count--;
+                mesh_counters.dropped++;
+            }
+        }
+        loaded = 0;
+    }
+    const uint_fast64_t now = radio.clock().now_us();
+    // Outside a TX stream, wait for a burst of frames, so switching to TX and back is paid once for them.
+    const bool burst = sending || count >= 3 || now - waiting_since >= hold_us;
+    if (count > loaded && loaded < 3 && burst && now >= resume_at){
+        const int index = (head + loaded) % RF24_mesh_queue;
+        // The TX address can only change when nothing is in flight.
+        if (loaded == 0 && hops[index] != current_hop) this->select(hops[index]);
+        if (hops[index] == current_hop){
+            if (!sending){
+                radio.set_channel(routes[current_hop].channel);
+                radio.start_tx_stream();
+                sending = true;
+            }
+            if (radio.try_send(&queue[index].frame[1], queue[index].length)) loaded++;
+            return;
+        }
+    }
+    if (loaded > 0) return; // Wait for the results before we listen again.
+    if (sending){
+        radio.set_channel(first_channel + RF24_mesh_channel_step * level); // Our children send on our channel.
+        radio.stop_tx_stream();
+        sending = false;
+    }
+    radio.receive_burst(*this);
+    return;
+}
+
+uint8_t* RF24_mesh::reserve(const uint8_t, const uint8_t){
+    if (count == RF24_mesh_queue) return nullptr; // Leave it in the RX FIFO.
+    return &*queue[(head + count) % RF24_mesh_queue].frame;
+}
+
+void RF24_mesh::reset_counters(){
+    mesh_counters = RF24_mesh_counters{ 0, 0, 0, 0, 0 };
+    return;
+}
+
+bool RF24_mesh::seen(const uint16_t source, const uint8_t number){
+    for (int i = 0; i < RF24_mesh_sources; i++){
+        if (seen_sources[i] != source) continue;
+        if (seen_sequences[i] == number) return true;
+        seen_sequences[i] = number;
+        return false;
+    }
+    // A new source takes the place of the one that was new the longest ago.
+    seen_sources[seen_next] = source;
+    seen_sequences[seen_next] = number;
+    seen_next = (seen_next + 1) % RF24_mesh_sources;
+    return false;
+}
+
+void RF24_mesh::select(const uint8_t hop){
+    radio.set_tx_address(routes[hop].address);
+    radio.set_rx_address(RX_ADDR_P0, routes[hop].address);
+    if (sending) radio.set_channel(routes[hop].channel);
+    current_hop = hop;
+    return;
+}
+
+bool RF24_mesh::send(const uint16_t destination, const uint8_t* data, const int bytes){
+    if (bytes < 0 || bytes > RF24_mesh_data || count == RF24_mesh_queue) return false;
+    const int hop = this->next_hop(destination);
+    if (hop < 0) return false;
+    const int index = (head + count) % RF24_mesh_queue;
+    uint8_t* frame = &queue[index].frame[1];
+    frame[0] = destination & 0xFF;
+    frame[1] = destination >> 8;
+    frame[2] = node_address & 0xFF;
+    frame[3] = node_address >> 8;
+    frame[4] = sequence++;
+    for (int i = 0; i < bytes; i++){
+        frame[RF24_mesh_header + i] = data[i];
+    }
+    queue[index].length = RF24_mesh_header + bytes;
+    queue[index].pipe = 0;
+    hops[index] = hop;
+    tries_used[index] = 0;
+    if (count++ == 0) waiting_since = radio.clock().now_us();
+    return true;
+}
+
+void RF24_mesh::set_backoff(const uint16_t us){
+    backoff_us = us;
+    return;
+}
+
+void RF24_mesh::set_hold(const uint16_t us){
+    hold_us = us;
+    return;
+}
+
+void RF24_mesh::set_tries(const uint8_t times){
+    tries = (times > 0) ? times : 1;
+    return;
+}
+
+uint16_t RF24_mesh::source() const{
+    return last_source;
+}
+
+void RF24_mesh::start(const uint8_t channel){
+    uint8_t address[5];
+    first_channel = channel;
+    // Every link uses the channel of the level of its receiver, so the hops of a frame do not share the air.
+    if (level > 0) routes[RF24_mesh_parent].channel = channel + RF24_mesh_channel_step * (level - 1); // The root has no parent.
+    for (int child = 1; child <= RF24_mesh_children; child++){
+        routes[child].channel = channel + RF24_mesh_channel_step * (level + 1);
+    }
+    radio.set_ce(0);
+    sending = false;
+    loaded = 0;
+    radio.set_channel(channel + RF24_mesh_channel_step * level);
+    for (uint8_t pipe = 1; pipe <= 5; pipe++){
+        pipe_address(node_address, pipe, network, &*address);
+        radio.set_rx_address(RX_ADDR_P0 + pipe, &*address);
+    }
+    this->select((level > 0) ? RF24_mesh_parent : 1); // Pipe 0 must not keep an address of another node.
+    // The root has no parent, a node at the lowest level no children.
+    uint8_t pipes = (1 << ERX_P0);
+    if (level < RF24_mesh_levels) pipes |= (1 << ERX_P1) | (1 << ERX_P2) | (1 << ERX_P3) | (1 << ERX_P4);
+    if (level > 0) pipes |= (1 << ERX_P5);
+    radio.write_register(EN_RXADDR, pipes);
+    radio.write_register(EN_AA, 0x3F); // Every hop is acknowledged.
+    radio.write_register(DYNPD, 0x3F);
+    radio.write_register(FEATURE, radio.read_register(FEATURE) | (1 << EN_DPL));
+    radio.write_register(NRF_CONFIG, radio.read_register(NRF_CONFIG) | (1 << PRIM_RX) | (1 << PWR_UP));
+    radio.set_ce(1);
+    return;
+}
@@ -0,0 +1,227 @@
+// ==========================================================================
+//
+// File      : RF24_mesh.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_mesh.hpp
+ */
+
+#ifndef RF24_MESH_H
+#define RF24_MESH_H
+
+#include "RF24.hpp"
+#include "RF24_packet.hpp"
+
+/// \brief
+/// Layout of a mesh frame.
+/// \details
+/// Byte 0-1 hold the node the frame goes to, byte 2-3 the node it comes from, both least significant byte first,
+/// byte 4 the sequence number the source gave the frame, followed by up to RF24_mesh_data bytes.
+const int RF24_mesh_header = 5;
+const int RF24_mesh_data = 27;
+
+/// \brief
+/// Shape of the tree.
+/// \details
+/// A node address holds one digit of 3 bits per level, the lowest digit is the first level under the root.
+/// Every digit is 1 to RF24_mesh_children, so node 0 is the root, node 2 (octal 02) its second child and
+/// node 012 (octal) the first child of node 2. There are RF24_mesh_levels levels under the root.
+const int RF24_mesh_children = 4;
+const int RF24_mesh_levels = 5;
+
+/// \brief
+/// Distance between the channels of two levels.
+/// \details
+/// The nodes of a level listen on the channel of start() plus this times their level, so 2 MHz apart.
+const int RF24_mesh_channel_step = 2;
+
+/// \brief
+/// Number of frames a node can have waiting, its own and those it forwards.
+const int RF24_mesh_queue = 8;
+
+/// \brief
+/// Number of sources a node remembers the last sequence number of, to find frames that arrive again.
+const int RF24_mesh_sources = 8;
+
+/// \brief
+/// The hop to the parent, hops 1 to RF24_mesh_children go to the children.
+const uint8_t RF24_mesh_parent = 0;
+
+/// \brief
+/// Counters of a mesh node.
+struct RF24_mesh_counters {
+    uint32_t sent; /// Number of frames the next hop acknowledged, own and forwarded.
+    uint32_t received; /// Number of frames for this node.
+    uint32_t forwarded; /// Number of frames taken in to pass on.
+    uint32_t dropped; /// Number of frames without a route, or that the next hop did not acknowledge.
+    uint32_t repeated; /// Number of frames that arrived again because their acknowledge got lost.
+};
+
+/// \brief
+/// A neighbour in the routing table of a mesh node.
+struct RF24_mesh_route {
+    uint16_t node; /// The address of the neighbour.
+    uint8_t address[5]; /// The pipe address the neighbour listens on for us.
+    uint8_t channel; /// The channel the neighbour listens on.
+};
+
+/// \brief
+/// A node of a tree shaped network, which forwards frames between its parent and its children.
+/// \details
+/// A single radio reaches one hop. With the mesh, every node can send to every other node, through its parent
+/// and children. The place of a node in the tree is its address (see RF24_mesh_levels), so the next hop follows
+/// from the address of the destination: down to a child if it is below us, otherwise up to the parent.
+/// The routing table only holds the parent and the children, 8 bytes each, and is filled by the constructor
+/// and start().
+///
+/// Every node listens for its children on pipe 1 to 4 and for its parent on pipe 5, all with the same 4 upper
+/// address bytes, which are the node address and the network id. Pipe 2 to 5 only differ in the first byte,
+/// as the chip needs. Pipe 0 holds the address of the current next hop, for its acknowledges. Only we send to
+/// that address, so pipe 0 never takes frames that are meant for another node.
+/// The nodes of every level listen on a channel of their own (see RF24_mesh_channel_step), and a node sends
+/// on the channel of the neighbour. A node that forwards to its parent then does not share the air with its
+/// children, which keep sending to it meanwhile.
+///
+/// Every hop is acknowledged by Enhanced ShockBurst. A frame the next hop did not acknowledge is sent again,
+/// up to the number of tries (see set_tries()), and then dropped. There is no acknowledge from end to end.
+/// When only the acknowledges got lost, the next hop has the frame already. The frames of a source come in
+/// order, so a frame with the same sequence number as the last one of its source is dropped, and every frame
+/// is forwarded and handled at most once, as long as no more than RF24_mesh_sources sources send through a node.
+/// Received frames are read straight into the queue, and frames to forward are sent from there with
+/// RF24::try_send(), so they are not copied. When the queue is full, frames stay in the RX FIFO, and when
+/// that is full too, the chip stops acknowledging, so the node below waits instead of losing them.
+/// Frames for this node go to the handler, without the header. source() tells where they came from.
+class RF24_mesh : public RF24_packet_sink {
+private:
+    RF24 & radio; /// The radio of the node.
+    RF24_packet_handler & handler; /// Handles the frames for this node.
+    uint16_t node_address; /// Our place in the tree.
+    uint8_t level; /// Number of digits in our address, 0 for the root.
+    uint8_t first_channel; /// The channel of the root.
+    uint8_t network[2]; /// The network id, the last two bytes of every pipe address.
+    RF24_mesh_route routes[1 + RF24_mesh_children]; /// The parent and the children.
+    RF24_packet_slot queue[RF24_mesh_queue]; /// The frames that wait, own and forwarded.
+    uint8_t hops[RF24_mesh_queue]; /// The next hop of every frame.
+    uint8_t tries_used[RF24_mesh_queue]; /// Number of times every frame failed.
+    uint8_t head; /// Index of the oldest frame.
+    uint8_t count; /// Number of frames that wait, also those in the TX FIFO.
+    uint8_t loaded; /// Number of frames in the TX FIFO.
+    uint8_t current_hop; /// The hop the TX address is set to.
+    uint8_t tries; /// Number of times a frame is sent before it is dropped.
+    uint16_t backoff_us; /// Time to wait after a failed try, times the number of tries.
+    uint16_t hold_us; /// Time a frame may wait for others before a burst is sent.
+    uint_fast64_t resume_at; /// Time the next frame may be loaded, after a failed try.
+    uint_fast64_t waiting_since; /// Time the queue stopped being empty.
+    bool sending; /// Holds if the radio is in a TX stream.
+    uint16_t last_source; /// The node the last frame for us came from.
+    uint8_t sequence; /// The sequence number of our next frame.
+    uint16_t seen_sources[RF24_mesh_sources]; /// The sources we remember, 0xFFFF for none.
+    uint8_t seen_sequences[RF24_mesh_sources]; /// The sequence number of the last frame of every source.
+    uint8_t seen_next; /// The entry that is reused for the next new source.
+    RF24_mesh_counters mesh_counters; /// The counters.
+    
+    /// \brief
+    /// This will return true if a frame is the same as the last one of its source, and remember it otherwise.
+    bool seen(const uint16_t source, const uint8_t number);
+    
+    /// \brief
+    /// This will set the TX address and pipe 0 to a neighbour.
+    void select(const uint8_t hop);
+public:
+    /// \brief
+    /// A node at an address in the tree (see RF24_mesh_levels), in the network with a 2 byte id.
+    /// \details
+    /// An address is cut off at its first digit that is not 1 to RF24_mesh_children, address() tells what is left.
+    RF24_mesh(RF24 & radio, RF24_packet_handler & handler, const uint16_t address, const uint8_t* network);
+    
+    /// \brief
+    /// This will return our address.
+    uint16_t address() const;
+    
+    /// \brief
+    /// This will hand a frame to the handler or queue it to forward.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return the counters.
+    const RF24_mesh_counters & counters() const;
+    
+    /// \brief
+    /// This will return the hop a frame for a node goes to, or -1 if there is no route.
+    /// \details
+    /// RF24_mesh_parent is the parent, 1 to RF24_mesh_children are the children.
+    int next_hop(const uint16_t destination) const;
+    
+    /// \brief
+    /// This will return the number of frames that wait or are in flight.
+    int pending() const;
+    
+    /// \brief
+    /// This will put the pipe address that a node listens on with a pipe in address.
+    static void pipe_address(const uint16_t node, const uint8_t pipe, const uint8_t* network, uint8_t* address);
+    
+    /// \brief
+    /// This will send and forward what waits, and read what arrived, without waiting.
+    /// \details
+    /// Call it as often as possible. The radio is in TX mode while frames are sent, and listens otherwise.
+    void poll();
+    
+    /// \brief
+    /// This will return room in the queue for a frame, or nullptr if it is full.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will set all counters to zero.
+    void reset_counters();
+    
+    /// \brief
+    /// This will queue 0 to RF24_mesh_data bytes for a node.
+    /// \details
+    /// The data is copied. This will return '0' if the queue is full or there is no route.
+    bool send(const uint16_t destination, const uint8_t* data, const int bytes);
+    
+    /// \brief
+    /// This will set the time to wait after a failed try. The default is 1000 us.
+    /// \details
+    /// The wait grows with every try of a frame, and a little per node address. The next hop does not listen
+    /// while it forwards what it got, and the other nodes that send to it share its channel, so a node that
+    /// keeps retrying would only take the air from them.
+    void set_backoff(const uint16_t us);
+    
+    /// \brief
+    /// This will set the time a frame may wait for others before it is sent. The default is 500 us.
+    /// \details
+    /// Outside a TX stream, frames are sent when 3 of them wait, or when the oldest waited this long.
+    /// A relay then switches to TX and back once for a burst, instead of once for every frame.
+    void set_hold(const uint16_t us);
+    
+    /// \brief
+    /// This will set the number of times a frame is sent before it is dropped. The default is 3.
+    /// \details
+    /// Every time is a full round of retransmits of the radio, see RF24::set_retries().
+    void set_tries(const uint8_t times);
+    
+    /// \brief
+    /// This will return the node the frame that is being handled came from.
+    uint16_t source() const;
+    
+    /// \brief
+    /// This will set the pipes and start listening.
+    /// \details
+    /// The channel is that of the root, the same for every node of the network, see RF24_mesh_channel_step.
+    /// Auto acknowledge and dynamic payload are enabled on all pipes.
+    void start(const uint8_t channel);
+};
+
+#endif
@@ -0,0 +1,205 @@
+// ==========================================================================
+//
+// File      : RF24_message.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_message.cpp
+ */
+
+#include "RF24_message.hpp"
+
+RF24_message_sender::RF24_message_sender(RF24 & radio):
+    radio( radio ),
+    data( nullptr ),
+    length( 0 ),
+    fragments( 0 ),
+    next( 0 ),
+    acknowledged( 0 ),
+    id( 0 ),
+    in_flight_count( 0 ),
+    retransmit_count( 0 ),
+    failures( 0 ),
+    max_failures( 16 )
+{}
+
+uint16_t RF24_message_sender::fragments_acknowledged() const{
+    return acknowledged;
+}
+
+RF24_message_sender::state RF24_message_sender::poll(){
+    if (data == nullptr) return state::idle;
+    // Collect the results of the fragments in flight, they come in the order they were sent.
+    while (in_flight_count > 0){
+        const RF24::tx_result result = radio.poll();
+        if (result == RF24::tx_result::pending) break;
+        const uint16_t index = in_flight[0];
+        // Remove the oldest fragment from the window.
+        for (int i = 1; i < in_flight_count; i++){
+            in_flight[i - 1] = in_flight[i];
+        }
+        in_flight_count--;
+        if (result == RF24::tx_result::sent){
+            acknowledged++;
+            failures = 0;
+        }
+        // Failed, or forgotten by the radio (idle). Send it again later.
+        else {
+            retransmit[retransmit_count++] = index;
+            failures++;
+        }
+    }
+    if (acknowledged == fragments){
+        data = nullptr;
+        return state::done;
+    }
+    if (failures > max_failures && in_flight_count == 0){
+        data = nullptr;
+        return state::failed;
+    }
+    // Fill the TX FIFO, failed fragments first.
+    while (in_flight_count < 3){
+        if (retransmit_count > 0){
+            if (!this->send_fragment(retransmit[0])) break;
+            for (int i = 1; i < retransmit_count; i++){
+                retransmit[i - 1] = retransmit[i];
+            }
+            retransmit_count--;
+        }
+        else if (next < fragments){
+            if (!this->send_fragment(next)) break;
+            next++;
+        }
+        else break; // Everything has been sent.
+    }
+    return state::busy;
+}
+
+bool RF24_message_sender::send(const uint8_t* message, const uint32_t bytes){
+    if (!this->start(message, bytes)) return false;
+    state result = this->poll();
+    while (result == state::busy){
+        result = this->poll();
+    }
+    return result == state::done;
+}
+
+bool RF24_message_sender::send_fragment(const uint16_t index){
+    const uint32_t offset = uint32_t(index) * RF24_fragment_data; // Where the data of this fragment starts.
+    int bytes = RF24_fragment_data;
+    if (length - offset < uint32_t(bytes)) bytes = length - offset; // The last fragment can be shorter.
+    // Create the header.
+    frame[0] = id;
+    frame[1] = index & 0xFF;
+    frame[2] = index >> 8;
+    frame[3] = fragments & 0xFF;
+    frame[4] = fragments >> 8;
+    // Place the data behind it.
+    for (int i = 0; i < bytes; i++){
+        frame[RF24_fragment_header + i] = data[offset + i];
+    }
+    if (!radio.try_send(&*frame, RF24_fragment_header + bytes)) return false;
+    in_flight[in_flight_count++] = index;
+    return true;
+}
+
+void RF24_message_sender::set_max_failures(const uint16_t failures){
+    max_failures = failures;
+    return;
+}
+
+bool RF24_message_sender::start(const uint8_t* message, const uint32_t bytes){
+    if (data != nullptr) return false; // Still busy.
+    const uint32_t count = (bytes + RF24_fragment_data - 1) / RF24_fragment_data;
+    if (count == 0 || count > 0xFFFF) return false;
+    data = message;
+    length = bytes;
+    fragments = count;
+    next = 0;
+    acknowledged = 0;
+    in_flight_count = 0;
+    retransmit_count = 0;
+    failures = 0;
+    id++; // Every message gets a new id, so the receiver knows when a new one starts.
+    return true;
+}
+
+RF24_message_receiver::RF24_message_receiver(uint8_t* buffer, const uint32_t capacity, uint8_t* bitmap):
+    buffer( buffer ),
+    capacity( capacity ),
+    bitmap( bitmap ),
+    length( 0 ),
+    fragments( 0 ),
+    received( 0 ),
+    id( 0 ),
+    started( false ),
+    released( false )
+{}
+
+void RF24_message_receiver::commit(const uint8_t, const uint8_t bytes){
+    if (bytes < RF24_fragment_header + 1) return; // Not a fragment.
+    const uint8_t* fragment = &frame[1]; // The payload is behind the command byte.
+    const uint8_t fragment_id = fragment[0];
+    const uint16_t index = fragment[1] | (fragment[2] << 8);
+    const uint16_t count = fragment[3] | (fragment[4] << 8);
+    const int data_bytes = bytes - RF24_fragment_header;
+    if (count == 0 || index >= count) return; // Not part of any message, and must not throw away the one we have.
+    if (released && fragment_id == id) return; // A late duplicate of the message we already have.
+    // A fragment of another message starts a new one.
+    if (!started || fragment_id != id || count != fragments){
+        const uint32_t bitmap_bytes = (((capacity + RF24_fragment_data - 1) / RF24_fragment_data) + 7) / 8;
+        for (uint32_t i = 0; i < bitmap_bytes; i++){
+            bitmap[i] = 0;
+        }
+        id = fragment_id;
+        fragments = count;
+        received = 0;
+        length = 0;
+        started = true;
+        released = false;
+    }
+    const uint32_t offset = uint32_t(index) * RF24_fragment_data;
+    if (offset + data_bytes > capacity) return; // Does not fit.
+    if ((bitmap[index / 8] >> (index % 8)) & 1) return; // We already have it.
+    for (int i = 0; i < data_bytes; i++){
+        buffer[offset + i] = fragment[RF24_fragment_header + i];
+    }
+    bitmap[index / 8] |= (1 << (index % 8));
+    received++;
+    if (index == fragments - 1) length = offset + data_bytes; // The last fragment tells the length.
+    return;
+}
+
+bool RF24_message_receiver::complete() const{
+    return started && received == fragments;
+}
+
+const uint8_t* RF24_message_receiver::message() const{
+    return buffer;
+}
+
+uint32_t RF24_message_receiver::message_length() const{
+    return length;
+}
+
+void RF24_message_receiver::release(){
+    // Keep the id, so late duplicates of the fragments of this message are not taken for a new message.
+    started = false;
+    released = true;
+    return;
+}
+
+uint8_t* RF24_message_receiver::reserve(const uint8_t, const uint8_t){
+    if (this->complete()) return nullptr; // Leave the data in the RX FIFO until the message is released.
+    return frame;
+}
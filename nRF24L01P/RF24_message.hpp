@@ -0,0 +1,175 @@
+// ==========================================================================
+//
+// File      : RF24_message.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_message.hpp
+ */
+
+#ifndef RF24_MESSAGE_H
+#define RF24_MESSAGE_H
+
+#include "RF24.hpp"
+
+/// \brief
+/// Layout of a fragment.
+/// \details
+/// Every fragment starts with a 5 byte header:
+/// byte 0 is the message id, byte 1-2 the fragment index and byte 3-4 the number of fragments,
+/// both least significant byte first. The rest of the payload is message data.
+/// Every fragment but the last one carries RF24_fragment_data bytes of data.
+const int RF24_fragment_header = 5;
+const int RF24_fragment_data = 32 - RF24_fragment_header;
+
+/// \brief
+/// Sends messages of more than 32 bytes.
+/// \details
+/// A message is split in numbered fragments, which are streamed through the TX FIFO back to back with
+/// RF24::try_send(). The TX FIFO is the send window: up to three fragments are in flight.
+/// Enhanced ShockBurst acknowledges every fragment, so RF24::poll() tells which fragments arrived.
+/// Fragments that failed are sent again before any new fragment, so only the missing ones are retransmitted.
+/// The radio must be in a TX stream (RF24::start_tx_stream()) with auto acknowledge and dynamic payload enabled,
+/// and it must not be used for anything else while a message is sent.
+class RF24_message_sender {
+private:
+    RF24 & radio; /// The radio the fragments are sent with.
+    const uint8_t* data; /// The message being sent.
+    uint32_t length; /// Number of bytes in the message.
+    uint16_t fragments; /// Number of fragments of the message.
+    uint16_t next; /// Index of the next fragment that has not been sent yet.
+    uint16_t acknowledged; /// Number of fragments that arrived.
+    uint8_t id; /// Id of the message.
+    uint16_t in_flight[3]; /// Indexes of the fragments in the TX FIFO, oldest first.
+    uint8_t in_flight_count; /// Number of fragments in the TX FIFO.
+    uint16_t retransmit[3]; /// Indexes of the fragments that failed and must be sent again, oldest first.
+    uint8_t retransmit_count; /// Number of fragments that must be sent again.
+    uint16_t failures; /// Number of fragments that failed since the last one that arrived.
+    uint16_t max_failures; /// Number of failures in a row after which the message is given up.
+    uint8_t frame[32]; /// Will hold the fragment that is being sent.
+    
+    /// \brief
+    /// This will load one fragment in the TX FIFO, returns '0' if the TX FIFO is full.
+    bool send_fragment(const uint16_t index);
+public:
+    /// \brief
+    /// The state of the message.
+    enum class state {
+        idle, /// No message is being sent.
+        busy, /// Fragments are still in flight or must still be sent.
+        done, /// All fragments arrived.
+        failed /// Too many fragments failed in a row, the message is given up.
+    };
+    
+    RF24_message_sender(RF24 & radio);
+    
+    /// \brief
+    /// This will return the number of fragments that arrived.
+    uint16_t fragments_acknowledged() const;
+    
+    /// \brief
+    /// This will keep the message moving, without waiting.
+    /// \details
+    /// The results of the fragments in flight are collected, failed fragments are queued to be sent again,
+    /// and the TX FIFO is filled up with the fragments that must be sent.
+    /// Call it as often as possible until it returns something else than 'busy'.
+    state poll();
+    
+    /// \brief
+    /// This will send a message, and wait until it is done.
+    /// \details
+    /// Returns '1' if every fragment arrived.
+    bool send(const uint8_t* message, const uint32_t bytes);
+    
+    /// \brief
+    /// This will set the number of fragments that may fail in a row before the message is given up.
+    void set_max_failures(const uint16_t failures);
+    
+    /// \brief
+    /// This will start sending a message.
+    /// \details
+    /// The message is not copied, so it must stay valid until poll() returns 'done' or 'failed'.
+    /// Returns '0' if a message is still busy, or if the message needs more than 65535 fragments.
+    bool start(const uint8_t* message, const uint32_t bytes);
+};
+
+/// \brief
+/// Receives messages of more than 32 bytes.
+/// \details
+/// This is a packet sink for RF24::receive_burst() (or a queue of RF24_hub) that puts fragments back together.
+/// Fragments may arrive in any order and more than once, a bitmap keeps track of which ones are there.
+/// The buffer and bitmap are owned by the caller, RF24_message_buffer provides them.
+/// When a message is complete, no more packets are taken from the RX FIFO until release() is called.
+/// The RX FIFO then fills up and the chip stops acknowledging, so the sender waits instead of losing data.
+/// A fragment of a new message throws away an incomplete message.
+/// Fragments with the id of the message that was released last are taken for late duplicates and ignored.
+/// Fragments that do not fit in the buffer are dropped, so the message they belong to never completes.
+/// Fragments of a message of 0 fragments, or with an index past the number of fragments, are ignored.
+class RF24_message_receiver : public RF24_packet_sink {
+private:
+    uint8_t* buffer; /// Will hold the message, owned by the caller.
+    uint32_t capacity; /// Size of the buffer.
+    uint8_t* bitmap; /// One bit per fragment that arrived, owned by the caller.
+    uint32_t length; /// Number of bytes in the message, known when the last fragment arrived.
+    uint16_t fragments; /// Number of fragments of the message.
+    uint16_t received; /// Number of different fragments that arrived.
+    uint8_t id; /// Id of the message.
+    bool started; /// Holds if a fragment of the message has arrived.
+    bool released; /// Holds if the message with this id has been released.
+    uint8_t frame[33]; /// Will hold the fragment that is being read.
+public:
+    /// \brief
+    /// Creates a receiver that uses a caller owned buffer and bitmap.
+    /// \details
+    /// The bitmap must have one bit for every fragment that fits in the buffer.
+    RF24_message_receiver(uint8_t* buffer, const uint32_t capacity, uint8_t* bitmap);
+    
+    /// \brief
+    /// This will put a fragment in its place.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return true if a message is complete.
+    bool complete() const;
+    
+    /// \brief
+    /// This will return the message, it is valid until release() is called.
+    const uint8_t* message() const;
+    
+    /// \brief
+    /// This will return the number of bytes in the message.
+    uint32_t message_length() const;
+    
+    /// \brief
+    /// This will make the receiver ready for the next message.
+    void release();
+    
+    /// \brief
+    /// This will return storage for a fragment, or nullptr if a complete message has not been released yet.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+};
+
+/// \brief
+/// A message receiver with room for messages of up to N bytes.
+template<uint32_t N>
+class RF24_message_buffer : public RF24_message_receiver {
+private:
+    uint8_t storage[N]; /// Will hold the message.
+    uint8_t received_bitmap[(((N + RF24_fragment_data - 1) / RF24_fragment_data) + 7) / 8]; /// One bit per fragment.
+public:
+    RF24_message_buffer():
+        RF24_message_receiver( storage, N, received_bitmap )
+    {}
+};
+
+#endif
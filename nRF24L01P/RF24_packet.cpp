@@ -0,0 +1,70 @@
+// ==========================================================================
+//
+// File      : RF24_packet.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_packet.cpp
+ */
+
+#include "RF24_packet.hpp"
+
+RF24_packet_ring::RF24_packet_ring(RF24_packet_slot* slots, const int capacity):
+    slots( slots ),
+    capacity( capacity ),
+    head( 0 ),
+    count( 0 )
+{}
+
+void RF24_packet_ring::clear(){
+    head = 0;
+    count = 0;
+    return;
+}
+
+void RF24_packet_ring::commit(const uint8_t pipe, const uint8_t length){
+    RF24_packet_slot & slot = slots[(head + count) % capacity]; // The slot reserve() handed out.
+    slot.pipe = pipe;
+    slot.length = length;
+    count++;
+    return;
+}
+
+bool RF24_packet_ring::empty() const{
+    return count == 0;
+}
+
+RF24_packet_view RF24_packet_ring::front() const{
+    const RF24_packet_slot & slot = slots[head];
+    return RF24_packet_view{ &slot.frame[1], slot.length, slot.pipe }; // The payload is behind the command byte.
+}
+
+bool RF24_packet_ring::full() const{
+    return count == capacity;
+}
+
+void RF24_packet_ring::pop(){
+    if (count == 0) return;
+    head = (head + 1) % capacity;
+    count--;
+    return;
+}
+
+uint8_t* RF24_packet_ring::reserve(const uint8_t, const uint8_t length){
+    if (this->full() || length > 32) return nullptr; // No room.
+    return slots[(head + count) % capacity].frame; // The next free slot.
+}
+
+int RF24_packet_ring::size() const{
+    return count;
+}
@@ -0,0 +1,148 @@
+// ==========================================================================
+//
+// File      : RF24_packet.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_packet.hpp
+ */
+
+#ifndef RF24_PACKET_H
+#define RF24_PACKET_H
+
+#include "hwlib.hpp"
+
+/// \brief
+/// A received packet.
+/// \details
+/// This does not own the data, it points to the place where the packet is stored.
+/// It stays valid until the packet is removed from where it is stored.
+struct RF24_packet_view {
+    const uint8_t* data; /// The payload.
+    uint8_t length; /// Number of bytes in the payload, 1-32.
+    uint8_t pipe; /// The data pipe the packet was received on, 0-5.
+};
+
+/// \brief
+/// A piece of a payload that is sent.
+/// \details
+/// This does not own the data. RF24::try_send() takes a list of spans and sends them as one payload,
+/// so a header and a body can be sent from where they are, without building the payload in a buffer first.
+struct RF24_span {
+    const uint8_t* data; /// The bytes.
+    uint8_t length; /// Number of bytes, may be 0.
+};
+
+/// \brief
+/// Something that handles received packets one by one.
+class RF24_packet_handler {
+public:
+    /// \brief
+    /// This will handle a packet.
+    /// \details
+    /// The view is only valid during this call.
+    virtual void handle(const RF24_packet_view & packet) = 0;
+};
+
+/// \brief
+/// Something that can store received packets.
+/// \details
+/// RF24::receive_burst() reads packets from the RX FIFO straight into a sink, without copying them.
+/// For every packet it first asks the sink for storage, then reads the payload into it and commits it.
+class RF24_packet_sink {
+public:
+    /// \brief
+    /// This will return storage for a packet, or nullptr if there is no room.
+    /// \details
+    /// The storage must have room for length + 1 bytes.
+    /// The first byte is used for the SPI command, the payload is written behind it.
+    /// If nullptr is returned, the packet stays in the RX FIFO.
+    virtual uint8_t* reserve(const uint8_t pipe, const uint8_t length) = 0;
+    
+    /// \brief
+    /// This will store the packet that was written to the storage returned by the last reserve().
+    virtual void commit(const uint8_t pipe, const uint8_t length) = 0;
+};
+
+/// \brief
+/// One place in an RF24_packet_ring.
+struct RF24_packet_slot {
+    uint8_t length; /// Number of bytes in the payload.
+    uint8_t pipe; /// The data pipe the packet was received on.
+    uint8_t frame[33]; /// The SPI command byte followed by the payload.
+};
+
+/// \brief
+/// A ring buffer of received packets.
+/// \details
+/// The slots are owned by the caller, so the number of packets that can be stored is chosen by the application.
+/// Packets are read with front(), which returns a view to the packet in its slot, and removed with pop().
+/// When the ring is full, RF24::receive_burst() leaves packets in the RX FIFO.
+class RF24_packet_ring : public RF24_packet_sink {
+private:
+    RF24_packet_slot* slots; /// The slots, owned by the caller.
+    int capacity; /// Number of slots.
+    int head; /// Index of the oldest packet.
+    int count; /// Number of packets stored.
+public:
+    RF24_packet_ring(RF24_packet_slot* slots, const int capacity);
+    
+    /// \brief
+    /// This will remove all packets.
+    void clear();
+    
+    /// \brief
+    /// This will store the packet that was reserved last.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return true if there are no packets stored.
+    bool empty() const;
+    
+    /// \brief
+    /// This will return a view to the oldest packet.
+    /// \details
+    /// The view stays valid until pop() is called for the packet.
+    /// Must not be called when the ring is empty.
+    RF24_packet_view front() const;
+    
+    /// \brief
+    /// This will return true if all slots are used.
+    bool full() const;
+    
+    /// \brief
+    /// This will remove the oldest packet.
+    void pop();
+    
+    /// \brief
+    /// This will return storage for a new packet, or nullptr if the ring is full.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return the number of packets stored.
+    int size() const;
+};
+
+/// \brief
+/// A ring buffer of received packets, with room for N packets.
+template<int N>
+class RF24_packet_ring_buffer : public RF24_packet_ring {
+private:
+    RF24_packet_slot storage[N]; /// The slots.
+public:
+    RF24_packet_ring_buffer():
+        RF24_packet_ring( storage, N )
+    {}
+};
+
+#endif
@@ -0,0 +1,129 @@
+// ==========================================================================
+//
+// File      : RF24_retry.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_retry.cpp
+ */
+
+#include "RF24_retry.hpp"
+
+uint32_t RF24_airtime_us(const RF24_data_rate rate, const int address_width, const int crc_bytes, const int payload){
+    const uint32_t bits = 8 * (1 + address_width + payload + crc_bytes) + 9;
+    uint32_t ns_per_bit = 1000;
+    if (rate == RF24_data_rate::rate_250kbps) ns_per_bit = 4000;
+    else if (rate == RF24_data_rate::rate_2mbps) ns_per_bit = 500;
+    return (bits * ns_per_bit + 999) / 1000;
+}
+
+int RF24_min_retry_delay(const RF24_data_rate rate, const int address_width, const int crc_bytes, const int ack_payload){
+    const int needed = 130 + RF24_airtime_us(rate, address_width, crc_bytes, ack_payload); // Settling of the PRX, then the acknowledge.
+    const int delay = ((needed + 249) / 250) * 250;
+    return (delay > 4000) ? 4000 : delay;
+}
+
+RF24_retry_tuner::RF24_retry_tuner(RF24 & radio, const uint16_t target):
+    radio( radio ),
+    target( (target > 1000) ? 1000 : target ),
+    window( 32 ),
+    min_count( 1 ),
+    max_count( 15 ),
+    ack_payload( 0 ),
+    retries( 3 ),
+    delay_us( 250 ),
+    acked_start( 0 ),
+    failed_start( 0 ),
+    retransmits_start( 0 ),
+    average_miss( 0 )
+{}
+
+bool RF24_retry_tuner::adapt(){
+    const RF24_statistics stats = radio.statistics();
+    const uint32_t acked = stats.tx_acked - acked_start;
+    const uint32_t failed = stats.tx_failed - failed_start;
+    if (acked + failed < window) return false;
+    // Every packet is sent once, every retransmit is one more attempt. One extra failed attempt
+    // keeps a window without losses from looking perfect.
+    const uint32_t attempts = acked + failed + (stats.retransmits - retransmits_start) + 1;
+    this->start_window();
+    
+    // Chance an attempt fails, per million. It is averaged over the windows, one window is too short for a good estimate.
+    const uint32_t window_miss = ((uint64_t)(attempts - acked) * 1000000) / attempts;
+    average_miss = (average_miss == 0) ? window_miss : (3 * average_miss + window_miss) / 4;
+    const uint64_t miss = average_miss;
+    const uint64_t allowed = (uint64_t)(1000 - target) * 1000; // Chance a packet may fail, per million.
+    uint64_t all_missed = miss; // Chance that count + 1 attempts fail, per million.
+    int needed = 0;
+    while (all_missed > allowed && needed < max_count){
+        all_missed = (all_missed * miss) / 1000000;
+        needed++;
+    }
+    if (needed < min_count) needed = min_count;
+    if (needed == retries) return false;
+    retries = needed;
+    radio.set_retries(delay_us, retries);
+    return true;
+}
+
+int RF24_retry_tuner::count() const{
+    return retries;
+}
+
+int RF24_retry_tuner::delay() const{
+    return delay_us;
+}
+
+void RF24_retry_tuner::retune(){
+    const uint8_t setup = radio.read_register(RF_SETUP);
+    RF24_data_rate rate = RF24_data_rate::rate_1mbps;
+    if ((setup >> RF_DR_LOW) & 1) rate = RF24_data_rate::rate_250kbps;
+    else if ((setup >> RF_DR_HIGH) & 1) rate = RF24_data_rate::rate_2mbps;
+    const int address_width = (radio.read_register(SETUP_AW) & 0x03) + 2;
+    // Auto acknowledge forces the CRC on, CRCO still picks its width.
+    const uint8_t config = radio.read_register(NRF_CONFIG);
+    int crc_bytes = 0;
+    if (((config >> EN_CRC) & 1) || radio.read_register(EN_AA) != 0) crc_bytes = ((config >> CRCO) & 1) ? 2 : 1;
+    delay_us = RF24_min_retry_delay(rate, address_width, crc_bytes, ack_payload);
+    radio.set_retries(delay_us, retries);
+    return;
+}
+
+void RF24_retry_tuner::set_limits(const uint16_t window, const uint8_t min_count, const uint8_t max_count){
+    this->window = (window == 0) ? 1 : window;
+    this->max_count = (max_count > 15) ? 15 : max_count;
+    this->min_count = (min_count > this->max_count) ? this->max_count : min_count;
+    return;
+}
+
+void RF24_retry_tuner::set_target(const uint16_t target){
+    this->target = (target > 1000) ? 1000 : target;
+    return;
+}
+
+void RF24_retry_tuner::start(const int ack_payload, const int count){
+    this->ack_payload = (ack_payload < 0) ? 0 : ((ack_payload > 32) ? 32 : ack_payload);
+    retries = (count < min_count) ? min_count : ((count > max_count) ? max_count : count);
+    radio.enable_tx_observation(true);
+    this->retune();
+    this->start_window();
+    return;
+}
+
+void RF24_retry_tuner::start_window(){
+    const RF24_statistics stats = radio.statistics();
+    acked_start = stats.tx_acked;
+    failed_start = stats.tx_failed;
+    retransmits_start = stats.retransmits;
+    return;
+}
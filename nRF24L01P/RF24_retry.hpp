@@ -0,0 +1,110 @@
+// ==========================================================================
+//
+// File      : RF24_retry.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_retry.hpp
+ */
+
+#ifndef RF24_RETRY_H
+#define RF24_RETRY_H
+
+#include "RF24.hpp"
+
+/// \brief
+/// This will return the time in microseconds a packet is on the air, rounded up.
+/// \details
+/// A packet is a preamble byte, the address, 9 bits of packet control field, the payload and the CRC.
+uint32_t RF24_airtime_us(const RF24_data_rate rate, const int address_width, const int crc_bytes, const int payload);
+
+/// \brief
+/// This will return the shortest auto retransmit delay in microseconds that lets an acknowledge arrive.
+/// \details
+/// The delay counts from the end of a transmission, so the payload that was sent does not matter.
+/// In that time the PRX switches to TX (130 us) and sends the acknowledge with its ACK payload.
+/// The result is rounded up to a step of 250 us. For 250 kbps without ACK payload it is 500 us, like the datasheet says.
+int RF24_min_retry_delay(const RF24_data_rate rate, const int address_width, const int crc_bytes, const int ack_payload);
+
+/// \brief
+/// Sets SETUP_RETR of a PTX from its configuration and from the retransmits it sees.
+/// \details
+/// The delay is the shortest that lets the largest ACK payload arrive at the data rate, address width and CRC
+/// the chip is set to, so no retransmit is wasted on an acknowledge that was still on its way.
+/// The count is adapted after every window of packets. From the packets that were acknowledged, failed and
+/// retransmitted (RF24::statistics()) the tuner estimates the chance that one attempt fails, and picks the
+/// lowest count that still delivers the target share of packets. A lower count gives up sooner on a packet
+/// that will not arrive anyway, so the packets behind it wait less.
+/// The retransmit count of the chip is read once per TX_DS or MAX_RT, so when several packets finish at once
+/// some retransmits are missed. The estimate is made a little worse on purpose, so a window without losses
+/// does not lead to a count of 0.
+/// Auto acknowledge must be enabled. Call retune() when the data rate, address width or CRC change.
+class RF24_retry_tuner {
+private:
+    RF24 & radio; /// The radio of the PTX.
+    uint16_t target; /// Packets per 1000 that must be delivered.
+    uint16_t window; /// Number of packets in a window.
+    uint8_t min_count; /// Lowest retransmit count.
+    uint8_t max_count; /// Highest retransmit count.
+    uint8_t ack_payload; /// Largest ACK payload in bytes.
+    uint8_t retries; /// Retransmit count in use.
+    int delay_us; /// Retransmit delay in use.
+    uint32_t acked_start; /// RF24_statistics::tx_acked at the start of this window.
+    uint32_t failed_start; /// RF24_statistics::tx_failed at the start of this window.
+    uint32_t retransmits_start; /// RF24_statistics::retransmits at the start of this window.
+    uint32_t average_miss; /// Average chance that an attempt fails, per million, or 0 before the first window.
+    
+    /// \brief
+    /// This will start a new window.
+    void start_window();
+public:
+    /// \brief
+    /// The target is the number of packets per 1000 that must be delivered.
+    RF24_retry_tuner(RF24 & radio, const uint16_t target = 990);
+    
+    /// \brief
+    /// This will set a new retransmit count if a window is complete, and return true if it changed.
+    /// \details
+    /// This can be called after every packet, it only reads the statistics of the radio until a window is complete.
+    bool adapt();
+    
+    /// \brief
+    /// This will return the retransmit count in use.
+    int count() const;
+    
+    /// \brief
+    /// This will return the retransmit delay in use, in microseconds.
+    int delay() const;
+    
+    /// \brief
+    /// This will read the data rate, address width and CRC of the chip and set the shortest retransmit delay for them.
+    void retune();
+    
+    /// \brief
+    /// This will set the size of a window and the range of the retransmit count.
+    /// \details
+    /// The defaults are a window of 32 packets and a count of 1-15.
+    void set_limits(const uint16_t window, const uint8_t min_count, const uint8_t max_count);
+    
+    /// \brief
+    /// This will set the delivery target, in packets per 1000.
+    void set_target(const uint16_t target);
+    
+    /// \brief
+    /// This will set the retransmit delay and count, and enable the observation of retransmits.
+    /// \details
+    /// The ACK payload is the largest ACK payload the PRX sends back, or 0 if it sends none.
+    void start(const int ack_payload = 0, const int count = 3);
+};
+
+#endif
@@ -0,0 +1,84 @@
+// ==========================================================================
+//
+// File      : RF24_scan.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_scan.cpp
+ */
+
+#include "RF24_scan.hpp"
+
+RF24_channel_scanner::RF24_channel_scanner(RF24 & radio, const uint8_t first, const uint8_t last):
+    radio( radio ),
+    sweeps( 0 ),
+    first( (first < RF24_channels) ? first : RF24_channels - 1 ),
+    last( (last < RF24_channels) ? last : RF24_channels - 1 )
+{
+    if (this->last < this->first) this->last = this->first;
+    this->clear();
+}
+
+void RF24_channel_scanner::clear(){
+    for (int channel = 0; channel < RF24_channels; channel++){
+        counts[channel] = 0;
+    }
+    sweeps = 0;
+    return;
+}
+
+int RF24_channel_scanner::occupancy(const int channel) const{
+    if (channel < 0 || channel >= RF24_channels || sweeps == 0) return 0;
+    return (counts[channel] * 1000) / sweeps;
+}
+
+int RF24_channel_scanner::quietest(const int spread) const{
+    int best = first;
+    uint32_t best_sum = 0xFFFFFFFF;
+    for (int channel = first; channel <= last; channel++){
+        uint32_t sum = 0;
+        for (int neighbour = channel - spread; neighbour <= channel + spread; neighbour++){
+            if (neighbour >= 0 && neighbour < RF24_channels) sum += counts[neighbour];
+        }
+        if (sum < best_sum){
+            best = channel;
+            best_sum = sum;
+        }
+    }
+    return best;
+}
+
+int RF24_channel_scanner::samples() const{
+    return sweeps;
+}
+
+void RF24_channel_scanner::sweep(const int times){
+    const uint8_t config = radio.read_register(NRF_CONFIG);
+    const uint8_t channel = radio.read_register(RF_CH);
+    radio.set_ce(0);
+    radio.write_register(NRF_CONFIG, config | (1 << PRIM_RX) | (1 << PWR_UP)); // Listen.
+    radio.wait_ready(); // Only waits if the chip was powered down.
+    for (int i = 0; i < times && sweeps < 0xFFFF; i++){
+        for (int ch = first; ch <= last; ch++){
+            radio.set_channel(ch);
+            radio.set_ce(1);
+            radio.wait_us(170); // RPD needs 170 us in RX mode.
+            if (radio.received_power()) counts[ch]++;
+            radio.set_ce(0);
+        }
+        sweeps++;
+    }
+    radio.set_channel(channel);
+    radio.write_register(NRF_CONFIG, config);
+    return;
+}
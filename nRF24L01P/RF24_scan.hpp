@@ -0,0 +1,77 @@
+// ==========================================================================
+//
+// File      : RF24_scan.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_scan.hpp
+ */
+
+#ifndef RF24_SCAN_H
+#define RF24_SCAN_H
+
+#include "RF24.hpp"
+
+/// \brief
+/// Number of channels of the nRF24L01+, 2400 to 2525 MHz.
+const int RF24_channels = 126;
+
+/// \brief
+/// Finds the quietest channel with the received power detector (RPD).
+/// \details
+/// A sweep listens on every channel for 170 us, the time RPD needs, and counts the samples in which
+/// a carrier above -64 dBm was seen. Several sweeps build a histogram of the occupancy of every channel.
+/// Channels are visited one after the other within a sweep, so a burst of Wi-Fi traffic hits a few samples
+/// of many channels instead of all samples of one channel.
+/// A Wi-Fi channel is 22 MHz wide, so quietest() also looks at the neighbours of a channel.
+/// To move a link to the channel that was found, see RF24_link_adapter::move().
+class RF24_channel_scanner {
+private:
+    RF24 & radio; /// The radio that listens.
+    uint16_t counts[RF24_channels]; /// Number of samples per channel in which a carrier was seen.
+    uint16_t sweeps; /// Number of samples per channel.
+    uint8_t first; /// The first channel that is scanned.
+    uint8_t last; /// The last channel that is scanned.
+public:
+    /// \brief
+    /// Only channels first to last are scanned and picked, for example to stay within the rules of a country.
+    RF24_channel_scanner(RF24 & radio, const uint8_t first = 0, const uint8_t last = RF24_channels - 1);
+    
+    /// \brief
+    /// This will forget all samples.
+    void clear();
+    
+    /// \brief
+    /// This will return the share of samples in which a carrier was seen on a channel, per 1000.
+    int occupancy(const int channel) const;
+    
+    /// \brief
+    /// This will return the scanned channel with the least carrier on it and its neighbours.
+    /// \details
+    /// The samples of the channels up to spread away are added. With no samples, this returns first.
+    int quietest(const int spread = 2) const;
+    
+    /// \brief
+    /// This will return the number of samples per channel.
+    int samples() const;
+    
+    /// \brief
+    /// This will sweep the channels a number of times.
+    /// \details
+    /// The chip listens in RX mode, so nothing else can be done with it in the meantime.
+    /// CONFIG and the channel are set back afterwards, CE is low. A PRX must set CE high again,
+    /// a PTX in a TX stream must start it again.
+    void sweep(const int times = 1);
+};
+
+#endif
@@ -0,0 +1,178 @@
+// ==========================================================================
+//
+// File      : RF24_spi.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_spi.cpp
+ */
+
+#include "RF24_spi.hpp"
+
+/// \brief
+/// A select pin that does nothing, used while CSN is held low by hand.
+class RF24_no_pin : public hwlib::pin_out {
+public:
+    void set(bool, hwlib::buffering) override {}
+};
+
+RF24_hwlib_spi::RF24_hwlib_spi(hwlib::spi_bus & SPI, hwlib::pin_out & CSN):
+    SPI( SPI ),
+    CSN( CSN )
+{}
+
+void RF24_hwlib_spi::run(RF24_spi_segment* segments, const int count){
+    static RF24_no_pin no_pin;
+    int i = 0;
+    while (i < count){
+        if (segments[i].last){
+            // A frame of one segment, the bus does CSN.
+            SPI.write_and_read( CSN, segments[i].length, segments[i].out, segments[i].in );
+            i++;
+            continue;
+        }
+        CSN.set(0);
+        while (i < count){
+            const RF24_spi_segment & segment = segments[i++];
+            SPI.write_and_read( no_pin, segment.length, segment.out, segment.in );
+            if (segment.last) break;
+        }
+        CSN.set(1);
+    }
+    return;
+}
+
+RF24_spi_queue::RF24_spi_queue():
+    count( 0 ),
+    used( 0 )
+{}
+
+uint8_t* RF24_spi_queue::add(const uint8_t length, const bool last){
+    if (count == RF24_spi_queue_segments || used + length > RF24_spi_queue_bytes) return nullptr;
+    uint8_t* data = &pool[used];
+    used += length;
+    segments[count++] = RF24_spi_segment{ data, data, length, last };
+    return data;
+}
+
+bool RF24_spi_queue::add(uint8_t* data, const uint8_t length, const bool last){
+    return this->add(data, data, length, last);
+}
+
+bool RF24_spi_queue::add(const uint8_t* out, uint8_t* in, const uint8_t length, const bool last){
+    if (count == RF24_spi_queue_segments) return false;
+    segments[count++] = RF24_spi_segment{ out, in, length, last };
+    return true;
+}
+
+bool RF24_spi_queue::empty() const{
+    return count == 0;
+}
+
+int RF24_spi_queue::frames() const{
+    int frames = 0;
+    for (int i = 0; i < count; i++){
+        if (segments[i].last) frames++;
+    }
+    return frames;
+}
+
+uint8_t RF24_spi_queue::run(RF24_spi_backend & backend){
+    if (count == 0) return 0;
+    backend.run(&*segments, count);
+    // The status is the first byte of the last frame.
+    int first = count - 1;
+    while (first > 0 && !segments[first - 1].last) first--;
+    const uint8_t status = (segments[first].in != nullptr) ? segments[first].in[0] : 0;
+    count = 0;
+    used = 0;
+    return status;
+}
+
+RF24_spi_recorder::RF24_spi_recorder(RF24_spi_record* records, const int capacity, RF24_spi_backend* forward):
+    records( records ),
+    capacity( capacity ),
+    count( 0 ),
+    batch_count( 0 ),
+    framing_error( false ),
+    forward( forward )
+{}
+
+int RF24_spi_recorder::batches() const{
+    return batch_count;
+}
+
+void RF24_spi_recorder::clear(){
+    count = 0;
+    batch_count = 0;
+    framing_error = false;
+    return;
+}
+
+const RF24_spi_record & RF24_spi_recorder::frame(const int index) const{
+    return records[index];
+}
+
+int RF24_spi_recorder::frames() const{
+    return count;
+}
+
+bool RF24_spi_recorder::framing_ok() const{
+    return !framing_error;
+}
+
+bool RF24_spi_recorder::matches(const int index, const uint8_t* bytes, const int length) const{
+    if (index >= count || index >= capacity || records[index].length != length) return false;
+    for (int i = 0; i < length && i < RF24_spi_frame_bytes; i++){
+        if (records[index].data[i] != bytes[i]) return false;
+    }
+    return true;
+}
+
+void RF24_spi_recorder::run(RF24_spi_segment* segments, const int segment_count){
+    if (segment_count == 0 || !segments[segment_count - 1].last) framing_error = true; // CSN would stay low.
+    int length = 0; // Bytes in the frame so far.
+    for (int i = 0; i < segment_count; i++){
+        const RF24_spi_segment & segment = segments[i];
+        if (segment.length == 0) framing_error = true;
+        for (int j = 0; j < segment.length; j++){
+            const uint8_t sent = (segment.out != nullptr) ? segment.out[j] : 0;
+            if (count < capacity && length < RF24_spi_frame_bytes) records[count].data[length] = sent;
+            length++;
+        }
+        if (segment.last || i == segment_count - 1){
+            if (length > RF24_spi_frame_bytes) framing_error = true;
+            if (count < capacity){
+                records[count].length = (uint8_t)(length > 255 ? 255 : length);
+                records[count].batch = batch_count;
+            }
+            count++;
+            length = 0;
+        }
+    }
+    batch_count++;
+    if (forward != nullptr){
+        forward->run(segments, segment_count);
+        return;
+    }
+    // Answer like a chip that just powered up.
+    bool first = true;
+    for (int i = 0; i < segment_count; i++){
+        for (int j = 0; j < segments[i].length; j++){
+            if (segments[i].in != nullptr) segments[i].in[j] = first ? 0x0E : 0x00;
+            first = false;
+        }
+        if (segments[i].last) first = true;
+    }
+    return;
+}
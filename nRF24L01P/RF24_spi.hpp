@@ -0,0 +1,208 @@
+// ==========================================================================
+//
+// File      : RF24_spi.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_spi.hpp
+ */
+
+#ifndef RF24_SPI_H
+#define RF24_SPI_H
+
+#include "hwlib.hpp"
+
+/// \brief
+/// The longest SPI frame of an nRF24L01+: a command byte followed by a 32 byte payload.
+const int RF24_spi_frame_bytes = 33;
+
+/// \brief
+/// Number of segments an RF24_spi_queue can hold.
+const int RF24_spi_queue_segments = 24;
+
+/// \brief
+/// Number of bytes an RF24_spi_queue can store for the segments that are stored in the queue.
+const int RF24_spi_queue_bytes = 192;
+
+static_assert(RF24_spi_frame_bytes <= RF24_spi_queue_bytes, "RF24_spi_queue: a frame that is put together must fit in the pool");
+
+/// \brief
+/// A part of an SPI frame.
+/// \details
+/// The bytes in out are sent to the chip, the bytes the chip sends back are stored in in.
+/// Both may point to the same bytes, then the answer replaces what was sent.
+/// A frame is one or more segments between CSN low and CSN high, the last segment of a frame has last set.
+/// With more segments, a command and its payload can be sent from different places in memory,
+/// and a payload can be read into a buffer of its own.
+struct RF24_spi_segment {
+    const uint8_t* out; /// The bytes to send, or nullptr to send zeroes.
+    uint8_t* in; /// Where the answer of the chip is stored, or nullptr if it is not needed.
+    uint8_t length; /// Number of bytes.
+    bool last; /// Holds if CSN goes high after this segment.
+};
+
+/// \brief
+/// Something that runs SPI transactions with an nRF24L01+.
+/// \details
+/// A backend gets a batch of frames at once and runs them back-to-back, in order.
+/// The bit-banged bus of hwlib needs the CPU for every bit, but a backend for an SPI peripheral with DMA
+/// can chain the segments of a batch and only needs the CPU again when the batch is done.
+class RF24_spi_backend {
+public:
+    /// \brief
+    /// This will run a batch of segments and return when all of them are done.
+    /// \details
+    /// CSN goes low before the first segment of a frame and high after its last segment.
+    /// The segment at count - 1 must have last set.
+    virtual void run(RF24_spi_segment* segments, const int count) = 0;
+};
+
+/// \brief
+/// The backend that runs frames on an hwlib::spi_bus.
+/// \details
+/// A frame of one segment is one write_and_read() call. For a frame of more segments CSN is set low by hand,
+/// and the segments are sent with write_and_read() on a dummy select pin, so CSN stays low in between.
+class RF24_hwlib_spi : public RF24_spi_backend {
+private:
+    hwlib::spi_bus & SPI; /// SPI bus.
+    hwlib::pin_out & CSN; /// SPI Chip select.
+public:
+    RF24_hwlib_spi(hwlib::spi_bus & SPI, hwlib::pin_out & CSN);
+    
+    /// \brief
+    /// This will run a batch of segments on the bus.
+    void run(RF24_spi_segment* segments, const int count) override;
+};
+
+/// \brief
+/// A queue of SPI transactions that are run as one batch.
+/// \details
+/// Bytes added with add(const uint8_t, const bool) are stored in the queue itself, so the caller can reuse its buffer.
+/// Bytes added with add(uint8_t*, const uint8_t, const bool) stay where they are, and get the answer of the chip
+/// when the queue is run. add(const uint8_t*, uint8_t*, const uint8_t, const bool) sends from one place and
+/// stores the answer in another.
+class RF24_spi_queue {
+private:
+    RF24_spi_segment segments[RF24_spi_queue_segments]; /// The queued segments, in order.
+    uint8_t pool[RF24_spi_queue_bytes]; /// Storage for the bytes of segments that are stored in the queue.
+    int count; /// Number of queued segments.
+    int used; /// Number of bytes of the pool that are in use.
+public:
+    RF24_spi_queue();
+    
+    /// \brief
+    /// This will queue a segment that is stored in the queue, and return where the bytes must be written.
+    /// \details
+    /// This will return nullptr if there is no room.
+    uint8_t* add(const uint8_t length, const bool last = true);
+    
+    /// \brief
+    /// This will queue a segment that is stored by the caller.
+    /// \details
+    /// The data must stay valid until the queue is run. This will return false if there is no room.
+    bool add(uint8_t* data, const uint8_t length, const bool last = true);
+    
+    /// \brief
+    /// This will queue a segment that is sent from out, with the answer stored in in.
+    /// \details
+    /// Either may be nullptr, see RF24_spi_segment. Both must stay valid until the queue is run.
+    /// This will return false if there is no room.
+    bool add(const uint8_t* out, uint8_t* in, const uint8_t length, const bool last = true);
+    
+    /// \brief
+    /// This will return true if nothing is queued.
+    bool empty() const;
+    
+    /// \brief
+    /// This will return the number of queued frames.
+    int frames() const;
+    
+    /// \brief
+    /// This will run everything that is queued as one batch, and empty the queue.
+    /// \details
+    /// This will return the status register the chip sent back in the last frame, or 0 if nothing was queued
+    /// or the answer to the first segment of that frame was not stored.
+    uint8_t run(RF24_spi_backend & backend);
+};
+
+/// \brief
+/// One frame as seen by an RF24_spi_recorder.
+struct RF24_spi_record {
+    uint8_t data[RF24_spi_frame_bytes]; /// The first 33 bytes that were sent. No nRF24L01+ command is longer.
+    uint8_t length; /// Number of bytes in the frame.
+    uint16_t batch; /// Number of the batch the frame was in, starting at 0.
+};
+
+/// \brief
+/// A backend that records every frame, to check what a driver does on the host.
+/// \details
+/// Frames are recorded with the bytes that were sent, before the answer of the chip replaced them.
+/// The recorder checks the CSN framing: no empty segments, no frames longer than 33 bytes,
+/// and every batch ends with CSN high.
+/// If a backend is given the batch is passed on to it, so the recorder can sit in front of a simulated
+/// or real chip. Without one, the recorder answers like a chip that just powered up: a status of 0x0E, then zeroes.
+/// A segment without out is recorded as zeroes, as that is what goes over the bus.
+/// The records are owned by the caller, see RF24_spi_recording.
+class RF24_spi_recorder : public RF24_spi_backend {
+private:
+    RF24_spi_record* records; /// The recorded frames.
+    int capacity; /// Number of frames that can be recorded.
+    int count; /// Number of frames that have been run, also those that did not fit.
+    uint16_t batch_count; /// Number of batches.
+    bool framing_error; /// Holds if a batch was not framed correctly.
+    RF24_spi_backend* forward; /// The backend that runs the batches, or nullptr.
+public:
+    RF24_spi_recorder(RF24_spi_record* records, const int capacity, RF24_spi_backend* forward = nullptr);
+    
+    /// \brief
+    /// This will return the number of batches that were run.
+    int batches() const;
+    
+    /// \brief
+    /// This will forget everything that was recorded.
+    void clear();
+    
+    /// \brief
+    /// This will return a recorded frame. Only the first capacity frames are recorded.
+    const RF24_spi_record & frame(const int index) const;
+    
+    /// \brief
+    /// This will return the number of frames that were run.
+    int frames() const;
+    
+    /// \brief
+    /// This will return true if every batch so far was framed correctly.
+    bool framing_ok() const;
+    
+    /// \brief
+    /// This will return true if the frame at index was recorded and sent exactly these bytes.
+    bool matches(const int index, const uint8_t* bytes, const int length) const;
+    
+    /// \brief
+    /// This will record a batch, and pass it on.
+    void run(RF24_spi_segment* segments, const int count) override;
+};
+
+/// \brief
+/// An RF24_spi_recorder with room for N frames.
+template<int N>
+class RF24_spi_recording : public RF24_spi_recorder {
+private:
+    RF24_spi_record storage[N]; /// The recorded frames.
+public:
+    RF24_spi_recording(RF24_spi_backend* forward = nullptr):
+        RF24_spi_recorder( &*storage, N, forward )
+    {}
+};
+
+#endif
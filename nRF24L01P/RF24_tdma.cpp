@@ -0,0 +1,316 @@
+// ==========================================================================
+//
+// File      : RF24_tdma.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_tdma.cpp
+ */
+
+#include "RF24_tdma.hpp"
+
+RF24_tdma_hub::RF24_tdma_hub(RF24 & radio, RF24_packet_handler & handler, const uint8_t nodes, const uint8_t slots,
+                             const uint16_t slot_us, const uint16_t beacon_us):
+    radio( radio ),
+    handler( handler ),
+    nodes( (nodes < 1) ? 1 : ((nodes > RF24_tdma_max_nodes) ? RF24_tdma_max_nodes : nodes) ),
+    slots( slots ),
+    slot_us( slot_us ),
+    beacon_us( beacon_us ),
+    packet_us( 500 ),
+    frame_number( 0 ),
+    next_beacon( 0 ),
+    beaconing( false ),
+    last_sender( 0 )
+{
+    if (this->slots < this->nodes) this->slots = this->nodes;
+    if (this->slots > RF24_tdma_max_slots) this->slots = RF24_tdma_max_slots;
+    for (int i = 0; i < RF24_tdma_max_nodes; i++){
+        depth[i] = 0;
+        last_sequence[i] = 0xFF;
+    }
+    this->assign();
+}
+
+void RF24_tdma_hub::assign(){
+    // Every node keeps one slot. The other slots go one by one to the node that needs the most slots
+    // for what it has waiting, or in turns when nobody needs more.
+    const int per_slot = (slot_us / packet_us > 0) ? slot_us / packet_us : 1;
+    uint8_t given[RF24_tdma_max_nodes];
+    for (int n = 0; n < nodes; n++){
+        given[n] = 1;
+    }
+    for (int extra = nodes; extra < slots; extra++){
+        int best = extra % nodes;
+        int best_need = 0;
+        for (int n = 0; n < nodes; n++){
+            const int need = (depth[n] + per_slot) / per_slot - given[n]; // The frame with the report counts too.
+            if (need > best_need){
+                best = n;
+                best_need = need;
+            }
+        }
+        given[best]++;
+    }
+    // Spread the slots of a node over the frame, so it does not wait a whole frame between them.
+    int slot = 0;
+    for (int round = 0; slot < slots; round++){
+        for (int n = 0; n < nodes && slot < slots; n++){
+            if (given[n] > round) owners[slot++] = n;
+        }
+    }
+    // A node that sends nothing in the next frame has nothing waiting.
+    for (int n = 0; n < nodes; n++){
+        depth[n] = 0;
+    }
+    return;
+}
+
+void RF24_tdma_hub::commit(const uint8_t pipe, const uint8_t length){
+    if (length < 2) return;
+    const uint8_t header = frame[1];
+    const uint8_t node = header >> 4;
+    if (node >= nodes) return;
+    depth[node] = header & 0x07;
+    const uint8_t sequence = (header >> 3) & 1;
+    if (sequence == last_sequence[node]) return; // A frame whose acknowledge got lost, sent again.
+    last_sequence[node] = sequence;
+    last_sender = node;
+    handler.handle(RF24_packet_view{ &frame[2], (uint8_t)(length - 1), pipe });
+    return;
+}
+
+uint32_t RF24_tdma_hub::frame_us() const{
+    return beacon_us + uint32_t(slots) * slot_us;
+}
+
+uint8_t RF24_tdma_hub::owner(const int slot) const{
+    if (slot < 0 || slot >= slots) return RF24_tdma_free;
+    return owners[slot];
+}
+
+void RF24_tdma_hub::poll(){
+    if (beaconing){
+        if (radio.poll() == RF24::tx_result::pending) return;
+        beaconing = false;
+        radio.stop_tx_stream(); // Listen again.
+    }
+    const uint_fast64_t now = radio.clock().now_us();
+    if (now >= next_beacon){
+        next_beacon += this->frame_us();
+        if (next_beacon <= now) next_beacon = now + this->frame_us(); // We were away for more than a frame.
+        this->send_beacon();
+        return;
+    }
+    radio.receive_burst(*this);
+    return;
+}
+
+uint8_t* RF24_tdma_hub::reserve(const uint8_t, const uint8_t){
+    return &*frame;
+}
+
+void RF24_tdma_hub::send_beacon(){
+    this->assign();
+    uint8_t beacon[RF24_tdma_beacon_header + RF24_tdma_max_slots];
+    beacon[0] = frame_number++;
+    beacon[1] = slot_us & 0xFF;
+    beacon[2] = slot_us >> 8;
+    beacon[3] = beacon_us & 0xFF;
+    beacon[4] = beacon_us >> 8;
+    beacon[5] = slots;
+    for (int i = 0; i < slots; i++){
+        beacon[RF24_tdma_beacon_header + i] = owners[i];
+    }
+    // Without acknowledge, every node hears it and none of them answers.
+    radio.start_tx_stream();
+    beaconing = radio.try_send(&*beacon, RF24_tdma_beacon_header + slots, false);
+    if (!beaconing) radio.stop_tx_stream();
+    return;
+}
+
+uint8_t RF24_tdma_hub::sender() const{
+    return last_sender;
+}
+
+void RF24_tdma_hub::set_packet_time(const uint16_t us){
+    packet_us = (us > 0) ? us : 1;
+    return;
+}
+
+void RF24_tdma_hub::start(const uint8_t* data_address, const uint8_t* beacon_address){
+    radio.set_ce(0);
+    radio.set_rx_address(RX_ADDR_P0, data_address);
+    radio.set_tx_address(beacon_address);
+    radio.enable_dynamic_payload(DPL_P0);
+    radio.set_bit(FEATURE, EN_DYN_ACK); // Needed for W_TX_PAYLOAD_NO_ACK.
+    radio.write_register(NRF_CONFIG, radio.read_register(NRF_CONFIG) | (1 << PRIM_RX) | (1 << PWR_UP));
+    radio.set_ce(1);
+    next_beacon = radio.clock().now_us();
+    return;
+}
+
+RF24_tdma_node::RF24_tdma_node(RF24 & radio, const uint8_t id):
+    radio( radio ),
+    id( id & 0x0F ),
+    head( 0 ),
+    count( 0 ),
+    loaded( 0 ),
+    sequence( 0 ),
+    slots( 0 ),
+    slot_us( 0 ),
+    frame_start( 0 ),
+    heard_at( 0 ),
+    period_us( 0 ),
+    last_frame( 0 ),
+    missed( 0 ),
+    synced( false ),
+    sending( false ),
+    guard_us( 100 ),
+    packet_us( 500 )
+{}
+
+void RF24_tdma_node::commit(const uint8_t pipe, const uint8_t length){
+    if (pipe != 1 || length < RF24_tdma_beacon_header) return;
+    const uint8_t* beacon = &frame[1];
+    const uint_fast64_t now = radio.clock().now_us();
+    const uint16_t slot = beacon[1] | (beacon[2] << 8);
+    const uint16_t beacon_us = beacon[3] | (beacon[4] << 8);
+    int table = beacon[5];
+    if (table > RF24_tdma_max_slots) table = RF24_tdma_max_slots;
+    if (table > length - RF24_tdma_beacon_header) table = length - RF24_tdma_beacon_header;
+    // Measure the frame length on our clock, over the frames since the last beacon we heard.
+    const uint8_t frames = beacon[0] - last_frame;
+    if (synced && slot == slot_us && table == slots && frames > 0 && frames <= 4){
+        const int32_t measured = (now - heard_at) / frames;
+        period_us += (measured - (int32_t)period_us) / 4;
+    }
+    else {
+        period_us = beacon_us + uint32_t(table) * slot;
+    }
+    slot_us = slot;
+    slots = table;
+    for (int i = 0; i < table; i++){
+        owners[i] = beacon[RF24_tdma_beacon_header + i];
+    }
+    frame_start = now;
+    heard_at = now;
+    last_frame = beacon[0];
+    missed = 0;
+    synced = true;
+    return;
+}
+
+int RF24_tdma_node::pending() const{
+    return count;
+}
+
+void RF24_tdma_node::poll(){
+    // Collect the results of the frames in flight, they come in the order they were loaded.
+    while (loaded > 0){
+        const RF24::tx_result result = radio.poll();
+        if (result == RF24::tx_result::pending) break;
+        if (result == RF24::tx_result::idle){
+            loaded = 0; // The radio forgot them, they are sent again.
+            break;
+        }
+        loaded--;
+        if (result == RF24::tx_result::sent){
+            head = (head + 1) % RF24_tdma_queue;
+            count--;
+        }
+        // A frame that failed stays at the front of the queue, and goes again in a next slot.
+    }
+    const uint_fast64_t now = radio.clock().now_us();
+    if (synced && now >= frame_start + period_us + packet_us){
+        // The beacon did not come, go on with the measured frame length.
+        frame_start += period_us;
+        if (++missed >= 4) synced = false;
+    }
+    if (synced && loaded < 3 && count > loaded && now >= frame_start){
+        const uint32_t offset = now - frame_start;
+        const int slot = offset / slot_us;
+        if (slot < slots && owners[slot] == id){
+            const uint_fast64_t end = frame_start + uint32_t(slot + 1) * slot_us;
+            // Load what fits in the rest of the slot, behind the frames that are loaded already.
+            if (offset - uint32_t(slot) * slot_us >= guard_us && now + uint32_t(loaded + 1) * packet_us + guard_us <= end){
+                if (!sending){
+                    radio.start_tx_stream();
+                    radio.write_register(EN_RXADDR, (1 << ERX_P0) | (1 << ERX_P1)); // For the acknowledges.
+                    sending = true;
+                }
+                const int index = (head + loaded) % RF24_tdma_queue;
+                const int behind = count - loaded - 1;
+                queue[index][0] = (queue[index][0] & 0xF8) | ((behind > 7) ? 7 : behind);
+                if (radio.try_send(&queue[index][0], queue_length[index])) loaded++;
+                return;
+            }
+        }
+    }
+    if (loaded > 0) return; // Wait for the results before we listen again.
+    if (sending){
+        radio.write_register(EN_RXADDR, (1 << ERX_P1));
+        radio.stop_tx_stream();
+        sending = false;
+    }
+    // Only read the RX FIFO when a beacon is due.
+    if (!synced || now + guard_us >= frame_start + period_us) radio.receive_burst(*this);
+    return;
+}
+
+uint8_t* RF24_tdma_node::reserve(const uint8_t, const uint8_t){
+    return &*frame;
+}
+
+bool RF24_tdma_node::send(const uint8_t* data, const int bytes){
+    if (bytes < 1 || bytes > RF24_tdma_data || count == RF24_tdma_queue) return false;
+    const int index = (head + count) % RF24_tdma_queue;
+    for (int i = 0; i < bytes; i++){
+        queue[index][i + 1] = data[i];
+    }
+    queue[index][0] = (id << 4) | (sequence << 3); // The sequence bit stays when the frame is sent again.
+    sequence ^= 1;
+    queue_length[index] = bytes + 1;
+    count++;
+    return true;
+}
+
+void RF24_tdma_node::set_guard(const uint16_t us){
+    guard_us = us;
+    return;
+}
+
+void RF24_tdma_node::set_packet_time(const uint16_t us){
+    packet_us = us;
+    return;
+}
+
+void RF24_tdma_node::start(const uint8_t* data_address, const uint8_t* beacon_address){
+    radio.set_ce(0);
+    radio.set_rx_address(RX_ADDR_P0, data_address); // The acknowledges of the hub come on the data address.
+    radio.set_rx_address(RX_ADDR_P1, beacon_address);
+    radio.set_tx_address(data_address);
+    radio.enable_dynamic_payload(DPL_P0);
+    radio.enable_dynamic_payload(DPL_P1);
+    radio.write_register(EN_RXADDR, (1 << ERX_P1)); // Pipe 0 only while we send.
+    radio.write_register(NRF_CONFIG, radio.read_register(NRF_CONFIG) | (1 << PRIM_RX) | (1 << PWR_UP));
+    radio.set_ce(1);
+    synced = false;
+    sending = false;
+    loaded = 0;
+    return;
+}
+
+bool RF24_tdma_node::synchronized() const{
+    return synced;
+}
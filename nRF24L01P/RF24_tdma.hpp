@@ -0,0 +1,216 @@
+// ==========================================================================
+//
+// File      : RF24_tdma.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_tdma.hpp
+ */
+
+#ifndef RF24_TDMA_H
+#define RF24_TDMA_H
+
+#include "RF24.hpp"
+#include "RF24_packet.hpp"
+
+/// \brief
+/// Layout of a beacon.
+/// \details
+/// Byte 0 is the frame number, byte 1-2 the slot length and byte 3-4 the beacon time, both in us and least
+/// significant byte first, byte 5 the number of slots. Then follows one byte per slot with the node that owns it,
+/// or RF24_tdma_free.
+const int RF24_tdma_beacon_header = 6;
+const int RF24_tdma_max_slots = 16;
+const uint8_t RF24_tdma_free = 0xFF;
+
+/// \brief
+/// Layout of a data frame.
+/// \details
+/// Byte 0 holds the node id in the high nibble, a sequence bit in bit 3 and the number of frames the node has
+/// waiting behind this one (up to 7) in bit 0-2, followed by up to RF24_tdma_data bytes.
+/// The sequence bit flips with every new frame of a node, and stays the same when the frame is sent again.
+const int RF24_tdma_data = 31;
+const int RF24_tdma_max_nodes = 16;
+
+/// \brief
+/// Number of frames a node can have waiting.
+const int RF24_tdma_queue = 8;
+
+/// \brief
+/// The PRX of a time-slotted network, which hands out the slots.
+/// \details
+/// When nodes send to one address at will, their packets collide, and Enhanced ShockBurst retransmits them
+/// after the same delay, so they collide again. With the hub, time is divided in frames. A frame starts with
+/// a beacon, which the hub sends without acknowledge to the beacon address, so every node hears it.
+/// The rest of the frame is divided in slots, and the beacon tells which node may send in which slot.
+/// Every node keeps at least one slot, so it can report how many frames it has waiting. The other slots are
+/// given to the nodes with the most frames waiting, for the next frame.
+/// The hub listens on the data address with pipe 0, the data goes to the handler without the header byte.
+/// sender() tells which node it came from. A frame with the same sequence bit as the last one of its node was
+/// received before and only its acknowledge got lost, so it is not passed on again.
+class RF24_tdma_hub : public RF24_packet_sink {
+private:
+    RF24 & radio; /// The radio of the hub.
+    RF24_packet_handler & handler; /// Handles the data.
+    uint8_t nodes; /// Number of nodes, with ids 0 to nodes - 1.
+    uint8_t slots; /// Number of slots in a frame.
+    uint16_t slot_us; /// Length of a slot.
+    uint16_t beacon_us; /// Time at the start of a frame for the beacon.
+    uint16_t packet_us; /// Time a node needs per packet, to count how many packets fit in a slot.
+    uint8_t owners[RF24_tdma_max_slots]; /// The node that owns every slot.
+    uint8_t depth[RF24_tdma_max_nodes]; /// Per node, the number of frames it reported waiting.
+    uint8_t last_sequence[RF24_tdma_max_nodes]; /// Per node, the sequence bit of the last frame, 0xFF before the first.
+    uint8_t frame[33]; /// The frame that is read.
+    uint8_t frame_number; /// Number of the next beacon.
+    uint_fast64_t next_beacon; /// Time the next frame starts.
+    bool beaconing; /// Holds if the beacon is in the TX FIFO.
+    uint8_t last_sender; /// The node the last frame came from.
+    
+    /// \brief
+    /// This will divide the slots of the next frame over the nodes.
+    void assign();
+    
+    /// \brief
+    /// This will start a frame: load the beacon and send it.
+    void send_beacon();
+public:
+    /// \brief
+    /// A hub for up to RF24_tdma_max_nodes nodes, in frames of up to RF24_tdma_max_slots slots.
+    /// \details
+    /// There are at least as many slots as nodes. A frame takes beacon_us + slots * slot_us.
+    RF24_tdma_hub(RF24 & radio, RF24_packet_handler & handler, const uint8_t nodes, const uint8_t slots,
+                  const uint16_t slot_us = 3000, const uint16_t beacon_us = 1000);
+    
+    /// \brief
+    /// This will pass the data of a frame to the handler, and note the queue of its node.
+    /// \details
+    /// A frame that was received before is not passed on, but its queue is noted.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return the length of a frame in us.
+    uint32_t frame_us() const;
+    
+    /// \brief
+    /// This will return the node that owns a slot in the current frame, or RF24_tdma_free.
+    uint8_t owner(const int slot) const;
+    
+    /// \brief
+    /// This will send the beacon when a frame starts, and read what arrived otherwise, without waiting.
+    /// \details
+    /// Call it as often as possible, the beacon is late by as much as the time between two calls.
+    void poll();
+    
+    /// \brief
+    /// This will return storage for a frame.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return the node the data that is being handled came from.
+    uint8_t sender() const;
+    
+    /// \brief
+    /// This will set the time a node needs per packet, including its acknowledge. The default is 500 us.
+    void set_packet_time(const uint16_t us);
+    
+    /// \brief
+    /// This will set the addresses and start the first frame.
+    /// \details
+    /// The addresses are 5 bytes long, the nodes must use the same ones. EN_DYN_ACK is set for the beacons.
+    void start(const uint8_t* data_address, const uint8_t* beacon_address);
+};
+
+/// \brief
+/// A PTX of a time-slotted network, which only sends in its own slots.
+/// \details
+/// Data given to send() is queued. The node listens for the beacon of the hub on pipe 1, and slot 0 starts
+/// when the beacon is read. In its slots the node switches to a TX stream and sends as many frames as fit,
+/// the last one starts at least packet_us + guard_us before the slot ends. Then it listens again.
+/// Pipe 0 is only enabled while the node sends, to get the acknowledges of the hub,
+/// otherwise it would acknowledge the frames of the other nodes.
+/// The beacons correct the drift between the clocks: every beacon sets the start of the frame, and the time
+/// between beacons is measured. When a beacon is lost, the node goes on with the measured frame length.
+/// After 4 lost beacons in a row the node stops sending until it hears one again.
+/// The RX FIFO is only read when a beacon is due, so a node costs no SPI time while it waits.
+class RF24_tdma_node : public RF24_packet_sink {
+private:
+    RF24 & radio; /// The radio of the node.
+    uint8_t id; /// The id of this node.
+    uint8_t queue[RF24_tdma_queue][32]; /// The frames that wait, byte 0 is for the header.
+    uint8_t queue_length[RF24_tdma_queue]; /// Number of bytes per frame.
+    uint8_t head; /// Index of the oldest frame.
+    uint8_t count; /// Number of frames that wait, also those in the TX FIFO.
+    uint8_t loaded; /// Number of frames in the TX FIFO.
+    uint8_t sequence; /// The sequence bit of the next frame given to send().
+    uint8_t owners[RF24_tdma_max_slots]; /// The node that owns every slot, from the last beacon.
+    uint8_t slots; /// Number of slots, from the last beacon.
+    uint16_t slot_us; /// Length of a slot, from the last beacon.
+    uint_fast64_t frame_start; /// Time slot 0 starts, on our clock.
+    uint_fast64_t heard_at; /// Time the last beacon was read.
+    uint32_t period_us; /// Measured time between two beacons.
+    uint8_t last_frame; /// Frame number of the last beacon.
+    uint8_t missed; /// Number of beacons lost in a row.
+    bool synced; /// Holds if we know when the slots are.
+    bool sending; /// Holds if the radio is in a TX stream.
+    uint16_t guard_us; /// Margin at both ends of a slot.
+    uint16_t packet_us; /// Time a packet needs, including its acknowledge.
+    uint8_t frame[33]; /// The beacon that is read.
+public:
+    /// \brief
+    /// The id is 0 to RF24_tdma_max_nodes - 1, and must be unique in the network.
+    RF24_tdma_node(RF24 & radio, const uint8_t id);
+    
+    /// \brief
+    /// This will take the slot table of a beacon and correct the frame start.
+    void commit(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will return the number of frames that wait or are in flight.
+    int pending() const;
+    
+    /// \brief
+    /// This will send in our slots and listen for beacons, without waiting.
+    /// \details
+    /// Call it as often as possible, a slot is only used while it is called.
+    void poll();
+    
+    /// \brief
+    /// This will return storage for a beacon.
+    uint8_t* reserve(const uint8_t pipe, const uint8_t length) override;
+    
+    /// \brief
+    /// This will queue 1 to RF24_tdma_data bytes, and return '0' if the queue is full.
+    /// \details
+    /// The data is copied, it is sent in our next slot.
+    bool send(const uint8_t* data, const int bytes);
+    
+    /// \brief
+    /// This will set the margin at both ends of a slot, for the time it takes to read a beacon. The default is 100 us.
+    void set_guard(const uint16_t us);
+    
+    /// \brief
+    /// This will set the time a packet needs, including its acknowledge. The default is 500 us.
+    void set_packet_time(const uint16_t us);
+    
+    /// \brief
+    /// This will set the addresses and start listening for a beacon.
+    /// \details
+    /// The addresses are 5 bytes long and must be those of the hub.
+    void start(const uint8_t* data_address, const uint8_t* beacon_address);
+    
+    /// \brief
+    /// This will return true if the node heard a beacon recently enough to send.
+    bool synchronized() const;
+};
+
+#endif
@@ -42,8 +42,9 @@ int main( void ){
     hwlib::cout << "RX Status: " << hwlib::bin << unsigned(receiver.read_register(NRF_STATUS)) << '\n';
     
     if (receiver.check_bit(NRF_STATUS, RX_DR)){
-        uint8_t* datain = receiver.receive();
-        for (int i = 1; i < datain[0]; i++){
+        uint8_t datain[32];
+        const RF24_packet_view packet = receiver.receive_into(&*datain, 32);
+        for (int i = 0; i < packet.length; i++){
             hwlib::cout << "Data[" << hwlib::dec << i << "] " << hwlib::hex << unsigned(datain[i]) << '\n';
         }
         hwlib::cout << "RX Status: " << hwlib::bin << unsigned(receiver.read_register(NRF_STATUS)) << '\n';
@@ -0,0 +1,669 @@
+// ==========================================================================
+//
+// File      : RF24_sim.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_sim.cpp
+ */
+
+#include "RF24_sim.hpp"
+
+static const uint64_t never = UINT64_MAX; // Event time of a radio that has nothing to do.
+static const uint64_t settle_ns = 130000; // Time to switch from standby to TX or RX (Tstby2a).
+static const uint64_t power_up_ns = 1500000; // Time to go from power down to standby (Tpd2stby).
+static const uint64_t slice_ns = 100000; // The jammer is on or off per slice of time.
+
+// A CRC-16 (CCITT) like that of the chip, a packet with the same PID and CRC as the last one is a duplicate.
+static uint16_t checksum(const uint8_t* data, const int length){
+    uint16_t sum = 0xFFFF;
+    for (int i = 0; i < length; i++){
+        sum ^= (uint16_t)(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++){
+            sum = (sum & 0x8000) ? (uint16_t)((sum << 1) ^ 0x1021) : (uint16_t)(sum << 1);
+        }
+    }
+    return (uint16_t)(sum + length);
+}
+
+RF24_sim_air::RF24_sim_air(const uint32_t seed):
+    radio_count( 0 ),
+    transmission_next( 0 ),
+    time( 0 ),
+    random_state( seed == 0 ? 1 : seed ),
+    spi_byte_ns( 2000 ),
+    spi_transaction_ns( 1000 )
+{
+    for (transmission & t : transmissions){
+        t = { nullptr, 0, 0, 0 };
+    }
+    this->set_loss(0);
+    for (uint16_t & permille : jammer_permille){
+        permille = 0;
+    }
+}
+
+void RF24_sim_air::advance(const uint64_t us){
+    this->run_until(time + us * 1000);
+    return;
+}
+
+bool RF24_sim_air::carrier(const uint8_t channel, const RF24_sim_radio* receiver) const{
+    const uint64_t from = (time > slice_ns) ? time - slice_ns : 0;
+    if (this->jammed(channel, from, time + 1)) return true;
+    for (const transmission & t : transmissions){
+        if (t.sender != nullptr && t.sender != receiver && t.channel == channel && t.start <= time && t.end > from){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RF24_sim_air::corrupted(const RF24_sim_radio* sender, const uint8_t channel, const uint64_t start, const uint64_t end,
+                             const uint8_t rate, const uint8_t level){
+    for (const transmission & t : transmissions){
+        if (t.sender != nullptr && t.sender != sender && t.channel == channel && t.start < end && t.end > start){
+            return true; // Collision.
+        }
+    }
+    if (this->jammed(channel, start, end)) return true;
+    return this->random_permille() < loss_permille[rate][level];
+}
+
+bool RF24_sim_air::jammed(const uint8_t channel, const uint64_t start, const uint64_t end) const{
+    if (channel > 125 || jammer_permille[channel] == 0) return false;
+    for (uint64_t slice = start / slice_ns; slice <= (end - 1) / slice_ns; slice++){
+        uint32_t x = (uint32_t)(slice * 2654435761u) ^ (channel * 40503u) ^ 0x9E3779B9u;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        if (x % 1000 < jammer_permille[channel]) return true;
+    }
+    return false;
+}
+
+uint64_t RF24_sim_air::now_ns() const{
+    return time;
+}
+
+uint_fast64_t RF24_sim_air::now_us(){
+    return time / 1000;
+}
+
+uint32_t RF24_sim_air::random_permille(){
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state % 1000;
+}
+
+void RF24_sim_air::run(){
+    this->run_until(time);
+    return;
+}
+
+void RF24_sim_air::run_until(const uint64_t until){
+    for (;;){
+        RF24_sim_radio* next = nullptr;
+        for (int i = 0; i < radio_count; i++){
+            if (radios[i]->event_time <= until && (next == nullptr || radios[i]->event_time < next->event_time)){
+                next = radios[i];
+            }
+        }
+        if (next == nullptr) break;
+        if (next->event_time > time) time = next->event_time;
+        next->step();
+    }
+    if (until > time) time = until;
+    return;
+}
+
+void RF24_sim_air::set_jammer(const uint8_t channel, const uint16_t permille){
+    if (channel <= 125) jammer_permille[channel] = permille;
+    return;
+}
+
+void RF24_sim_air::set_loss(const uint16_t permille){
+    for (uint8_t rate = 0; rate < 3; rate++){
+        for (uint8_t level = 0; level < 4; level++){
+            this->set_loss(rate, level, permille);
+        }
+    }
+    return;
+}
+
+void RF24_sim_air::set_loss(const uint8_t rate, const uint8_t level, const uint16_t permille){
+    if (rate < 3 && level < 4) loss_permille[rate][level] = permille;
+    return;
+}
+
+void RF24_sim_air::set_spi_clock(const uint32_t hz, const uint32_t transaction_overhead_ns){
+    spi_byte_ns = (uint32_t)(8000000000ull / hz);
+    spi_transaction_ns = transaction_overhead_ns;
+    return;
+}
+
+void RF24_sim_air::transmit(const RF24_sim_radio* sender, const uint8_t channel, const uint64_t start, const uint64_t end){
+    transmissions[transmission_next] = { sender, channel, start, end };
+    transmission_next = (transmission_next + 1) % 32;
+    return;
+}
+
+void RF24_sim_air::wait_us(const int_fast32_t us){
+    if (us > 0) this->advance(us);
+    return;
+}
+
+RF24_sim_radio::pin::pin(RF24_sim_radio & radio, const bool chip_enable):
+    radio( radio ),
+    chip_enable( chip_enable )
+{}
+
+void RF24_sim_radio::pin::set(bool x, hwlib::buffering){
+    radio.air.run();
+    if (chip_enable){
+        const bool rising = x && !radio.ce_level;
+        radio.ce_level = x;
+        radio.update_mode();
+        if (rising){
+            radio.tx_trigger = true; // A pulse on CE sends one packet.
+            radio.start_tx();
+            radio.tx_trigger = false;
+        }
+        else {
+            radio.start_tx();
+        }
+    }
+    else {
+        if (!x && radio.csn_level){
+            radio.frame_index = 0; // A new command starts.
+            radio.transactions++;
+        }
+        else if (x && !radio.csn_level){
+            radio.end_frame();
+        }
+        radio.csn_level = x;
+    }
+    return;
+}
+
+RF24_sim_radio::irq_pin::irq_pin(RF24_sim_radio & radio):
+    radio( radio )
+{}
+
+bool RF24_sim_radio::irq_pin::get(hwlib::buffering){
+    radio.air.run();
+    return (radio.flags & ~radio.regs[NRF_CONFIG] & 0x70) == 0; // Active low.
+}
+
+RF24_sim_radio::RF24_sim_radio(RF24_sim_air & air):
+    air( air ),
+    ce_pin( *this, true ),
+    csn_pin( *this, false ),
+    irq_out( *this ),
+    flags( 0 ),
+    tx_count( 0 ),
+    tx_reuse( false ),
+    rx_count( 0 ),
+    ce_level( false ),
+    csn_level( true ),
+    tx_trigger( false ),
+    frame_index( 0 ),
+    command( NOP ),
+    tx_phase( phase::idle ),
+    event_time( never ),
+    air_start( 0 ),
+    retries( 0 ),
+    pid( 0 ),
+    acknowledged( false ),
+    powered_at( 0 ),
+    rx_mode( false ),
+    rx_since( never ),
+    busy_until( 0 ),
+    acks_to_lose( 0 ),
+    packets_to_lose( 0 ),
+    transactions( 0 ),
+    bytes( 0 ),
+    packets_sent( 0 )
+{
+    // The power on reset values of the datasheet.
+    for (uint8_t & reg : regs){
+        reg = 0;
+    }
+    regs[NRF_CONFIG] = 0x08;
+    regs[EN_AA] = 0x3F;
+    regs[EN_RXADDR] = 0x03;
+    regs[SETUP_AW] = 0x03;
+    regs[SETUP_RETR] = 0x03;
+    regs[RF_CH] = 0x02;
+    regs[RF_SETUP] = 0x0E;
+    for (int i = 0; i < 5; i++){
+        rx_addr[0][i] = 0xE7;
+        rx_addr[1][i] = 0xC2;
+        tx_addr[i] = 0xE7;
+    }
+    for (int pipe = 2; pipe < 6; pipe++){
+        rx_addr[pipe][0] = (uint8_t)(0xC1 + pipe);
+    }
+    for (int pipe = 0; pipe < 6; pipe++){
+        last_pid[pipe] = 0xFF;
+        last_sum[pipe] = 0;
+        ack_sent[pipe] = false;
+    }
+    frame_payload.length = 0;
+    ack_received.length = 0;
+    if (air.radio_count < 16) air.radios[air.radio_count++] = this;
+}
+
+int RF24_sim_radio::address_width() const{
+    return (regs[SETUP_AW] & 0x03) + 2;
+}
+
+uint64_t RF24_sim_radio::air_packets() const{
+    return packets_sent;
+}
+
+uint64_t RF24_sim_radio::airtime(const int length) const{
+    const uint64_t bits = 8 * (1 + this->address_width() + length + this->crc_bytes()) + 9; // Preamble, address, PCF, payload and CRC.
+    switch (this->rate()){
+        case 0: return bits * 4000;
+        case 1: return bits * 1000;
+        default: return bits * 500;
+    }
+}
+
+hwlib::pin_out & RF24_sim_radio::ce(){
+    return ce_pin;
+}
+
+uint8_t RF24_sim_radio::clock_byte(const uint8_t in){
+    const int index = frame_index++;
+    if (index == 0){
+        const uint8_t result = this->status(); // The status is shifted out while the command is shifted in.
+        command = in;
+        frame_payload.length = 0;
+        if (command == FLUSH_TX){
+            tx_count = 0;
+            tx_reuse = false;
+            tx_phase = phase::idle;
+            event_time = never;
+            for (bool & sent : ack_sent){
+                sent = false;
+            }
+        }
+        else if (command == FLUSH_RX){
+            rx_count = 0;
+        }
+        else if (command == REUSE_TX_PL){
+            tx_reuse = true;
+        }
+        return result;
+    }
+    if (command < W_REGISTER){
+        return this->read(command & REGISTER_MASK, index - 1);
+    }
+    if (command < ACTIVATE){
+        const uint8_t reg = (command & REGISTER_MASK);
+        if (reg == RX_ADDR_P0 || reg == RX_ADDR_P1){
+            if (index <= 5) rx_addr[reg - RX_ADDR_P0][index - 1] = in;
+        }
+        else if (reg == TX_ADDR){
+            if (index <= 5) tx_addr[index - 1] = in;
+        }
+        else if (reg >= RX_ADDR_P2 && reg <= RX_ADDR_P5){
+            if (index == 1) rx_addr[reg - RX_ADDR_P0][0] = in;
+        }
+        else if (index == 1){
+            this->write(reg, in);
+        }
+        return 0;
+    }
+    if (command == R_RX_PL_WID){
+        return (rx_count > 0) ? rx_fifo[0].length : 0;
+    }
+    if (command == R_RX_PAYLOAD){
+        return (rx_count > 0 && index <= 32) ? rx_fifo[0].data[index - 1] : 0;
+    }
+    if (command == W_TX_PAYLOAD || command == W_TX_PAYLOAD_NO_ACK || (command & 0xF8) == W_ACK_PAYLOAD){
+        if (index <= 32){
+            frame_payload.data[index - 1] = in;
+            frame_payload.length = (uint8_t)index;
+        }
+    }
+    return 0;
+}
+
+int RF24_sim_radio::crc_bytes() const{
+    if (!(regs[NRF_CONFIG] & (1 << EN_CRC))) return 0;
+    return (regs[NRF_CONFIG] & (1 << CRCO)) ? 2 : 1;
+}
+
+hwlib::pin_out & RF24_sim_radio::csn(){
+    return csn_pin;
+}
+
+void RF24_sim_radio::end_frame(){
+    if (command == R_RX_PAYLOAD && frame_index > 1 && rx_count > 0){
+        this->remove(rx_fifo, rx_count, 0); // The payload is gone once it is read.
+    }
+    else if (frame_payload.length > 0 && tx_count < 3){
+        fifo_entry & entry = tx_fifo[tx_count++];
+        entry = frame_payload;
+        entry.no_ack = (command == W_TX_PAYLOAD_NO_ACK);
+        entry.ack_payload = ((command & 0xF8) == W_ACK_PAYLOAD);
+        entry.pipe = entry.ack_payload ? (command & 0x07) : 0;
+        if (command == W_TX_PAYLOAD) tx_reuse = false;
+        if (!entry.ack_payload){
+            entry.pid = pid; // Also a payload that is written again after it failed, REUSE_TX_PL keeps the id.
+            pid = (pid + 1) & 0x03;
+        }
+        this->start_tx();
+    }
+    frame_payload.length = 0;
+    command = NOP;
+    return;
+}
+
+void RF24_sim_radio::finish(const bool success){
+    const uint64_t now = air.time;
+    if (success){
+        flags |= (1 << TX_DS);
+        if (ack_received.length > 0 && rx_count < 3){
+            rx_fifo[rx_count++] = ack_received; // An ACK payload arrives on pipe 0.
+            flags |= (1 << RX_DR);
+        }
+        ack_received.length = 0;
+        regs[OBSERVE_TX] = (uint8_t)((regs[OBSERVE_TX] & 0xF0) | retries);
+        if (!tx_reuse) this->remove(tx_fifo, tx_count, 0);
+        retries = 0;
+        tx_phase = phase::idle;
+        event_time = never;
+        this->start_tx();
+    }
+    else if (retries < (regs[SETUP_RETR] & 0x0F)){
+        retries++;
+        tx_phase = phase::settle;
+        event_time = now + settle_ns;
+    }
+    else {
+        flags |= (1 << MAX_RT); // The module stops until MAX_RT is cleared.
+        uint8_t lost = (uint8_t)(regs[OBSERVE_TX] >> PLOS_CNT);
+        if (lost < 15) lost++;
+        regs[OBSERVE_TX] = (uint8_t)((lost << PLOS_CNT) | retries);
+        retries = 0;
+        tx_phase = phase::idle;
+        event_time = never;
+    }
+    return;
+}
+
+hwlib::pin_in & RF24_sim_radio::irq(){
+    return irq_out;
+}
+
+void RF24_sim_radio::lose_acks(const int count){
+    acks_to_lose = count;
+    return;
+}
+
+void RF24_sim_radio::lose_packets(const int count){
+    packets_to_lose = count;
+    return;
+}
+
+uint8_t RF24_sim_radio::peek(const uint8_t reg){
+    air.run();
+    return this->read(reg, 0);
+}
+
+uint8_t RF24_sim_radio::rate() const{
+    if (regs[RF_SETUP] & (1 << RF_DR_LOW)) return 0;
+    return (regs[RF_SETUP] & (1 << RF_DR_HIGH)) ? 2 : 1;
+}
+
+uint8_t RF24_sim_radio::read(const uint8_t reg, const int index){
+    switch (reg){
+        case RX_ADDR_P0:
+        case RX_ADDR_P1:
+            return (index < 5) ? rx_addr[reg - RX_ADDR_P0][index] : 0;
+        case TX_ADDR:
+            return (index < 5) ? tx_addr[index] : 0;
+        case NRF_STATUS:
+            return this->status();
+        case FIFO_STATUS:
+            return (uint8_t)((tx_reuse << TX_REUSE) | ((tx_count == 3) << FIFO_FULL) | ((tx_count == 0) << TX_EMPTY)
+                             | ((rx_count == 3) << RX_FULL) | ((rx_count == 0) << RX_EMPTY));
+        case RPD:
+            return (rx_mode && air.time >= rx_since && air.carrier(regs[RF_CH], this)) ? 1 : 0;
+        default:
+            if (reg >= RX_ADDR_P2 && reg <= RX_ADDR_P5) return (index == 0) ? rx_addr[reg - RX_ADDR_P0][0] : 0;
+            return (index == 0 && reg < 0x20) ? regs[reg] : 0;
+    }
+}
+
+bool RF24_sim_radio::receive(const RF24_sim_radio & sender, const fifo_entry & packet, const uint8_t packet_pid,
+                             const uint64_t start, const uint64_t end, uint64_t & ack_end, fifo_entry & ack){
+    if (!rx_mode || rx_since > start || busy_until > start) return false; // Not listening.
+    if (regs[RF_CH] != sender.regs[RF_CH] || this->rate() != sender.rate()) return false;
+    if (this->address_width() != sender.address_width() || this->crc_bytes() != sender.crc_bytes()) return false;
+    int pipe = -1;
+    for (int p = 0; p < 6 && pipe < 0; p++){
+        if (!(regs[EN_RXADDR] & (1 << p))) continue;
+        bool match = true;
+        for (int i = 0; i < this->address_width(); i++){
+            const uint8_t byte = (p < 2 || i == 0) ? rx_addr[p][i] : rx_addr[1][i]; // Pipe 2-5 share the upper bytes of pipe 1.
+            if (byte != sender.tx_addr[i]) match = false;
+        }
+        if (match) pipe = p;
+    }
+    if (pipe < 0) return false;
+    if (air.corrupted(&sender, regs[RF_CH], start, end, sender.rate(), (sender.regs[RF_SETUP] >> RF_PWR_LOW) & 0x03)){
+        return false;
+    }
+    const bool dynamic = (regs[FEATURE] & (1 << EN_DPL)) && (regs[DYNPD] & (1 << pipe));
+    if (!dynamic && regs[RX_PW_P0 + pipe] != packet.length) return false; // The CRC would not match.
+    if (rx_count == 3) return false; // No room, so it is not acknowledged.
+    const bool auto_ack = !packet.no_ack && (regs[EN_AA] & (1 << pipe));
+    const uint16_t sum = checksum(packet.data, packet.length);
+    const bool duplicate = auto_ack && last_pid[pipe] == packet_pid && last_sum[pipe] == sum;
+    last_pid[pipe] = packet_pid;
+    last_sum[pipe] = sum;
+    if (!duplicate){
+        fifo_entry & entry = rx_fifo[rx_count++];
+        entry = packet;
+        entry.pipe = (uint8_t)pipe;
+        flags |= (1 << RX_DR);
+    }
+    if (!auto_ack) return false;
+    // The ACK payload is kept until the next packet shows the PTX got it.
+    int found = -1;
+    for (int i = 0; i < tx_count && found < 0; i++){
+        if (tx_fifo[i].ack_payload && tx_fifo[i].pipe == pipe) found = i;
+    }
+    if (!duplicate && ack_sent[pipe] && found >= 0){
+        this->remove(tx_fifo, tx_count, found);
+        flags |= (1 << TX_DS);
+        ack_sent[pipe] = false;
+        found = -1;
+        for (int i = 0; i < tx_count && found < 0; i++){
+            if (tx_fifo[i].ack_payload && tx_fifo[i].pipe == pipe) found = i;
+        }
+    }
+    ack.length = 0;
+    if ((regs[FEATURE] & (1 << EN_ACK_PAY)) && found >= 0){
+        ack = tx_fifo[found];
+        ack_sent[pipe] = true;
+    }
+    const uint64_t ack_start = end + settle_ns;
+    ack_end = ack_start + this->airtime(ack.length);
+    busy_until = ack_end;
+    air.transmit(this, regs[RF_CH], ack_start, ack_end);
+    if (acks_to_lose > 0){
+        acks_to_lose--;
+        return false; // It is on the air, but the PTX does not get it.
+    }
+    return true;
+}
+
+void RF24_sim_radio::remove(fifo_entry* fifo, int & count, const int index){
+    for (int i = index + 1; i < count; i++){
+        fifo[i - 1] = fifo[i];
+    }
+    count--;
+    return;
+}
+
+void RF24_sim_radio::reset_counters(){
+    transactions = 0;
+    bytes = 0;
+    packets_sent = 0;
+    return;
+}
+
+uint32_t RF24_sim_radio::spi_bytes() const{
+    return bytes;
+}
+
+uint32_t RF24_sim_radio::spi_transactions() const{
+    return transactions;
+}
+
+void RF24_sim_radio::start_tx(){
+    if (tx_phase != phase::idle || tx_count == 0 || (flags & (1 << MAX_RT))) return;
+    if (!(regs[NRF_CONFIG] & (1 << PWR_UP)) || (regs[NRF_CONFIG] & (1 << PRIM_RX))) return;
+    if (!ce_level && !tx_trigger) return;
+    if (tx_fifo[0].ack_payload) return; // Only a PRX sends ACK payloads.
+    tx_trigger = false;
+    tx_phase = phase::settle;
+    event_time = ((powered_at > air.time) ? powered_at : air.time) + settle_ns;
+    return;
+}
+
+uint8_t RF24_sim_radio::status() const{
+    const uint8_t pipe = (rx_count > 0) ? rx_fifo[0].pipe : 7; // 7 means the RX FIFO is empty.
+    return (uint8_t)(flags | (pipe << RX_P_NO) | ((tx_count == 3) << TX_FULL));
+}
+
+void RF24_sim_radio::step(){
+    const uint64_t now = air.time;
+    if (tx_phase == phase::settle){
+        tx_phase = phase::air;
+        air_start = now;
+        event_time = now + this->airtime(tx_fifo[0].length);
+        packets_sent++;
+        air.transmit(this, regs[RF_CH], air_start, event_time);
+    }
+    else if (tx_phase == phase::air){
+        fifo_entry packet = tx_fifo[0];
+        packet.no_ack = packet.no_ack || !(regs[EN_AA] & (1 << ENAA_P0));
+        acknowledged = false;
+        ack_received.length = 0;
+        uint64_t ack_end = 0;
+        const bool lost = (packets_to_lose > 0);
+        if (lost) packets_to_lose--;
+        for (int i = 0; i < air.radio_count && !lost; i++){
+            RF24_sim_radio & receiver = *air.radios[i];
+            fifo_entry ack;
+            if (&receiver == this || !receiver.receive(*this, packet, packet.pid, air_start, now, ack_end, ack)) continue;
+            if (acknowledged) continue; // The first acknowledge is the one that counts.
+            // The ACK is sent to the TX address, so the PTX must listen on it with pipe 0.
+            bool listening = (regs[EN_RXADDR] & (1 << ERX_P0));
+            for (int j = 0; j < this->address_width(); j++){
+                if (rx_addr[0][j] != tx_addr[j]) listening = false;
+            }
+            const uint64_t ack_delay = ((regs[SETUP_RETR] >> ARD) + 1) * 250000; // ARD, counted from the end of the packet.
+            if (!listening || ack_end - now > ack_delay) continue;
+            if (air.corrupted(&receiver, regs[RF_CH], ack_end - receiver.airtime(ack.length), ack_end,
+                              receiver.rate(), (receiver.regs[RF_SETUP] >> RF_PWR_LOW) & 0x03)){
+                continue;
+            }
+            acknowledged = true;
+            if ((regs[FEATURE] & (1 << EN_ACK_PAY)) && ack.length > 0){
+                ack_received = ack;
+                ack_received.pipe = 0;
+            }
+        }
+        if (packet.no_ack){
+            this->finish(true);
+        }
+        else {
+            tx_phase = phase::wait_ack;
+            event_time = acknowledged ? ack_end : now + ((regs[SETUP_RETR] >> ARD) + 1) * 250000;
+        }
+    }
+    else if (tx_phase == phase::wait_ack){
+        this->finish(acknowledged);
+    }
+    else {
+        event_time = never;
+    }
+    return;
+}
+
+void RF24_sim_radio::update_mode(){
+    const bool listening = ce_level && (regs[NRF_CONFIG] & (1 << PWR_UP)) && (regs[NRF_CONFIG] & (1 << PRIM_RX));
+    if (listening && !rx_mode){
+        rx_since = ((powered_at > air.time) ? powered_at : air.time) + settle_ns;
+    }
+    if (!listening) rx_since = never;
+    rx_mode = listening;
+    return;
+}
+
+void RF24_sim_radio::write(const uint8_t reg, const uint8_t value){
+    switch (reg){
+        case NRF_STATUS:
+            flags &= (uint8_t)~(value & 0x70); // Writing a 1 clears the flag.
+            this->start_tx();
+            break;
+        case NRF_CONFIG:
+            if ((value & (1 << PWR_UP)) && !(regs[NRF_CONFIG] & (1 << PWR_UP))){
+                powered_at = air.time + power_up_ns;
+            }
+            regs[NRF_CONFIG] = value;
+            if (!(value & (1 << PWR_UP))){
+                tx_phase = phase::idle; // Power down stops everything.
+                event_time = never;
+                retries = 0;
+            }
+            this->update_mode();
+            this->start_tx();
+            break;
+        case RF_CH:
+            regs[RF_CH] = (value & 0x7F);
+            regs[OBSERVE_TX] &= 0x0F; // Writing RF_CH resets PLOS_CNT.
+            break;
+        case OBSERVE_TX:
+        case RPD:
+        case FIFO_STATUS:
+            break; // Read only.
+        default:
+            if (reg < 0x20) regs[reg] = value;
+            break;
+    }
+    return;
+}
+
+void RF24_sim_radio::write_and_read(hwlib::pin_out & sel, const size_t n, const uint8_t data_out[], uint8_t data_in[]){
+    air.run();
+    sel.set(0);
+    for (size_t i = 0; i < n; i++){
+        const uint8_t out = (data_out == nullptr) ? 0 : data_out[i];
+        const uint8_t in = csn_level ? 0xFF : this->clock_byte(out); // Nothing answers while CSN is high.
+        if (data_in != nullptr) data_in[i] = in;
+    }
+    bytes += (uint32_t)n;
+    air.run_until(air.time + air.spi_transaction_ns + n * air.spi_byte_ns);
+    sel.set(1);
+    return;
+}
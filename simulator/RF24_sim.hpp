@@ -0,0 +1,356 @@
+// ==========================================================================
+//
+// File      : RF24_sim.hpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file RF24_sim.hpp
+ */
+
+#ifndef RF24_SIM_H
+#define RF24_SIM_H
+
+#include "hwlib.hpp"
+#include "nRF24L01.h"
+#include "RF24_clock.hpp"
+
+class RF24_sim_radio;
+
+/// \brief
+/// The simulated air that simulated nRF24L01+ modules send through.
+/// \details
+/// The air keeps a virtual clock, in nanoseconds, that is shared by all radios.
+/// Time only moves when a radio is accessed over SPI (every byte takes the time it would take on the bus)
+/// or when advance() is called, so a simulation gives the same results every time it is run.
+/// Packets can get lost at random, collide with other packets on the same channel,
+/// or be destroyed by a jammer on a channel.
+/// The air is also a clock, so RF24::set_clock() makes the waits and timeouts of the library use virtual time.
+class RF24_sim_air : public RF24_clock {
+private:
+    /// \brief
+    /// A packet on the air.
+    struct transmission {
+        const RF24_sim_radio* sender; /// The radio that sends it.
+        uint8_t channel; /// The RF channel.
+        uint64_t start; /// When the first bit is sent.
+        uint64_t end; /// When the last bit is sent.
+    };
+    
+    RF24_sim_radio* radios[16]; /// The radios on the air.
+    int radio_count; /// Number of radios.
+    transmission transmissions[32]; /// The last packets sent, to find collisions.
+    int transmission_next; /// Where the next packet is stored.
+    uint64_t time; /// The virtual clock, in ns.
+    uint32_t random_state; /// State of the random generator.
+    uint16_t loss_permille[3][4]; /// Chance a packet is lost, per data rate and PA level.
+    uint16_t jammer_permille[126]; /// Part of the time a channel is jammed.
+    uint32_t spi_byte_ns; /// Time one SPI byte takes.
+    uint32_t spi_transaction_ns; /// Extra time every SPI transaction takes.
+    
+    /// \brief
+    /// This will return true if a packet from sender on channel, between start and end, is destroyed.
+    bool corrupted(const RF24_sim_radio* sender, const uint8_t channel, const uint64_t start, const uint64_t end,
+                   const uint8_t rate, const uint8_t level);
+    
+    /// \brief
+    /// This will return true if the jammer is on, on a channel, somewhere between start and end.
+    bool jammed(const uint8_t channel, const uint64_t start, const uint64_t end) const;
+    
+    /// \brief
+    /// This will return a random number from 0 to 999.
+    uint32_t random_permille();
+    
+    /// \brief
+    /// This will run every radio, in the order things happen, until the virtual time is time.
+    void run_until(const uint64_t time);
+    
+    /// \brief
+    /// This will store a packet on the air.
+    void transmit(const RF24_sim_radio* sender, const uint8_t channel, const uint64_t start, const uint64_t end);
+    
+    friend class RF24_sim_radio;
+public:
+    /// \brief
+    /// Creates an empty air, the seed is used for the random packet loss.
+    RF24_sim_air(const uint32_t seed = 1);
+    
+    /// \brief
+    /// This will let time go by, every radio does what it would do in that time.
+    void advance(const uint64_t us);
+    
+    /// \brief
+    /// This will return true if a radio would see a carrier on a channel right now (the RPD register).
+    bool carrier(const uint8_t channel, const RF24_sim_radio* receiver) const;
+    
+    /// \brief
+    /// This will return the virtual time, in ns.
+    uint64_t now_ns() const;
+    
+    /// \brief
+    /// This will return the virtual time, in us.
+    uint_fast64_t now_us() override;
+    
+    /// \brief
+    /// This will run every radio until the virtual time.
+    /// \details
+    /// A radio runs what happens until the current time before it is accessed, so this is only needed to
+    /// read the state of a radio without SPI.
+    void run();
+    
+    /// \brief
+    /// This will set the jammer on a channel.
+    /// \details
+    /// The time is cut in slices of 100 us, and the jammer is on in about permille / 1000 of them.
+    /// Packets that are on the air while the jammer is on are lost, and RPD is set.
+    void set_jammer(const uint8_t channel, const uint16_t permille);
+    
+    /// \brief
+    /// This will set the chance that a packet is lost, for every data rate and PA level.
+    void set_loss(const uint16_t permille);
+    
+    /// \brief
+    /// This will set the chance that a packet is lost, for one data rate and PA level.
+    /// \details
+    /// The rate is 0 for 250 kbps, 1 for 1 Mbps and 2 for 2 Mbps. The level is 0 (-18 dBm) to 3 (0 dBm).
+    /// This can be used to simulate a long link, where high data rates and low power levels lose more packets.
+    void set_loss(const uint8_t rate, const uint8_t level, const uint16_t permille);
+    
+    /// \brief
+    /// This will set the SPI clock, which sets how much time an SPI transaction takes.
+    void set_spi_clock(const uint32_t hz, const uint32_t transaction_overhead_ns = 1000);
+    
+    /// \brief
+    /// This will let time go by, like advance().
+    void wait_us(const int_fast32_t us) override;
+};
+
+/// \brief
+/// A simulated nRF24L01+ module.
+/// \details
+/// This is an hwlib::spi_bus with an nRF24L01+ on it, and it has the CE, CSN and IRQ pins of the module,
+/// so an RF24 can be used with it without any change:
+/// \code
+/// RF24_sim_air air;
+/// RF24_sim_radio module(air);
+/// RF24 radio(module.ce(), module.csn(), module, module.irq());
+/// \endcode
+/// The full register map of nRF24L01.h is modelled, with the 3 level TX and RX FIFOs, dynamic payload,
+/// ACK payloads, Enhanced ShockBurst auto acknowledge with the ARD and ARC retransmit timing,
+/// the packet id to find duplicates, OBSERVE_TX and RPD.
+/// Packets only arrive when channel, data rate, address width, CRC and address match, and the receiver
+/// has been listening for at least 130 us.
+/// An acknowledge arrives 130 us after the packet, and when that is later than ARD, the PTX retransmits.
+/// The SPI protocol is decoded per byte between CSN low and high, so a command can be split over
+/// several write_and_read() calls while CSN is held low.
+class RF24_sim_radio : public hwlib::spi_bus {
+private:
+    /// \brief
+    /// A pin of the module.
+    class pin : public hwlib::pin_out {
+    private:
+        RF24_sim_radio & radio; /// The module.
+        bool chip_enable; /// Holds if this is CE, else it is CSN.
+    public:
+        pin(RF24_sim_radio & radio, const bool chip_enable);
+        void set(bool x, hwlib::buffering buf = hwlib::buffering::unbuffered) override;
+    };
+    
+    /// \brief
+    /// The IRQ pin of the module, low when an event that is not masked is set.
+    class irq_pin : public hwlib::pin_in {
+    private:
+        RF24_sim_radio & radio; /// The module.
+    public:
+        irq_pin(RF24_sim_radio & radio);
+        bool get(hwlib::buffering buf = hwlib::buffering::unbuffered) override;
+    };
+    
+    /// \brief
+    /// An entry of a FIFO.
+    struct fifo_entry {
+        uint8_t data[32]; /// The payload.
+        uint8_t length; /// Number of bytes.
+        uint8_t pipe; /// The pipe it was received on, or the pipe of an ACK payload.
+        bool no_ack; /// Holds if it was written with W_TX_PAYLOAD_NO_ACK.
+        bool ack_payload; /// Holds if it was written with W_ACK_PAYLOAD.
+        uint8_t pid; /// The packet id it is sent with.
+    };
+    
+    /// \brief
+    /// What the PTX side is doing.
+    enum class phase { idle, settle, air, wait_ack };
+    
+    RF24_sim_air & air; /// The air the module sends through.
+    pin ce_pin; /// The CE pin.
+    pin csn_pin; /// The CSN pin.
+    irq_pin irq_out; /// The IRQ pin.
+    uint8_t regs[0x20]; /// The one byte registers.
+    uint8_t rx_addr[6][5]; /// The RX addresses, pipe 2-5 only use the first byte.
+    uint8_t tx_addr[5]; /// The TX address.
+    uint8_t flags; /// RX_DR, TX_DS and MAX_RT.
+    fifo_entry tx_fifo[3]; /// The TX FIFO, oldest first.
+    int tx_count; /// Number of entries in the TX FIFO.
+    bool tx_reuse; /// Holds if REUSE_TX_PL is active.
+    fifo_entry rx_fifo[3]; /// The RX FIFO, oldest first.
+    int rx_count; /// Number of entries in the RX FIFO.
+    bool ce_level; /// The level of CE.
+    bool csn_level; /// The level of CSN.
+    bool tx_trigger; /// Holds if CE went high, a packet is sent even if CE is low again.
+    // The SPI command that is being decoded.
+    int frame_index; /// Number of bytes of the command so far.
+    uint8_t command; /// The command byte.
+    fifo_entry frame_payload; /// The payload or address that is written.
+    // The PTX side.
+    phase tx_phase; /// What the PTX side is doing.
+    uint64_t event_time; /// When the PTX side does the next step, in ns.
+    uint64_t air_start; /// When the packet that is sent started.
+    uint8_t retries; /// Number of retransmits of the packet that is sent.
+    uint8_t pid; /// Packet id of the next payload that is written, every new payload gets the next one.
+    bool acknowledged; /// Holds if the acknowledge of the packet that is sent arrived.
+    fifo_entry ack_received; /// The ACK payload that arrived with the acknowledge.
+    // The PRX side.
+    uint64_t powered_at; /// When the module is done powering up, in ns.
+    bool rx_mode; /// Holds if the module is listening.
+    uint64_t rx_since; /// When the module will have settled in RX mode, in ns.
+    uint64_t busy_until; /// When the module is done sending an acknowledge, in ns.
+    uint8_t last_pid[6]; /// The packet id of the last packet per pipe, to find duplicates.
+    uint16_t last_sum[6]; /// A checksum of the last packet per pipe, to find duplicates.
+    bool ack_sent[6]; /// Holds if the first ACK payload of a pipe was sent, it is removed when the next packet arrives.
+    int acks_to_lose; /// Number of acknowledges that will still be lost, see lose_acks().
+    int packets_to_lose; /// Number of packets that will still be lost, see lose_packets().
+    // Counters.
+    uint32_t transactions; /// Number of SPI transactions.
+    uint32_t bytes; /// Number of SPI bytes.
+    uint32_t packets_sent; /// Number of packets sent on the air, retransmits included.
+    
+    /// \brief
+    /// This will return the address width in bytes.
+    int address_width() const;
+    
+    /// \brief
+    /// This will return the time a packet with a payload of length bytes is on the air, in ns.
+    uint64_t airtime(const int length) const;
+    
+    /// \brief
+    /// This will handle one SPI byte, and return the byte the module sends back.
+    uint8_t clock_byte(const uint8_t in);
+    
+    /// \brief
+    /// This will return the number of CRC bytes.
+    int crc_bytes() const;
+    
+    /// \brief
+    /// This will finish the SPI command when CSN goes high.
+    void end_frame();
+    
+    /// \brief
+    /// This will finish sending a packet, acknowledged or failed.
+    void finish(const bool success);
+    
+    /// \brief
+    /// This will return the data rate: 0 for 250 kbps, 1 for 1 Mbps and 2 for 2 Mbps.
+    uint8_t rate() const;
+    
+    /// \brief
+    /// This will return byte index of a register, as it is read over SPI.
+    uint8_t read(const uint8_t reg, const int index);
+    
+    /// \brief
+    /// This will try to receive a packet, and returns true if it acknowledges it.
+    /// \details
+    /// The acknowledge, with an ACK payload if there is one, is stored in ack.
+    bool receive(const RF24_sim_radio & sender, const fifo_entry & packet, const uint8_t packet_pid,
+                 const uint64_t start, const uint64_t end, uint64_t & ack_end, fifo_entry & ack);
+    
+    /// \brief
+    /// This will remove an entry from a FIFO.
+    static void remove(fifo_entry* fifo, int & count, const int index);
+    
+    /// \brief
+    /// This will start sending the next packet, if the module can.
+    void start_tx();
+    
+    /// \brief
+    /// This will return the status register.
+    uint8_t status() const;
+    
+    /// \brief
+    /// This will do the next step of sending a packet.
+    void step();
+    
+    /// \brief
+    /// This will find out if the module is listening, after CE or NRF_CONFIG changed.
+    void update_mode();
+    
+    /// \brief
+    /// This will write a register.
+    void write(const uint8_t reg, const uint8_t value);
+    
+    friend class RF24_sim_air;
+public:
+    RF24_sim_radio(RF24_sim_air & air);
+    
+    /// \brief
+    /// This will return the CE pin.
+    hwlib::pin_out & ce();
+    
+    /// \brief
+    /// This will return the CSN pin.
+    hwlib::pin_out & csn();
+    
+    /// \brief
+    /// This will return the IRQ pin.
+    hwlib::pin_in & irq();
+    
+    /// \brief
+    /// This will return the number of packets sent on the air, retransmits included.
+    uint64_t air_packets() const;
+    
+    /// \brief
+    /// This will lose the next acknowledges the module sends.
+    /// \details
+    /// The packets are received as usual, only the PTX never hears that they arrived, so it retransmits them.
+    /// This can be used to test what happens when a packet arrived but its sender thinks it did not.
+    void lose_acks(const int count);
+    
+    /// \brief
+    /// This will lose the next packets the module sends, retransmits included.
+    /// \details
+    /// The packets are on the air, but no module receives them.
+    void lose_packets(const int count);
+    
+    /// \brief
+    /// This will return a register, without an SPI transaction.
+    uint8_t peek(const uint8_t reg);
+    
+    /// \brief
+    /// This will set the counters to zero.
+    void reset_counters();
+    
+    /// \brief
+    /// This will return the number of SPI bytes.
+    uint32_t spi_bytes() const;
+    
+    /// \brief
+    /// This will return the number of SPI transactions, one per CSN low.
+    uint32_t spi_transactions() const;
+    
+    /// \brief
+    /// This will do an SPI transaction with the module.
+    /// \details
+    /// If sel is the CSN pin of the module, CSN is set low before and high after the bytes.
+    /// With any other pin, the bytes are part of the command that is active, so CSN must be low already.
+    void write_and_read(hwlib::pin_out & sel, const size_t n, const uint8_t data_out[], uint8_t data_in[]) override;
+};
+
+#endif
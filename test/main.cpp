@@ -0,0 +1,1013 @@
+// ==========================================================================
+//
+// File      : main.cpp
+// Part of   : C++ library for using the nRF24L01+ module.
+// Copyright : laurens@vandersluisonline.com 2017
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at 
+// http://www.boost.org/LICENSE_1_0.txt
+//
+// ==========================================================================
+
+// this file contains Doxygen lines
+/**
+ * @author Laurens van der Sluis
+ * @date 22/06/2017
+ * @file main.cpp
+ * @brief Tests of the RF24 library, run on simulated modules.
+ * @details
+ * Every test drives the library against the simulator and checks what it did on the SPI bus and the air.
+ * It prints one line per check, PASS or FAIL with its name, and returns the number of failed checks,
+ * so a script can run it after every change.
+ */
+
+#include "hwlib.hpp"
+#include "RF24.hpp"
+#include "RF24_coalesce.hpp"
+#include "RF24_duplex.hpp"
+#include "RF24_hop.hpp"
+#include "RF24_link.hpp"
+#include "RF24_mesh.hpp"
+#include "RF24_message.hpp"
+#include "RF24_retry.hpp"
+#include "RF24_scan.hpp"
+#include "RF24_sim.hpp"
+#include "RF24_spi.hpp"
+#include "RF24_tdma.hpp"
+
+int failures = 0; // Number of checks that failed.
+
+/// \brief
+/// Prints the result of a check and counts it if it failed.
+void check(const bool ok, const char* name){
+    hwlib::cout << (ok ? "PASS " : "FAIL ") << name << '\n';
+    if (!ok) failures++;
+}
+
+/// \brief
+/// The shadow copy saves the reads of set_bit() and clear_bit(), and finds registers someone else changed.
+void shadow_registers(){
+    RF24_sim_air air;
+    RF24_sim_radio plain_module(air), shadow_module(air);
+    RF24 plain(plain_module.ce(), plain_module.csn(), plain_module);
+    RF24 shadowed(shadow_module.ce(), shadow_module.csn(), shadow_module);
+    plain.set_clock(air);
+    shadowed.set_clock(air);
+    if (!plain.init() || !shadowed.init()){
+        check(false, "shadow: init");
+        return;
+    }
+    shadowed.enable_shadow_registers(true);
+    plain_module.reset_counters();
+    shadow_module.reset_counters();
+    plain.start_easy_mode();
+    shadowed.start_easy_mode();
+    check(plain_module.spi_transactions() == 11, "shadow: start_easy_mode takes 11 transactions without the shadow copy");
+    check(shadow_module.spi_transactions() == 7, "shadow: start_easy_mode takes 7 transactions with the shadow copy");
+    check(shadowed.verify_shadow_registers(), "shadow: the shadow copy matches the chip");
+    // Change RF_CH behind the back of the driver.
+    const uint8_t write[2] = { W_REGISTER | (REGISTER_MASK & RF_CH), 99 };
+    uint8_t status[2];
+    shadow_module.write_and_read(shadow_module.csn(), 2, &*write, &*status);
+    check(!shadowed.verify_shadow_registers(), "shadow: verify finds a register written by someone else");
+    check(shadowed.read_register(RF_CH) == 99, "shadow: verify corrects the shadow copy");
+    check(shadowed.verify_shadow_registers(), "shadow: the corrected shadow copy matches the chip");
+}
+
+/// \brief
+/// The receiving side of a link: packets on pipe 0 are counted, control frames on pipe 1 go to the follower.
+class link_receiver : public RF24_packet_sink {
+private:
+    RF24_link_follower & follower; /// Handles the control frames.
+    uint8_t frame[33]; /// The packet that is read.
+public:
+    int delivered; /// Number of packets on pipe 0.
+    
+    link_receiver(RF24_link_follower & follower):
+        follower( follower ),
+        delivered( 0 )
+    {}
+    
+    uint8_t* reserve(const uint8_t, const uint8_t) override {
+        return &*frame;
+    }
+    
+    void commit(const uint8_t pipe, const uint8_t length) override {
+        if (pipe == 1) follower.handle(RF24_packet_view{ &frame[1], length, pipe });
+        else delivered++;
+    }
+};
+
+/// \brief
+/// The clock of a link adapter, which runs the follower while the adapter waits.
+/// \details
+/// When armed, the acknowledges of the follower are lost as soon as it switched to another step,
+/// so the switch is acknowledged, but the confirm that follows is not.
+class link_clock : public RF24_clock {
+private:
+    RF24_sim_air & air; /// The simulated air, which keeps the time.
+    RF24_sim_radio & module; /// The module of the follower.
+    RF24 & receiver; /// The radio of the follower.
+    link_receiver & sink; /// Reads what the follower receives.
+    RF24_link_follower & follower; /// The follower.
+    int armed_step; /// The step the follower was on when armed, or -1.
+public:
+    link_clock(RF24_sim_air & air, RF24_sim_radio & module, RF24 & receiver, link_receiver & sink, RF24_link_follower & follower):
+        air( air ),
+        module( module ),
+        receiver( receiver ),
+        sink( sink ),
+        follower( follower ),
+        armed_step( -1 )
+    {}
+    
+    void arm(){
+        armed_step = follower.step();
+    }
+    
+    uint_fast64_t now_us() override {
+        return air.now_us();
+    }
+    
+    void wait_us(const int_fast32_t us) override {
+        for (int_fast32_t left = us; left > 0; left -= 100){
+            air.advance((left < 100) ? left : 100);
+            receiver.receive_burst(sink);
+            follower.poll();
+            if (armed_step >= 0 && follower.step() != armed_step){
+                module.lose_acks(3 * 4); // 3 confirms of 4 tries each.
+                armed_step = -1;
+            }
+        }
+    }
+};
+
+/// \brief
+/// A confirm that arrived but was not acknowledged leaves both sides on another step, the adapter must find the follower.
+void link_lost_confirm(){
+    RF24_sim_air air;
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    receiver.set_clock(air);
+    if (!transmitter.init() || !receiver.init()){
+        check(false, "link: init");
+        return;
+    }
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    const uint8_t data_address[5] = {0x26, 0x02, 0x19, 0x96, 0xDD}; // The address of easy mode.
+    const uint8_t control_address[5] = {0xC0, 0x11, 0x11, 0x11, 0x11};
+    RF24_link_follower follower(receiver, 1, &*control_address);
+    link_receiver sink(follower);
+    link_clock clock(air, rx_module, receiver, sink, follower);
+    transmitter.set_clock(clock);
+    RF24_link_adapter adapter(transmitter, &*data_address, &*control_address);
+    follower.start(0);
+    adapter.start(0);
+    transmitter.set_retries(750, 3);
+    transmitter.start_tx_stream();
+    clock.arm();
+    uint8_t data[32] = {};
+    bool apart = false;
+    int delivered_before = 0;
+    uint32_t adapt_us = 0; // Time spent in adapt().
+    uint32_t adapt_blocked_us = 0; // Time adapt() counted as blocked.
+    for (int i = 0; i < 2000; i++){
+        if (i == 1800) delivered_before = sink.delivered;
+        if (adapter.due()){
+            // The control frames of the adapter must not go behind data in the TX FIFO.
+            for (RF24::tx_result result = transmitter.poll(); result != RF24::tx_result::idle; result = transmitter.poll()){
+                if (result == RF24::tx_result::pending) clock.wait_us(100);
+                else adapter.report(result);
+            }
+            const uint_fast64_t adapt_start = air.now_us();
+            const uint32_t blocked_start = transmitter.statistics().blocked_us;
+            adapter.adapt();
+            adapt_us += (uint32_t)(air.now_us() - adapt_start);
+            adapt_blocked_us += transmitter.statistics().blocked_us - blocked_start;
+            apart = apart || (adapter.step() != follower.step());
+        }
+        while (!transmitter.try_send(&*data, 32)){
+            clock.wait_us(100);
+        }
+        for (RF24::tx_result result = transmitter.poll(); result == RF24::tx_result::sent || result == RF24::tx_result::failed;
+             result = transmitter.poll()){
+            adapter.report(result);
+        }
+        clock.wait_us(100);
+    }
+    check(apart, "link: the lost confirms leave the adapter and follower on different steps");
+    check(adapter.step() == follower.step(), "link: the adapter finds the follower again");
+    check(sink.delivered - delivered_before >= 190, "link: packets arrive again after the resync");
+    // What is left is the time of the SPI transactions themselves.
+    check(adapt_blocked_us * 10 >= adapt_us * 9, "link: the waits of the adapter are counted as blocked");
+}
+
+/// \brief
+/// The follower does not wait in its handler, poll() switches once the acknowledge of the switch frame went out.
+void link_follower_deadline(){
+    RF24_sim_air air;
+    RF24_sim_radio module(air);
+    RF24 receiver(module.ce(), module.csn(), module);
+    receiver.set_clock(air);
+    if (!receiver.init()){
+        check(false, "follower: init");
+        return;
+    }
+    receiver.start_easy_mode();
+    air.advance(2000);
+    const uint8_t control_address[5] = {0xC0, 0x11, 0x11, 0x11, 0x11};
+    RF24_link_follower follower(receiver, 1, &*control_address);
+    follower.start(0);
+    const uint_fast64_t start = air.now_us();
+    const uint32_t blocked = receiver.statistics().blocked_us;
+    const uint8_t frame[2] = {RF24_link_switch, 2};
+    follower.handle(RF24_packet_view{ &*frame, 2, 1 });
+    check(air.now_us() == start && receiver.statistics().blocked_us == blocked, "follower: handle() does not wait");
+    check(follower.step() == 0, "follower: the switch waits for the acknowledge to go out");
+    air.advance(999);
+    follower.poll();
+    check(follower.step() == 0, "follower: poll() does not switch early");
+    air.advance(1);
+    follower.poll();
+    check(follower.step() == 2 && receiver.read_register(RF_SETUP) == 0x0E, "follower: poll() switches when it is due");
+    air.advance(RF24_link_revert_us);
+    follower.poll();
+    check(follower.step() == 0, "follower: an unconfirmed switch is undone");
+}
+
+/// \brief
+/// receive() reads one packet with its length first, like it did before receive_into().
+void receive_wrapper(){
+    RF24_sim_air air;
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    if (!transmitter.init() || !receiver.init()){
+        check(false, "receive: init");
+        return;
+    }
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    air.advance(2000); // Power up and settle.
+    check(receiver.receive()[0] == 0, "receive: the length is 0 without data");
+    const uint8_t data[7] = {1, 2, 3, 4, 5, 6, 7};
+    check(transmitter.send(&*data, 7), "receive: the packet is sent");
+    const uint8_t* payload = receiver.receive();
+    bool same = (payload[0] == 8);
+    for (int i = 0; i < 7 && same; i++){
+        same = (payload[i + 1] == data[i]);
+    }
+    check(same, "receive: the first byte is the length plus one, followed by the data");
+    check(receiver.receive()[0] == 0, "receive: a packet is read once");
+}
+
+/// \brief
+/// With RX observation, every read that finds the RX FIFO full counts an overrun, on every RX path.
+void rx_overruns(){
+    RF24_sim_air air;
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    if (!transmitter.init() || !receiver.init()){
+        check(false, "overruns: init");
+        return;
+    }
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    air.advance(2000); // Power up and settle.
+    const uint8_t data[4] = {1, 2, 3, 4};
+    RF24_packet_ring_buffer<4> packets;
+    for (int i = 0; i < 3; i++) transmitter.send(&*data, 4);
+    receiver.receive_burst(packets);
+    check(receiver.statistics().rx_overruns == 0, "overruns: not counted without RX observation");
+    receiver.enable_rx_observation(true);
+    for (int i = 0; i < 2; i++) transmitter.send(&*data, 4);
+    receiver.receive_burst(packets);
+    check(receiver.statistics().rx_overruns == 0, "overruns: two packets do not fill the RX FIFO");
+    for (int i = 0; i < 3; i++) transmitter.send(&*data, 4);
+    receiver.receive_burst(packets);
+    check(receiver.statistics().rx_overruns == 1, "overruns: a burst that finds the RX FIFO full counts one");
+    for (int i = 0; i < 3; i++) transmitter.send(&*data, 4);
+    uint8_t buffer[32];
+    receiver.receive_into(&*buffer, 32);
+    check(receiver.statistics().rx_overruns == 2, "overruns: receive_into() counts a full RX FIFO");
+    receiver.receive_into(&*buffer, 32);
+    check(receiver.statistics().rx_overruns == 2, "overruns: the RX FIFO is not full after a read");
+    for (int i = 0; i < 2; i++) transmitter.send(&*data, 4); // One is still in the RX FIFO.
+    receiver.receive();
+    check(receiver.statistics().rx_overruns == 3, "overruns: receive() counts a full RX FIFO");
+}
+
+/// \brief
+/// Every payload written over SPI gets a new packet id, so only retransmits are dropped as duplicates.
+/// \details
+/// When all acknowledges of a payload get lost, it failed but arrived, and written again it arrives again.
+void sim_packet_ids(){
+    RF24_sim_air air;
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    if (!transmitter.init() || !receiver.init()){
+        check(false, "packet id: init");
+        return;
+    }
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    air.advance(2000); // Power up and settle.
+    const uint8_t data[4] = {1, 2, 3, 4};
+    rx_module.lose_acks(2);
+    check(transmitter.send(&*data, 4), "packet id: a payload is sent when some acknowledges get lost");
+    int received = 0;
+    while (receiver.receive()[0] != 0) received++;
+    check(received == 1, "packet id: the retransmits are dropped as duplicates");
+    rx_module.lose_acks(4); // A full round of 1 + 3 retries.
+    check(!transmitter.send(&*data, 4), "packet id: a payload fails when all acknowledges get lost");
+    check(transmitter.send(&*data, 4), "packet id: the payload written again is sent");
+    received = 0;
+    while (receiver.receive()[0] != 0) received++;
+    check(received == 2, "packet id: the payload written again arrives again");
+}
+
+/// \brief
+/// The power state follows what the library did and the time since, and a PTX that powers down between bursts
+/// does not poll the chip while it starts up again.
+void power_states(){
+    RF24_sim_air air;
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    if (!transmitter.init() || !receiver.init()){
+        check(false, "power: init");
+        return;
+    }
+    receiver.start_easy_mode();
+    transmitter.start_easy_mode();
+    check(transmitter.power_state() == RF24_power_state::power_down, "power: the chip is starting up right after PWR_UP");
+    air.advance(RF24_power_up_us);
+    check(transmitter.power_state() == RF24_power_state::standby_1, "power: the chip settles after the start up");
+    air.advance(RF24_settle_us);
+    check(transmitter.power_state() == RF24_power_state::rx, "power: the chip listens after settling");
+    transmitter.start_tx_stream();
+    air.advance(RF24_settle_us);
+    check(transmitter.power_state() == RF24_power_state::standby_2, "power: a TX stream with an empty TX FIFO is standby-II");
+    transmitter.set_auto_power_down(true);
+    const uint8_t data[4] = {1, 2, 3, 4};
+    transmitter.try_send(&*data, 4);
+    check(transmitter.power_state() == RF24_power_state::tx, "power: a TX stream with a payload sends");
+    while (transmitter.poll() == RF24::tx_result::pending) air.advance(10);
+    check(transmitter.power_state() == RF24_power_state::power_down, "power: auto power down after the last result");
+    transmitter.try_send(&*data, 4);
+    check(transmitter.power_state() == RF24_power_state::power_down, "power: the next payload wakes the chip up");
+    const uint32_t before = tx_module.spi_transactions();
+    for (uint32_t waited = 0; waited + 10 < RF24_power_up_us; waited += 10){
+        transmitter.poll();
+        air.advance(10);
+    }
+    check(tx_module.spi_transactions() == before, "power: no status polls while the chip starts up");
+    RF24::tx_result result = transmitter.poll();
+    while (result == RF24::tx_result::pending){
+        air.advance(10);
+        result = transmitter.poll();
+    }
+    check(result == RF24::tx_result::sent, "power: the payload is sent after the start up");
+}
+
+/// \brief
+/// Counts the events it is called for.
+class counting_handler : public RF24_event_handler {
+public:
+    int calls; /// Number of events handled.
+    
+    counting_handler():
+        calls( 0 )
+    {}
+    
+    void handle(RF24 &, const uint8_t) override {
+        calls++;
+    }
+};
+
+/// \brief
+/// service() reads the status once when IRQ is low, clears only the flags it has a handler for, and calls the handler.
+void service_flags(){
+    RF24_sim_air air;
+    RF24_sim_radio module(air), rx_module(air);
+    RF24 radio(module.ce(), module.csn(), module, module.irq());
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    RF24_hwlib_spi bus(module, module.csn());
+    RF24_spi_recording<16> recorder(&bus); // In front of the simulated chip.
+    radio.set_clock(air);
+    receiver.set_clock(air);
+    radio.set_spi_backend(recorder);
+    if (!radio.init() || !receiver.init()){
+        check(false, "service: init");
+        return;
+    }
+    radio.start_easy_mode();
+    receiver.start_easy_mode();
+    radio.enable_ack_payload();
+    receiver.enable_ack_payload();
+    air.advance(2000); // Power up and settle.
+    counting_handler rx_handler;
+    radio.set_event_handler(RX_DR, &rx_handler);
+    recorder.clear();
+    check(!radio.service() && recorder.frames() == 0, "service: no SPI transactions while IRQ is high");
+    const uint8_t data[4] = {1, 2, 3, 4};
+    receiver.write_ack_payload(0, &*data, 4);
+    radio.start_tx_stream();
+    radio.try_send(&*data, 4);
+    air.advance(2000); // Sent, and the ACK payload came back: RX_DR and TX_DS are set.
+    check(!module.irq().get(), "service: IRQ is low after the events");
+    recorder.clear();
+    check(radio.service(), "service: the event is handled");
+    const uint8_t nop[1] = { NOP };
+    const uint8_t clear[2] = { W_REGISTER | NRF_STATUS, (1 << RX_DR) };
+    check(recorder.frames() == 2 && recorder.matches(0, &*nop, 1), "service: the status is read once");
+    check(recorder.matches(1, &*clear, 2), "service: only the handled flag is written to the status");
+    const uint8_t status = module.peek(NRF_STATUS);
+    check(!((status >> RX_DR) & 1) && ((status >> TX_DS) & 1), "service: the unhandled flag is left set");
+    check(rx_handler.calls == 1, "service: the handler is called");
+}
+
+/// \brief
+/// The retry tuner sets the shortest ARD for the data rate, and picks ARC from the attempts that failed.
+void retry_tuner(){
+    check(RF24_min_retry_delay(RF24_data_rate::rate_250kbps, 5, 2, 0) == 500, "retry: 500 us at 250 kbps, like the datasheet");
+    check(RF24_min_retry_delay(RF24_data_rate::rate_250kbps, 5, 2, 32) == 1500, "retry: a 32 byte ACK payload at 250 kbps needs 1500 us");
+    RF24_sim_air air;
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    if (!transmitter.init() || !receiver.init()){
+        check(false, "retry: init");
+        return;
+    }
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    transmitter.set_data_rate(RF24_data_rate::rate_250kbps);
+    receiver.set_data_rate(RF24_data_rate::rate_250kbps);
+    air.advance(2000); // Power up and settle.
+    RF24_retry_tuner clean(transmitter);
+    clean.start(0, 3);
+    check(clean.delay() == 500 && tx_module.peek(SETUP_RETR) == ((1 << ARD) | 3), "retry: start() sets ARD from the data rate and the ARC given");
+    const uint8_t data[4] = {1, 2, 3, 4};
+    uint8_t buffer[32];
+    for (int i = 0; i < 32; i++){
+        transmitter.send(&*data, 4);
+        receiver.receive_into(&*buffer, 32); // A full RX FIFO is not acknowledged.
+    }
+    check(clean.adapt() && clean.count() == 1, "retry: a clean link needs one retransmit");
+    check(tx_module.peek(SETUP_RETR) == ((1 << ARD) | 1), "retry: the new ARC is written to the chip");
+    // Every packet gets through on its second attempt, so half of the attempts fail.
+    // To deliver 990 of 1000 packets, 0.51 to the power count + 1 must be below 0.01.
+    RF24_retry_tuner lossy(transmitter);
+    lossy.start(0, 3);
+    for (int i = 0; i < 32; i++){
+        tx_module.lose_packets(1);
+        transmitter.send(&*data, 4);
+        receiver.receive_into(&*buffer, 32);
+    }
+    check(lossy.adapt() && lossy.count() == 6, "retry: a lossy link gets more retransmits");
+    check(tx_module.peek(SETUP_RETR) == ((1 << ARD) | 6), "retry: the ARD stays when the ARC changes");
+}
+
+/// \brief
+/// The scanner listens long enough for RPD on every channel, and finds the channels around a jammer busy.
+void channel_scanner(){
+    RF24_sim_air air;
+    RF24_sim_radio module(air);
+    RF24 radio(module.ce(), module.csn(), module);
+    radio.set_clock(air);
+    if (!radio.init()){
+        check(false, "scan: init");
+        return;
+    }
+    radio.start_easy_mode();
+    air.advance(2000); // Power up and settle.
+    air.set_jammer(60, 1000);
+    RF24_channel_scanner scanner(radio, 50, 70);
+    const uint_fast64_t start = air.now_us();
+    const uint32_t blocked = radio.statistics().blocked_us;
+    scanner.sweep(2);
+    check(scanner.samples() == 2, "scan: every sweep is one sample per channel");
+    check(radio.statistics().blocked_us - blocked == 2 * 21 * 170, "scan: every channel is listened to for 170 us, counted as blocked");
+    check(air.now_us() - start >= 2 * 21 * 170, "scan: the dwell takes place on the clock of the radio");
+    check(scanner.occupancy(60) == 1000, "scan: RPD is seen on the jammed channel after the dwell");
+    check(scanner.occupancy(59) == 0 && scanner.occupancy(50) == 0, "scan: the other channels are quiet");
+    const int quietest = scanner.quietest(2);
+    check(quietest >= 50 && quietest <= 70 && (quietest < 58 || quietest > 62), "scan: the quietest channel is away from the jammer");
+    check(radio.read_register(RF_CH) == 42, "scan: the channel is set back");
+}
+
+/// \brief
+/// Hands a fragment to a message receiver, like RF24::receive_burst() does.
+void put_fragment(RF24_message_receiver & receiver, const uint8_t id, const uint16_t index, const uint16_t count){
+    uint8_t* frame = receiver.reserve(0, RF24_fragment_header + 1);
+    if (frame == nullptr) return;
+    const uint8_t fragment[RF24_fragment_header + 1] = {
+        id, (uint8_t)(index & 0xFF), (uint8_t)(index >> 8), (uint8_t)(count & 0xFF), (uint8_t)(count >> 8), (uint8_t)index
+    };
+    for (int i = 0; i < RF24_fragment_header + 1; i++){
+        frame[i + 1] = fragment[i]; // The payload is behind the command byte.
+    }
+    receiver.commit(0, RF24_fragment_header + 1);
+}
+
+/// \brief
+/// Fragments that do not belong to any message are ignored, and do not throw away the message that is received.
+void message_fragments(){
+    RF24_message_buffer<2 * RF24_fragment_data> message;
+    put_fragment(message, 1, 0, 0);
+    check(!message.complete(), "message: a fragment of 0 fragments is not a complete message");
+    put_fragment(message, 1, 0, 2);
+    put_fragment(message, 2, 0, 0);
+    put_fragment(message, 2, 5, 2);
+    put_fragment(message, 1, 1, 2);
+    check(message.complete(), "message: bad fragments do not throw away the message");
+    check(message.message_length() == RF24_fragment_data + 1, "message: the length is known from the last fragment");
+}
+
+/// \brief
+/// A batch of configuration writes is one batch of frames, and a payload in two pieces is one frame.
+void spi_recorder(){
+    RF24_sim_air air;
+    RF24_sim_radio module(air);
+    RF24 radio(module.ce(), module.csn(), module);
+    RF24_hwlib_spi bus(module, module.csn());
+    RF24_spi_recording<16> recorder(&bus); // In front of the simulated chip.
+    radio.set_clock(air);
+    radio.set_spi_backend(recorder);
+    if (!radio.init()){
+        check(false, "recorder: init");
+        return;
+    }
+    recorder.clear();
+    const uint8_t address[5] = {0xC0, 0xFF, 0xEE, 0x00, 0x01};
+    radio.begin_batch();
+    radio.write_register(RF_CH, 76);
+    radio.write_register(SETUP_RETR, 0x13);
+    radio.set_tx_address(&*address);
+    radio.end_batch();
+    const uint8_t channel[2] = { W_REGISTER | RF_CH, 76 };
+    const uint8_t retries[2] = { W_REGISTER | SETUP_RETR, 0x13 };
+    const uint8_t tx_address[6] = { W_REGISTER | TX_ADDR, 0xC0, 0xFF, 0xEE, 0x00, 0x01 };
+    check(recorder.batches() == 1 && recorder.frames() == 3, "recorder: the configuration is one batch of 3 frames");
+    check(recorder.matches(0, &*channel, 2) && recorder.matches(1, &*retries, 2) && recorder.matches(2, &*tx_address, 6),
+          "recorder: the frames are sent in order");
+    check(module.peek(RF_CH) == 76 && module.peek(SETUP_RETR) == 0x13, "recorder: the batch reached the chip");
+    recorder.clear();
+    const uint8_t header[2] = {0x12, 0x34};
+    const uint8_t body[3] = {0x56, 0x78, 0x9A};
+    const RF24_span spans[2] = { { &*header, 2 }, { &*body, 3 } };
+    radio.try_send(&*spans, 2);
+    const uint8_t payload[6] = { W_TX_PAYLOAD, 0x12, 0x34, 0x56, 0x78, 0x9A };
+    bool found = false;
+    for (int i = 0; i < recorder.frames(); i++){
+        found = found || recorder.matches(i, &*payload, 6);
+    }
+    check(found, "recorder: a payload in two pieces is sent as one frame");
+    check(recorder.framing_ok(), "recorder: every batch is framed by CSN");
+}
+
+/// \brief
+/// Checks that the frames of a duplex node arrive once and in order.
+class ordered_handler : public RF24_packet_handler {
+public:
+    int received; /// Number of frames that arrived.
+    bool in_order; /// Holds if every frame was the next one.
+    
+    ordered_handler():
+        received( 0 ),
+        in_order( true )
+    {}
+    
+    void handle(const RF24_packet_view & packet) override {
+        in_order = in_order && packet.length == 8 && packet.data[0] == (uint8_t)received;
+        received++;
+    }
+};
+
+/// \brief
+/// Two duplex nodes with two radios each, node A on channel 10 and node B on channel 80, with striping.
+class duplex_pair {
+public:
+    RF24_sim_air air; /// The simulated air.
+    RF24_sim_radio a_tx_module, a_rx_module, b_tx_module, b_rx_module; /// The modules.
+    RF24 a_tx, a_rx, b_tx, b_rx; /// The radios.
+    ordered_handler a_handler, b_handler; /// What node A and node B receive.
+    RF24_duplex node_a, node_b; /// The nodes.
+    int a_queued, b_queued; /// Number of frames given to send().
+    
+    duplex_pair():
+        air(),
+        a_tx_module( air ), a_rx_module( air ), b_tx_module( air ), b_rx_module( air ),
+        a_tx( a_tx_module.ce(), a_tx_module.csn(), a_tx_module ),
+        a_rx( a_rx_module.ce(), a_rx_module.csn(), a_rx_module ),
+        b_tx( b_tx_module.ce(), b_tx_module.csn(), b_tx_module ),
+        b_rx( b_rx_module.ce(), b_rx_module.csn(), b_rx_module ),
+        a_handler(),
+        b_handler(),
+        node_a( a_tx, a_rx, a_handler ),
+        node_b( b_tx, b_rx, b_handler ),
+        a_queued( 0 ),
+        b_queued( 0 )
+    {}
+    
+    bool start(){
+        RF24* radios[4] = { &a_tx, &a_rx, &b_tx, &b_rx };
+        for (RF24* radio : radios){
+            if (!radio->init()) return false;
+            radio->set_clock(air);
+            radio->start_easy_mode();
+        }
+        const uint8_t a_address[5] = {0xC0, 0xDE, 0x00, 0x00, 0x0A};
+        const uint8_t b_address[5] = {0xC0, 0xDE, 0x00, 0x00, 0x0B};
+        node_a.start(10, &*a_address, 80, &*b_address);
+        node_b.start(80, &*b_address, 10, &*a_address);
+        node_a.set_striping(true);
+        node_b.set_striping(true);
+        air.advance(2000); // Power up and settle.
+        return true;
+    }
+    
+    /// \brief
+    /// Queues frames until node A gave a_total and node B b_total to send(), and polls both nodes once.
+    void step(const int a_total, const int b_total){
+        uint8_t data[8] = {};
+        data[0] = a_queued;
+        if (a_queued < a_total && node_a.send(&*data, 8)) a_queued++;
+        data[0] = b_queued;
+        if (b_queued < b_total && node_b.send(&*data, 8)) b_queued++;
+        node_a.poll();
+        node_b.poll();
+    }
+    
+    /// \brief
+    /// Runs both nodes until everything that was given to send() arrived, or for at most us.
+    bool run(const int a_total, const int b_total, const uint64_t us){
+        const uint64_t deadline = air.now_us() + us;
+        while ((b_handler.received < a_total || a_handler.received < b_total) && air.now_us() < deadline){
+            this->step(a_total, b_total);
+        }
+        return b_handler.received == a_total && a_handler.received == b_total;
+    }
+};
+
+/// \brief
+/// A release that never arrives leaves node B lending its channel, which it takes back when node A asks again.
+void duplex_lost_release_ask(){
+    duplex_pair pair;
+    if (!pair.start()){
+        check(false, "duplex: init");
+        return;
+    }
+    bool striped = false, armed = false;
+    const uint64_t deadline = pair.air.now_us() + 1000000;
+    while ((!armed || pair.node_a.striping()) && pair.air.now_us() < deadline){
+        pair.step(200, 0);
+        striped = striped || pair.node_a.striping();
+        // The last frame was acknowledged, the release goes next on the borrowed channel.
+        if (!armed && pair.node_a.striping() && pair.node_a.pending() == 0){
+            pair.a_rx_module.lose_packets(4); // 4 tries.
+            armed = true;
+        }
+    }
+    check(striped && armed, "duplex: node A borrows the channel of node B");
+    check(!pair.node_a.striping(), "duplex: node A gives the channel back when the release fails");
+    striped = false;
+    const bool done = pair.run(400, 0, 200000);
+    check(done && pair.b_handler.in_order, "duplex: frames arrive in order after a lost release");
+    while (!striped && pair.air.now_us() < deadline){
+        pair.step(600, 0);
+        striped = pair.node_a.striping();
+    }
+    check(striped, "duplex: node B lends its channel again after a lost release");
+    check(pair.run(600, 0, 200000) && pair.b_handler.in_order, "duplex: all frames arrive once after a lost release");
+}
+
+/// \brief
+/// A release that never arrives leaves node B lending its channel, with nobody to send the reclaim to:
+/// it must take the channel back after the reclaim timeout.
+void duplex_lost_release_reclaim(){
+    duplex_pair pair;
+    if (!pair.start()){
+        check(false, "duplex: init");
+        return;
+    }
+    bool armed = false;
+    const uint64_t deadline = pair.air.now_us() + 1000000;
+    while ((!armed || pair.node_a.striping()) && pair.air.now_us() < deadline){
+        pair.step(200, 0);
+        if (!armed && pair.node_a.striping() && pair.node_a.pending() == 0){
+            pair.a_rx_module.lose_packets(4);
+            armed = true;
+        }
+    }
+    check(armed && pair.run(200, 0, 100000), "duplex: frames of node A arrive before the release is lost");
+    const uint64_t begin = pair.air.now_us();
+    const bool done = pair.run(200, 50, 200000);
+    const uint64_t elapsed = pair.air.now_us() - begin;
+    check(done && pair.a_handler.in_order, "duplex: node B sends again after a lost release");
+    check(elapsed >= 10000 && elapsed < 30000, "duplex: node B takes its channel back after the reclaim timeout");
+}
+
+/// \brief
+/// A lend that arrived but was not acknowledged: node A borrows the channel, while node B still sends on it.
+void duplex_lost_lend_ack(){
+    duplex_pair pair;
+    if (!pair.start()){
+        check(false, "duplex: init");
+        return;
+    }
+    // Node B sends nothing before the lend, so the first acknowledges of the RX radio of node A are those of the lend.
+    pair.a_rx_module.lose_acks(4);
+    bool striped = false;
+    const uint64_t deadline = pair.air.now_us() + 1000000;
+    while (pair.b_handler.received < 400 && pair.air.now_us() < deadline){
+        pair.step(400, 0);
+        striped = striped || pair.node_a.striping();
+    }
+    check(striped, "duplex: node A borrows after the lend was not acknowledged");
+    check(pair.b_handler.received == 400 && pair.b_handler.in_order, "duplex: all frames arrive once after a lost lend acknowledge");
+    check(pair.run(400, 50, 100000) && pair.a_handler.in_order, "duplex: node B sends after a lost lend acknowledge");
+}
+
+/// \brief
+/// A coalesced payload whose acknowledges got lost is sent again, its messages are handled once.
+void coalescer_lost_acks(){
+    RF24_sim_air air;
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    transmitter.set_clock(air);
+    receiver.set_clock(air);
+    if (!transmitter.init() || !receiver.init()){
+        check(false, "coalescer: init");
+        return;
+    }
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    air.advance(2000); // Power up and settle.
+    ordered_handler handler;
+    RF24_coalesced_receiver unpacker(handler);
+    RF24_coalescer coalescer(transmitter);
+    uint8_t data[8] = {};
+    for (int i = 0; i < 3; i++){
+        data[0] = i;
+        coalescer.add(&*data, 8);
+    }
+    rx_module.lose_acks(4); // A full round of 1 + 3 retries.
+    check(!coalescer.flush() && coalescer.pending() == 3, "coalescer: the payload is kept when its acknowledges get lost");
+    check(coalescer.flush() && coalescer.pending() == 0, "coalescer: the payload is sent again");
+    data[0] = 3;
+    coalescer.add(&*data, 8);
+    check(coalescer.flush(), "coalescer: the next payload is sent");
+    receiver.receive_burst(unpacker);
+    check(handler.received == 4 && handler.in_order, "coalescer: every message is handled once");
+}
+
+/// \brief
+/// The clock of a hop sender, which runs the hop receiver while the sender waits.
+class hop_clock : public RF24_clock {
+private:
+    RF24_sim_air & air; /// The simulated air, which keeps the time.
+    RF24 & receiver; /// The radio of the hop receiver.
+    RF24_hop_receiver & hop_receiver; /// The hop receiver.
+public:
+    hop_clock(RF24_sim_air & air, RF24 & receiver, RF24_hop_receiver & hop_receiver):
+        air( air ),
+        receiver( receiver ),
+        hop_receiver( hop_receiver )
+    {}
+    
+    uint_fast64_t now_us() override {
+        return air.now_us();
+    }
+    
+    void wait_us(const int_fast32_t us) override {
+        for (int_fast32_t left = us; left > 0; left -= 100){
+            air.advance((left < 100) ? left : 100);
+            receiver.receive_burst(hop_receiver);
+            hop_receiver.poll();
+        }
+    }
+};
+
+/// \brief
+/// A frame that got lost altogether leaves the receiver behind, both sides must find each other on the home channel.
+void hop_resync(){
+    RF24_sim_air air;
+    RF24_sim_radio tx_module(air), rx_module(air);
+    RF24 transmitter(tx_module.ce(), tx_module.csn(), tx_module);
+    RF24 receiver(rx_module.ce(), rx_module.csn(), rx_module);
+    receiver.set_clock(air);
+    if (!transmitter.init() || !receiver.init()){
+        check(false, "hop: init");
+        return;
+    }
+    transmitter.start_easy_mode();
+    receiver.start_easy_mode();
+    RF24_hop_sequence sequence(1234);
+    ordered_handler handler;
+    RF24_hop_receiver hop_receiver(receiver, sequence, handler, 2);
+    hop_clock clock(air, receiver, hop_receiver);
+    transmitter.set_clock(clock);
+    RF24_hop_sender sender(transmitter, sequence, 2);
+    transmitter.set_retries(750, 3);
+    transmitter.start_tx_stream();
+    clock.wait_us(2000); // Power up and settle.
+    hop_receiver.start();
+    sender.start();
+    check(sender.channel() == 2 && rx_module.peek(RF_CH) == 2, "hop: both sides start on the home channel");
+    uint8_t data[8] = {};
+    bool ok = true;
+    bool in_step = true;
+    for (int i = 0; i < 10; i++){
+        data[0] = handler.received;
+        ok = ok && sender.send(&*data, 8);
+        in_step = in_step && (rx_module.peek(RF_CH) == sender.channel());
+    }
+    check(ok && in_step && handler.received == 10, "hop: both sides hop together");
+    const uint_fast64_t heard_at = air.now_us(); // The receiver heard the last frame.
+    tx_module.lose_packets(4); // The next frame and its 3 retransmits.
+    data[0] = handler.received;
+    check(!sender.send(&*data, 8), "hop: the lost frame fails");
+    check(rx_module.peek(RF_CH) != sender.channel(), "hop: the receiver stays behind");
+    check(!sender.send(&*data, 8) && sender.channel() == 2, "hop: after two failures the sender goes home");
+    int tries = 0;
+    while (!sender.send(&*data, 8) && ++tries < 100){}
+    check(tries < 100 && air.now_us() - heard_at > 20000, "hop: the frame arrives once the receiver went home");
+    check(rx_module.peek(RF_CH) == sender.channel() && sender.channel() != 2, "hop: both sides hop on from home");
+    data[0] = handler.received;
+    check(sender.send(&*data, 8) && handler.received == 12 && handler.in_order, "hop: every frame arrived once, in order");
+}
+
+/// \brief
+/// Checks that the frames of two TDMA nodes arrive once and in order, byte 0 is the frame and byte 1 the node.
+class tdma_handler : public RF24_packet_handler {
+public:
+    int received[2]; /// Number of frames that arrived, per node.
+    bool in_order; /// Holds if every frame was the next one of its node.
+    
+    tdma_handler():
+        received{ 0, 0 },
+        in_order( true )
+    {}
+    
+    void handle(const RF24_packet_view & packet) override {
+        const int node = packet.data[1] & 1;
+        in_order = in_order && packet.length == 8 && packet.data[0] == (uint8_t)received[node];
+        received[node]++;
+    }
+};
+
+/// \brief
+/// A TDMA frame that arrived while its acknowledges got lost is sent again in a later slot, after a frame of the
+/// other node, so the chip of the hub does not see it as a duplicate. The hub must pass it on once.
+void tdma_lost_acks(){
+    RF24_sim_air air;
+    RF24_sim_radio hub_module(air), node_modules[2] = { RF24_sim_radio(air), RF24_sim_radio(air) };
+    RF24 hub_radio(hub_module.ce(), hub_module.csn(), hub_module);
+    RF24 node_radios[2] = {
+        RF24(node_modules[0].ce(), node_modules[0].csn(), node_modules[0]),
+        RF24(node_modules[1].ce(), node_modules[1].csn(), node_modules[1])
+    };
+    tdma_handler handler;
+    RF24_tdma_hub hub(hub_radio, handler, 2, 4);
+    RF24_tdma_node nodes[2] = { RF24_tdma_node(node_radios[0], 0), RF24_tdma_node(node_radios[1], 1) };
+    const uint8_t data_address[5] = {0xC0, 0xDE, 0x00, 0x00, 0x0D};
+    const uint8_t beacon_address[5] = {0xC0, 0xDE, 0x00, 0x00, 0x0B};
+    RF24* radios[3] = { &hub_radio, &node_radios[0], &node_radios[1] };
+    for (RF24* radio : radios){
+        if (!radio->init()){
+            check(false, "tdma: init");
+            return;
+        }
+        radio->set_clock(air);
+        radio->start_easy_mode();
+    }
+    hub.start(&*data_address, &*beacon_address);
+    nodes[0].start(&*data_address, &*beacon_address);
+    nodes[1].start(&*data_address, &*beacon_address);
+    air.advance(2000); // Power up and settle.
+    hub_module.lose_acks(8); // All tries of the first frame, twice, so it goes again in a later slot.
+    uint8_t data[8] = {};
+    int queued[2] = {0, 0};
+    const uint64_t deadline = air.now_us() + 1000000;
+    while ((queued[0] < 100 || queued[1] < 100 || nodes[0].pending() > 0 || nodes[1].pending() > 0) && air.now_us() < deadline){
+        for (int n = 0; n < 2; n++){
+            data[0] = queued[n];
+            data[1] = n;
+            if (queued[n] < 100 && nodes[n].send(&*data, 8)) queued[n]++;
+            nodes[n].poll();
+        }
+        hub.poll();
+        air.advance(10);
+    }
+    for (int i = 0; i < 10; i++){
+        hub_radio.receive_burst(hub); // Read what is left.
+    }
+    check(nodes[0].pending() == 0 && nodes[1].pending() == 0, "tdma: the nodes send all frames");
+    check(handler.received[0] == 100 && handler.received[1] == 100 && handler.in_order, "tdma: the hub passes on every frame once");
+}
+
+/// \brief
+/// A mesh frame that arrived while a full round of its acknowledges got lost is sent again,
+/// the relay forwards it once and the root handles it once.
+void mesh_lost_acks(){
+    RF24_sim_air air;
+    RF24_sim_radio modules[3] = { RF24_sim_radio(air), RF24_sim_radio(air), RF24_sim_radio(air) };
+    RF24 radios[3] = {
+        RF24(modules[0].ce(), modules[0].csn(), modules[0]),
+        RF24(modules[1].ce(), modules[1].csn(), modules[1]),
+        RF24(modules[2].ce(), modules[2].csn(), modules[2])
+    };
+    ordered_handler handler;
+    const uint8_t network[2] = {0x4D, 0x45};
+    RF24_mesh nodes[3] = {
+        RF24_mesh(radios[0], handler, 00, &*network),
+        RF24_mesh(radios[1], handler, 01, &*network),
+        RF24_mesh(radios[2], handler, 011, &*network)
+    };
+    for (int i = 0; i < 3; i++){
+        if (!radios[i].init()){
+            check(false, "mesh: init");
+            return;
+        }
+        radios[i].set_clock(air);
+        radios[i].start_easy_mode();
+        nodes[i].start(60);
+    }
+    air.advance(2000); // Power up and settle.
+    modules[0].lose_acks(4); // A full round of 1 + 3 retries, at the root and at the relay.
+    modules[1].lose_acks(4);
+    uint8_t data[8] = {};
+    int queued = 0;
+    const uint64_t deadline = air.now_us() + 1000000;
+    while ((queued < 10 || nodes[1].pending() > 0 || nodes[2].pending() > 0) && air.now_us() < deadline){
+        data[0] = queued;
+        if (queued < 10 && nodes[2].send(00, &*data, 8)) queued++;
+        for (RF24_mesh & node : nodes){
+            node.poll();
+        }
+        air.advance(10);
+    }
+    for (int i = 0; i < 10; i++){
+        nodes[0].poll(); // Read what is left.
+    }
+    check(nodes[1].counters().repeated > 0 && nodes[0].counters().repeated > 0, "mesh: the frames whose acknowledges got lost arrive again");
+    check(nodes[0].counters().received == 10 && handler.received == 10 && handler.in_order, "mesh: the root handles every frame once");
+    check(nodes[1].counters().forwarded == 10, "mesh: the relay forwards every frame once");
+}
+
+/// \brief
+/// A mesh address is cut off at its first digit that is not a child.
+void mesh_addresses(){
+    RF24_sim_air air;
+    RF24_sim_radio module(air);
+    RF24 radio(module.ce(), module.csn(), module);
+    ordered_handler handler;
+    const uint8_t network[2] = {0x4D, 0x45};
+    check(RF24_mesh(radio, handler, 012, &*network).address() == 012, "mesh: a valid address is kept");
+    check(RF24_mesh(radio, handler, 05, &*network).address() == 0, "mesh: a digit above the number of children is cut off");
+    check(RF24_mesh(radio, handler, 0102, &*network).address() == 02, "mesh: a digit above a 0 is cut off");
+    check(RF24_mesh(radio, handler, 0162, &*network).address() == 02, "mesh: the digits above a bad digit are cut off");
+}
+
+int main( void ){
+    shadow_registers();
+    receive_wrapper();
+    rx_overruns();
+    sim_packet_ids();
+    power_states();
+    message_fragments();
+    spi_recorder();
+    service_flags();
+    retry_tuner();
+    channel_scanner();
+    link_lost_confirm();
+    link_follower_deadline();
+    duplex_lost_release_ask();
+    duplex_lost_release_reclaim();
+    duplex_lost_lend_ack();
+    coalescer_lost_acks();
+    hop_resync();
+    tdma_lost_acks();
+    mesh_lost_acks();
+    mesh_addresses();
+    hwlib::cout << hwlib::dec << failures << " checks failed\n";
+    return failures;
+}